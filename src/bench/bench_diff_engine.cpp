@@ -0,0 +1,107 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Compare the speed and the result size of the difference algorithms on real file pairs.
+ *
+ * Usage: bench-diff-engine [-n repeat] fileL fileR [fileL fileR ...]
+ */
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "../diff_engine.h"
+
+/// Read a file, split it by lines
+static std::vector<std::string> readLines(const char *path)
+{
+    std::ifstream file{path};
+    if (not file)
+    {
+        std::cerr << "cannot read " << path << "\n";
+        exit(EXIT_FAILURE);
+    }
+    std::vector<std::string> lines{};
+    for (std::string line; std::getline(file, line);)
+        lines.push_back(std::move(line));
+    return lines;
+}
+
+int main(int argc, char *argv[])
+{
+    int repeat = 10;
+    int arg = 1;
+    if (arg + 1 < argc and std::strcmp(argv[arg], "-n") == 0)
+    {
+        repeat = std::max(1, std::atoi(argv[arg + 1]));
+        arg += 2;
+    }
+    if (arg >= argc or (argc - arg) % 2 != 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-n repeat] fileL fileR [fileL fileR ...]\n";
+        return EXIT_FAILURE;
+    }
+
+    const char *names[] = {"myers", "patience", "histogram"};
+    ThreadPool pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+    std::cout << "pair\tlines\talgorithm\tus/diff\tcommon\tedits\n";
+    for (; arg < argc; arg += 2)
+    {
+        // line identifiers, as TextDifference does
+        const std::vector<std::string> linesL = readLines(argv[arg]), linesR = readLines(argv[arg + 1]);
+        std::unordered_map<std::string_view, line_id> table{};
+        std::vector<line_id> idsL{}, idsR{};
+        for (const std::string &line : linesL)
+            idsL.push_back(table.emplace(line, table.size()).first->second);
+        for (const std::string &line : linesR)
+            idsR.push_back(table.emplace(line, table.size()).first->second);
+
+        for (const auto &[name, segmented] : {std::pair{names[0], false}, std::pair{names[0], true},
+                                              std::pair{names[1], false}, std::pair{names[1], true},
+                                              std::pair{names[2], false}, std::pair{names[2], true}})
+        {
+            const auto engine = makeDiffEngine(name);
+            std::vector<DiffEdit> script{};
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repeat; i++)
+            {
+                script.clear();
+                if (segmented)
+                    diffSegmented(*engine, idsL, idsR, script, pool, 2048);
+                else
+                    engine->diff(idsL, idsR, script);
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            size_t common = 0;
+            for (const DiffEdit &edit : script)
+                common += edit.type == DiffEdit::Common;
+            std::cout << argv[arg] << "\t" << linesL.size() << "/" << linesR.size() << "\t" << name << (segmented ? "+segments" : "") << "\t"
+                      << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / repeat << "\t"
+                      << common << "\t" << script.size() - common << "\n";
+        }
+    }
+    return EXIT_SUCCESS;
+}
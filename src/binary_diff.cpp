@@ -0,0 +1,178 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Comparison of binary files, read on demand.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "binary_diff.h"
+
+/// Size of the chunks compared between 2 checks of the cancellation
+static constexpr size_t compare_chunk_size = 256 * 1024;
+/// Size of the first block searched for NUL bytes
+static constexpr size_t binary_head_size = 8000;
+
+size_t bytesPrefix(const char *bufferL, const char *bufferR, size_t size, bool equal)
+{
+    size_t pos = 0;
+#if defined(__SSE2__)
+    // 16 bytes at a time, the mask has a bit set for each equal byte
+    const uint32_t stopMask = equal ? 0xFFFF : 0;
+    for (; pos + 16 <= size; pos += 16)
+    {
+        const __m128i blockL = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bufferL + pos));
+        const __m128i blockR = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bufferR + pos));
+        const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(blockL, blockR));
+        if (mask != stopMask)
+            return pos + std::countr_zero(mask ^ stopMask);
+    }
+#else
+    // 8 bytes at a time, the xor has a non-zero byte for each different byte
+    for (; pos + 8 <= size; pos += 8)
+    {
+        uint64_t blockL, blockR;
+        std::memcpy(&blockL, bufferL + pos, 8);
+        std::memcpy(&blockR, bufferR + pos, 8);
+        uint64_t diff = blockL ^ blockR;
+        if (not equal)
+        {
+            // set the high bit of each equal byte
+            diff = ~(((diff & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | diff) & 0x8080808080808080ULL;
+        }
+        if (diff != 0)
+            return pos + (std::endian::native == std::endian::little ? std::countr_zero(diff) : std::countl_zero(diff)) / 8;
+    }
+#endif
+    for (; pos < size; pos++)
+    {
+        if ((bufferL[pos] == bufferR[pos]) != equal)
+            return pos;
+    }
+    return size;
+}
+
+BinaryFiles::BinaryFiles(const int rootFd[2], const std::string &relPath, const bool isRegular[2], const off_t size[2])
+    : m_relPath{relPath}, m_fd{}, m_size{0, 0}
+{
+    for (int side = 0; side < 2; side++)
+    {
+        if (not isRegular[side])
+            continue;
+        m_fd[side] = ScopedFd::openat(rootFd[side], relPath, O_RDONLY);
+        if (m_fd[side].isValid())
+            m_size[side] = size[side];
+    }
+}
+
+size_t BinaryFiles::read(int side, uint64_t offset, char *buffer, size_t size) const
+{
+    size_t pos = 0;
+    while (pos < size and m_fd[side].isValid())
+    {
+        const ssize_t nbRead = ::pread(m_fd[side].fd, buffer + pos, size - pos, offset + pos);
+        if (nbRead < 0 and errno == EINTR)
+            continue;
+        if (nbRead < 0)
+            log_errno("pread", m_relPath);
+        if (nbRead <= 0)
+            break; // file truncated since the comparison
+        pos += nbRead;
+    }
+    return pos;
+}
+
+bool BinaryFiles::hasBinaryHead() const
+{
+    char buffer[binary_head_size];
+    for (int side = 0; side < 2; side++)
+    {
+        const size_t nbRead = read(side, 0, buffer, std::min<uint64_t>(m_size[side], binary_head_size));
+        if (std::memchr(buffer, '\0', nbRead) != nullptr)
+            return true;
+    }
+    return false;
+}
+
+bool findByteRanges(const BinaryFiles &files, size_t maxRanges, uint64_t mergeGap, std::vector<ByteRange> &ranges,
+                    std::stop_token stopToken)
+{
+    const uint64_t commonSize = std::min(files.size(0), files.size(1));
+    const uint64_t maxSize = std::max(files.size(0), files.size(1));
+    const auto buffers = std::make_unique<char[]>(2 * compare_chunk_size);
+    char *const bufferL = buffers.get();
+    char *const bufferR = buffers.get() + compare_chunk_size;
+
+    // start a range, or extend the previous one if it is close enough
+    const auto startRange = [&](uint64_t begin)
+    {
+        if (not ranges.empty() and begin - ranges.back().end <= mergeGap)
+            return true;
+        if (ranges.size() >= maxRanges)
+            return false;
+        ranges.push_back({begin, begin});
+        return true;
+    };
+
+    uint64_t pos = 0;
+    bool inRange = false;
+    while (pos < commonSize)
+    {
+        if (stopToken.stop_requested())
+            return false;
+        const size_t toRead = std::min<uint64_t>(compare_chunk_size, commonSize - pos);
+        const size_t nbRead = std::min(files.read(0, pos, bufferL, toRead), files.read(1, pos, bufferR, toRead));
+
+        // alternate between equal and different bytes
+        for (size_t offset = 0; offset < nbRead;)
+        {
+            offset += bytesPrefix(bufferL + offset, bufferR + offset, nbRead - offset, not inRange);
+            if (offset == nbRead)
+                break;
+            if (inRange)
+                ranges.back().end = pos + offset;
+            else if (not startRange(pos + offset))
+                return false;
+            inRange = not inRange;
+        }
+        pos += nbRead;
+        if (inRange)
+            ranges.back().end = pos;
+        if (nbRead < toRead)
+            break; // file truncated since the comparison
+    }
+
+    // bytes on one side only
+    if (pos < maxSize)
+    {
+        if (not inRange and not startRange(pos))
+            return false;
+        ranges.back().end = maxSize;
+    }
+    return true;
+}
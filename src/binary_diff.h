@@ -0,0 +1,95 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Comparison of binary files, read on demand.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "path.h"
+
+/** Get the length of the prefix where 2 buffers are equal (or different).
+ *
+ * @param[in] bufferL  first buffer
+ * @param[in] bufferR  second buffer
+ * @param[in] size     size of both buffers
+ * @param[in] equal    whether the bytes of the prefix are equal or different
+ * @return position of the first byte not matching the condition, size if none
+ */
+size_t bytesPrefix(const char *bufferL, const char *bufferR, size_t size, bool equal);
+
+/// Files compared byte by byte, read when needed
+class BinaryFiles
+{
+public:
+    /** Open the files to compare.
+     *
+     * @param[in] rootFd     root directory of each side
+     * @param[in] relPath    path of the files, relative to the roots
+     * @param[in] isRegular  whether there is a regular file on each side, otherwise the side is empty
+     * @param[in] size       size of the file on each side
+     */
+    BinaryFiles(const int rootFd[2], const std::string &relPath, const bool isRegular[2], const off_t size[2]);
+
+    /** Read a part of a file.
+     * @return number of bytes read, less than size at the end of the file
+     */
+    size_t read(int side, uint64_t offset, char *buffer, size_t size) const;
+
+    /// Get the size of a file
+    uint64_t size(int side) const
+    {
+        return m_size[side];
+    }
+
+    /// Get whether a file has a NUL byte in its first block, as git does to detect binary content
+    bool hasBinaryHead() const;
+
+private:
+    std::string m_relPath; ///< path of the files, for the logs
+    ScopedFd m_fd[2];      ///< files, invalid if missing
+    uint64_t m_size[2];    ///< size of the files
+};
+
+/// Range of differing bytes
+struct ByteRange
+{
+    uint64_t begin; ///< first differing byte
+    uint64_t end;   ///< after the last differing byte
+};
+
+/** Find the ranges of differing bytes between 2 files, reading them by chunks.
+ * The bytes beyond the end of the smallest file are different.
+ *
+ * @param[in]  files      files to compare
+ * @param[in]  maxRanges  number of ranges after which the comparison stops
+ * @param[in]  mergeGap   ranges separated by at most this number of equal bytes are merged
+ * @param[out] ranges     ranges of differing bytes, in increasing order
+ * @param[in]  stopToken  cancellation
+ * @return false if the comparison stopped before the end of the files
+ */
+bool findByteRanges(const BinaryFiles &files, size_t maxRanges, uint64_t mergeGap, std::vector<ByteRange> &ranges,
+                    std::stop_token stopToken = {});
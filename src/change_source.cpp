@@ -0,0 +1,85 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Sources of candidate paths for the comparison.
+ */
+
+#include "change_source.h"
+
+/// ChangeSource comparing everything from the roots
+class ChangeSourceFullWalk : public ChangeSource
+{
+public:
+    bool getCandidates(std::vector<ChangeCandidate> &candidates) override
+    {
+        candidates.assign(1, ChangeCandidate{".", ChangeCandidate::Recursive});
+        return true;
+    }
+};
+
+std::unique_ptr<ChangeSource> makeChangeSourceFullWalk()
+{
+    return std::make_unique<ChangeSourceFullWalk>();
+}
+
+/// ChangeSource comparing the paths given by the user
+class ChangeSourcePathList : public ChangeSource
+{
+public:
+    ChangeSourcePathList(const std::string &pathList);
+
+    bool getCandidates(std::vector<ChangeCandidate> &candidates) override
+    {
+        candidates = m_candidates;
+        return true;
+    }
+
+private:
+    std::vector<ChangeCandidate> m_candidates; ///< candidates from the list
+};
+
+ChangeSourcePathList::ChangeSourcePathList(const std::string &pathList)
+    : m_candidates{}
+{
+    // NUL separated (find -print0) if there is any NUL, newline separated otherwise
+    const char separator = pathList.find('\0') != std::string::npos ? '\0' : '\n';
+    size_t pos = 0;
+    while (pos < pathList.size())
+    {
+        size_t end = pathList.find(separator, pos);
+        if (end == std::string::npos)
+            end = pathList.size();
+        std::string path = pathList.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (path.empty())
+            continue;
+        if (path.back() == '/')
+            m_candidates.emplace_back(std::move(path), ChangeCandidate::Recursive);
+        else
+            m_candidates.emplace_back(std::move(path), ChangeCandidate::Entry);
+    }
+}
+
+std::unique_ptr<ChangeSource> makeChangeSourcePathList(const std::string &pathList)
+{
+    return std::make_unique<ChangeSourcePathList>(pathList);
+}
@@ -0,0 +1,81 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Sources of candidate paths for the comparison.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// forward reference
+class Context;
+
+/// Path that may be different between the 2 roots
+struct ChangeCandidate
+{
+    /// What shall be compared for the candidate
+    enum Scope
+    {
+        Entry,     ///< the entry only
+        Children,  ///< the entry and, if it is a directory on both sides, its direct children;
+                   ///< sub-directories with different inode numbers on both sides are compared recursively
+        Recursive, ///< the entry and, if it is a directory on both sides, its whole tree
+    };
+
+    std::string relPath; ///< relative path to roots, "." for the roots themselves
+    Scope scope;         ///< what shall be compared
+
+    // ChangeCandidate comparisons
+    auto operator<=>(const ChangeCandidate &) const = default;
+};
+
+/** Provide the paths to be compared, instead of walking the whole trees.
+ *
+ * The candidates shall be a superset of the differences: paths not covered
+ * by any candidate are considered identical on both sides.
+ */
+class ChangeSource
+{
+public:
+    virtual ~ChangeSource() = default;
+
+    /** Get the candidate paths.
+     * @param[out] candidates  paths to be compared, in any order
+     * @return false if the source cannot determine the candidates, a full walk is needed
+     */
+    virtual bool getCandidates(std::vector<ChangeCandidate> &candidates) = 0;
+};
+
+/// Build a ChangeSource walking the whole trees
+std::unique_ptr<ChangeSource> makeChangeSourceFullWalk();
+
+/** Build a ChangeSource from a list of paths, separated by NUL characters or by newlines.
+ * A path with a trailing / is compared recursively, other paths are compared as single entries.
+ */
+std::unique_ptr<ChangeSource> makeChangeSourcePathList(const std::string &pathList);
+
+/** Build a ChangeSource using btrfs generations, when both roots are snapshots of the same subvolume.
+ * Falls back to a full walk in all other cases.
+ */
+std::unique_ptr<ChangeSource> makeChangeSourceBtrfs(const Context &ctx);
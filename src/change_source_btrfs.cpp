@@ -0,0 +1,246 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * ChangeSource for snapshots of the same btrfs subvolume.
+ *
+ * Each btrfs inode item records the transaction that last modified it.
+ * When the older root is a read-only snapshot, the inodes of the newer
+ * root modified since the generation of the older one are the only
+ * candidates for differences: they are found with a tree search filtered
+ * on the transaction id, then resolved to paths.
+ */
+
+#include <algorithm>
+#include <endian.h>
+#include <linux/btrfs.h>
+#include <linux/btrfs_tree.h>
+#include <linux/magic.h>
+#include <sys/ioctl.h>
+#include <sys/statfs.h>
+
+#include "change_source.h"
+#include "context.h"
+
+/// ChangeSource based on btrfs generations
+class ChangeSourceBtrfs : public ChangeSource
+{
+public:
+    ChangeSourceBtrfs(const Context &context) : ctx{context} {}
+
+    bool getCandidates(std::vector<ChangeCandidate> &candidates) override;
+
+private:
+    /// Inode modified in the newer snapshot
+    struct ChangedInode
+    {
+        uint64_t ino;     ///< inode number
+        bool isDirectory; ///< whether the inode is a directory
+    };
+
+    /// Explain why a full walk is needed
+    bool fallback(const std::string &reason) const;
+
+    /// Get the subvolume information of a root, if it is the root of a btrfs subvolume
+    bool getSubvolInfo(int fd, const std::string &path, struct btrfs_ioctl_get_subvol_info_args &info) const;
+
+    /// Get the inodes modified since the given transaction
+    bool searchChangedInodes(int fd, uint64_t minTransid, std::vector<ChangedInode> &inodes) const;
+
+    /** Get all the paths of an inode, relative to the subvolume root.
+     * @return false if the paths do not fit in the maximum buffer of the kernel, no path for a deleted inode
+     */
+    bool resolvePaths(int fd, uint64_t ino, std::vector<std::string> &paths) const;
+
+    const Context &ctx;
+};
+
+bool ChangeSourceBtrfs::fallback(const std::string &reason) const
+{
+    if (ctx.settings.debug)
+    {
+        std::cerr << "btrfs change source not usable, " << reason << ": walking the whole trees" << std::endl;
+    }
+    return false;
+}
+
+bool ChangeSourceBtrfs::getSubvolInfo(int fd, const std::string &path, struct btrfs_ioctl_get_subvol_info_args &info) const
+{
+    struct statfs statfsbuf;
+    struct stat statbuf;
+    if (::fstatfs(fd, &statfsbuf) < 0 or ::fstat(fd, &statbuf) < 0)
+        return fallback("cannot stat " + path);
+    if (statfsbuf.f_type != BTRFS_SUPER_MAGIC)
+        return fallback(path + " is not on btrfs");
+    if (statbuf.st_ino != BTRFS_FIRST_FREE_OBJECTID)
+        return fallback(path + " is not the root of a subvolume");
+    if (::ioctl(fd, BTRFS_IOC_GET_SUBVOL_INFO, &info) < 0)
+        return fallback("cannot get subvolume information of " + path + ": " + std::strerror(errno));
+    return true;
+}
+
+bool ChangeSourceBtrfs::searchChangedInodes(int fd, uint64_t minTransid, std::vector<ChangedInode> &inodes) const
+{
+    struct btrfs_ioctl_search_args args{};
+    struct btrfs_ioctl_search_key &key = args.key;
+    key.tree_id = 0; // subvolume of fd
+    key.min_objectid = BTRFS_FIRST_FREE_OBJECTID;
+    key.max_objectid = BTRFS_LAST_FREE_OBJECTID;
+    key.min_type = BTRFS_INODE_ITEM_KEY;
+    key.max_type = BTRFS_INODE_ITEM_KEY;
+    key.min_offset = 0;
+    key.max_offset = UINT64_MAX;
+    key.min_transid = minTransid; // skips the tree blocks not written since
+    key.max_transid = UINT64_MAX;
+
+    while (not ctx.exitRequested)
+    {
+        key.nr_items = 4096;
+        if (::ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0)
+            return fallback(std::string{"tree search failed: "} + std::strerror(errno));
+        if (key.nr_items == 0)
+            break;
+
+        // items are returned for the whole key range: keep the inode items only
+        size_t pos = 0;
+        struct btrfs_ioctl_search_header header{};
+        for (uint32_t i = 0; i < key.nr_items; i++)
+        {
+            std::memcpy(&header, args.buf + pos, sizeof(header));
+            pos += sizeof(header);
+            if (header.type == BTRFS_INODE_ITEM_KEY and header.len >= sizeof(struct btrfs_inode_item))
+            {
+                struct btrfs_inode_item item;
+                std::memcpy(&item, args.buf + pos, sizeof(item));
+                if (le64toh(item.transid) >= minTransid)
+                    inodes.emplace_back(header.objectid, S_ISDIR(le32toh(item.mode)));
+            }
+            pos += header.len;
+        }
+
+        // continue with the next inode: its inode item is its first key
+        if (header.objectid >= BTRFS_LAST_FREE_OBJECTID)
+            break;
+        key.min_objectid = header.objectid + 1;
+        key.min_type = BTRFS_INODE_ITEM_KEY;
+        key.min_offset = 0;
+    }
+    return true;
+}
+
+bool ChangeSourceBtrfs::resolvePaths(int fd, uint64_t ino, std::vector<std::string> &paths) const
+{
+    paths.clear();
+    if (ino == BTRFS_FIRST_FREE_OBJECTID)
+    {
+        paths.emplace_back(".");
+        return true;
+    }
+
+    // the kernel clamps the buffer to 64 KiB
+    static constexpr size_t maxBufferSize = 64 * 1024 / sizeof(uint64_t);
+    std::vector<uint64_t> buffer(512);
+    while (true)
+    {
+        struct btrfs_ioctl_ino_path_args args{};
+        args.inum = ino;
+        args.size = buffer.size() * sizeof(uint64_t);
+        args.fspath = reinterpret_cast<uintptr_t>(buffer.data());
+        if (::ioctl(fd, BTRFS_IOC_INO_PATHS, &args) < 0)
+            return true; // deleted inode
+
+        const auto *container = reinterpret_cast<const struct btrfs_data_container *>(buffer.data());
+        if (container->bytes_missing > 0)
+        {
+            // too many hard links for the buffer
+            if (buffer.size() >= maxBufferSize)
+                return false;
+            buffer.resize(std::min(maxBufferSize, buffer.size() + container->bytes_missing / sizeof(uint64_t) + 1));
+            continue;
+        }
+        // each value is the offset of a path from the start of the values
+        const char *values = reinterpret_cast<const char *>(container->val);
+        for (uint32_t i = 0; i < container->elem_cnt; i++)
+            paths.emplace_back(values + container->val[i]);
+        return true;
+    }
+}
+
+bool ChangeSourceBtrfs::getCandidates(std::vector<ChangeCandidate> &candidates)
+{
+    // the root fds are O_PATH, ioctls need a real file descriptor
+    ScopedFd fd[2] = {ScopedFd::openat(ctx.root[0].fd, ".", O_RDONLY | O_DIRECTORY),
+                      ScopedFd::openat(ctx.root[1].fd, ".", O_RDONLY | O_DIRECTORY)};
+    if (not fd[0].isValid() or not fd[1].isValid())
+        return fallback("cannot open the roots");
+
+    struct btrfs_ioctl_get_subvol_info_args info[2]{};
+    for (int side = 0; side < 2; side++)
+    {
+        if (not getSubvolInfo(fd[side].fd, ctx.root[side].path, info[side]))
+            return false;
+    }
+
+    // both roots shall be snapshots of the same subvolume, or one a snapshot of the other
+    static constexpr uint8_t nullUuid[BTRFS_UUID_SIZE]{};
+    const auto sameUuid = [](const uint8_t *lhs, const uint8_t *rhs)
+    { return std::equal(lhs, lhs + BTRFS_UUID_SIZE, rhs); };
+    const bool related = (not sameUuid(info[0].parent_uuid, nullUuid) and sameUuid(info[0].parent_uuid, info[1].parent_uuid)) or
+                         sameUuid(info[0].parent_uuid, info[1].uuid) or
+                         sameUuid(info[1].parent_uuid, info[0].uuid);
+    if (not related)
+        return fallback("the roots are not snapshots of the same subvolume");
+
+    // the older root shall not have changed since the newer one diverged from it
+    const int older = info[0].generation <= info[1].generation ? 0 : 1;
+    const int newer = 1 - older;
+    if ((info[older].flags & BTRFS_SUBVOL_RDONLY) == 0)
+        return fallback("the older root " + ctx.root[older].path + " is not a read-only snapshot");
+    uint64_t minTransid = info[older].generation;
+    if (info[older].otransid > 0)
+        minTransid = std::min<uint64_t>(minTransid, info[older].otransid);
+
+    std::vector<ChangedInode> inodes{};
+    if (not searchChangedInodes(fd[newer].fd, minTransid, inodes))
+        return false;
+
+    std::vector<std::string> paths{};
+    for (const ChangedInode &inode : inodes)
+    {
+        if (not resolvePaths(fd[newer].fd, inode.ino, paths))
+            return fallback("too many hard links for inode " + std::to_string(inode.ino));
+        // a modified directory has entries added, removed or renamed
+        const ChangeCandidate::Scope scope = inode.isDirectory ? ChangeCandidate::Children : ChangeCandidate::Entry;
+        for (std::string &path : paths)
+            candidates.emplace_back(std::move(path), scope);
+    }
+
+    if (ctx.settings.debug)
+    {
+        std::cerr << "btrfs: " << inodes.size() << " inodes modified since transaction " << minTransid
+                  << " in " << ctx.root[newer].path << std::endl;
+    }
+    return true;
+}
+
+std::unique_ptr<ChangeSource> makeChangeSourceBtrfs(const Context &ctx)
+{
+    return std::make_unique<ChangeSourceBtrfs>(ctx);
+}
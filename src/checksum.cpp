@@ -0,0 +1,168 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Use content digests stored alongside the files by other tools.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <string_view>
+
+#include "checksum.h"
+
+static constexpr const char *sums_filename = "SHA256SUMS";
+
+/// Number of hexadecimal characters of a SHA-256 digest
+static constexpr size_t sha256_hex_size = 64;
+
+/** Normalize a SHA-256 digest: lower case hexadecimal.
+ * Final newlines and NUL characters written by some tools are removed.
+ * @return normalized digest, empty if not 64 hexadecimal characters
+ */
+static std::string normalizeDigest(const std::string &digest)
+{
+    const size_t size = std::min(digest.find_last_not_of(std::string{"\n\0", 2}) + 1, digest.size());
+    if (size != sha256_hex_size)
+        return {};
+
+    std::string result{};
+    result.reserve(size);
+    for (char c : std::string_view{digest}.substr(0, size))
+    {
+        if ((c >= '0' and c <= '9') or (c >= 'a' and c <= 'f'))
+            result += c;
+        else if (c >= 'A' and c <= 'F')
+            result += c - 'A' + 'a';
+        else
+            return {};
+    }
+    return result;
+}
+
+/// Format a timestamp as <sec>.<nsec>
+static std::string formatTimestamp(const struct timespec &ts)
+{
+    const std::string nsec = std::to_string(ts.tv_nsec);
+    return std::to_string(ts.tv_sec) + "." + std::string(9 - nsec.size(), '0') + nsec;
+}
+
+static inline std::string make_path(const std::string &dirPath, const std::string &filename)
+{
+    if (dirPath == ".")
+        return filename;
+    return dirPath + "/" + filename;
+}
+
+std::optional<bool> ChecksumReader::sameDigest(const std::string &dirPath, const std::string &filename,
+                                               const struct stat &statL, const struct stat &statR)
+{
+    const std::string digestL = getDigest(Side::Left, dirPath, filename, statL);
+    if (digestL.empty())
+        return {};
+    const std::string digestR = getDigest(Side::Right, dirPath, filename, statR);
+    if (digestR.empty())
+        return {};
+    return digestL == digestR;
+}
+
+std::string ChecksumReader::getDigest(Side side, const std::string &dirPath, const std::string &filename,
+                                      const struct stat &lstat)
+{
+    std::string digest = getDigestXattr(side, make_path(dirPath, filename), lstat);
+    if (digest.empty())
+        digest = getDigestSumsFile(side, dirPath, filename, lstat);
+    return digest;
+}
+
+std::string ChecksumReader::getDigestXattr(Side side, const std::string &relPath, const struct stat &lstat)
+{
+    const RootPath &root = ctx.root[int(side)];
+    const std::string &xattrName = ctx.settings.checksumXattr;
+
+    // the digest is valid only if it was computed on the current version of the file
+    std::string mtime = root.getXattr(relPath, xattrName + ".mtime");
+    mtime.resize(std::min(mtime.find_first_of(std::string{"\n\0", 2}), mtime.size())); // final \n or \0 from some tools
+    if (mtime != formatTimestamp(lstat.st_mtim))
+        return {};
+
+    return normalizeDigest(root.getXattr(relPath, xattrName));
+}
+
+std::string ChecksumReader::getDigestSumsFile(Side side, const std::string &dirPath, const std::string &filename,
+                                              const struct stat &lstat)
+{
+    SumsFile &sums = m_sums[int(side)];
+    if (sums.dirPath != dirPath)
+        loadSumsFile(side, dirPath);
+
+    // the SHA256SUMS file shall have been written after the last modification of the file
+    if (not sums.valid or
+        sums.mtime.tv_sec < lstat.st_mtim.tv_sec or
+        (sums.mtime.tv_sec == lstat.st_mtim.tv_sec and sums.mtime.tv_nsec < lstat.st_mtim.tv_nsec))
+        return {};
+
+    const auto it = sums.digests.find(filename);
+    return it == sums.digests.end() ? std::string{} : it->second;
+}
+
+void ChecksumReader::loadSumsFile(Side side, const std::string &dirPath)
+{
+    SumsFile &sums = m_sums[int(side)];
+    sums.dirPath = dirPath;
+    sums.valid = false;
+    sums.digests.clear();
+
+    const RootPath &root = ctx.root[int(side)];
+    const std::string relPath = make_path(dirPath, sums_filename);
+    struct stat statbuf;
+    if (::fstatat(root.fd, relPath.c_str(), &statbuf, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) < 0 or
+        not S_ISREG(statbuf.st_mode))
+        return; // no SHA256SUMS file in this directory
+
+    ScopedFd fd = ScopedFd::openat(root.fd, relPath, O_RDONLY);
+    if (not fd.isValid())
+        return;
+    sums.mtime = statbuf.st_mtim;
+    sums.valid = true;
+
+    // parse lines "<digest> <filename>" or "<digest> *<filename>" (sha256sum format)
+    std::istringstream content{fd.getContent()};
+    std::string line;
+    while (std::getline(content, line))
+    {
+        const size_t sep = line.find(' ');
+        if (sep == std::string::npos or sep + 2 > line.size())
+            continue;
+        std::string digest = normalizeDigest(line.substr(0, sep));
+        std::string name = line.substr(sep + 2); // skip " " and " " or "*"
+        if (name.starts_with("./"))
+            name = name.substr(2);
+        // escaped filenames and files in sub-directories are not supported
+        if (digest.empty() or line[0] == '\\' or name.find('/') != std::string::npos)
+            continue;
+        sums.digests.emplace(std::move(name), std::move(digest));
+    }
+
+    if (ctx.settings.debug)
+    {
+        std::cerr << "Loaded " << sums.digests.size() << " digests from " << relPath << std::endl;
+    }
+}
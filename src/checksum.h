@@ -0,0 +1,83 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Use content digests stored alongside the files by other tools.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "context.h"
+
+/** Read content digests stored alongside the files, to avoid reading the content.
+ *
+ * Digests are retrieved from:
+ * - an extended attribute (user.checksum by default), valid only if the attribute
+ *   `<name>.mtime` holds the mtime of the file as `<sec>.<nsec>`
+ * - a SHA256SUMS file in the directory of the file, valid only if it is not older
+ *   than the file
+ */
+class ChecksumReader
+{
+public:
+    ChecksumReader(const Context &context) : ctx{context}, m_sums{} {}
+
+    /** Compare the stored digests of a file on both sides.
+     * @param[in] dirPath   relative path of the directory containing the file
+     * @param[in] filename  name of the file
+     * @param[in] statL     lstat of the left file
+     * @param[in] statR     lstat of the right file
+     * @return whether the digests are equal, or nullopt if a fresh digest is missing on one side
+     */
+    std::optional<bool> sameDigest(const std::string &dirPath, const std::string &filename,
+                                   const struct stat &statL, const struct stat &statR);
+
+private:
+    /// Content of the SHA256SUMS file of one directory
+    struct SumsFile
+    {
+        std::string dirPath;                                  ///< directory of the loaded file
+        bool valid{false};                                    ///< whether a SHA256SUMS file was loaded
+        struct timespec mtime{};                              ///< mtime of the SHA256SUMS file
+        std::unordered_map<std::string, std::string> digests; ///< digest for each filename
+    };
+
+    /** Get the stored digest of a file.
+     * @return digest in lower case hexadecimal, empty if no fresh digest is available
+     */
+    std::string getDigest(Side side, const std::string &dirPath, const std::string &filename, const struct stat &lstat);
+
+    /// Get the digest from the xattr of the file
+    std::string getDigestXattr(Side side, const std::string &relPath, const struct stat &lstat);
+
+    /// Get the digest from the SHA256SUMS file of the directory
+    std::string getDigestSumsFile(Side side, const std::string &dirPath, const std::string &filename,
+                                  const struct stat &lstat);
+
+    /// Load the SHA256SUMS file of the given directory
+    void loadSumsFile(Side side, const std::string &dirPath);
+
+    const Context &ctx;
+    SumsFile m_sums[2]; ///< SHA256SUMS of the current directory on both sides
+};
@@ -24,10 +24,15 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <latch>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <thread>
+#include <vector>
 
 /// Queue that can be shared between threads
 template <typename T>
@@ -113,4 +118,64 @@ private:
     mutable std::mutex m_mutex;        ///< mutex for m_queue and m_condVar
     std::condition_variable m_condVar; ///< condition variable to unlock waiter
     std::queue<T> m_queue;             ///< queue of objects
-};
\ No newline at end of file
+};
+/// Threads running the iterations of loops
+class ThreadPool
+{
+public:
+    /// Start the threads, the calling thread also runs iterations
+    explicit ThreadPool(unsigned nbThreads) : m_tasks{}, m_threads{}
+    {
+        for (unsigned i = 0; i < nbThreads; i++)
+            m_threads.emplace_back(
+                [this]()
+                {
+                    while (auto task = m_tasks.get())
+                        (*task)();
+                });
+    }
+    ~ThreadPool()
+    {
+        m_tasks.close();
+    }
+
+    // not copyable
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// Get the number of threads running iterations, including the calling thread
+    size_t concurrency() const
+    {
+        return m_threads.size() + 1;
+    }
+
+    /** Call fct(index) for each index in [0, count[, on the threads of the pool and on the calling thread.
+     * Return when all the calls are done.
+     */
+    template <typename Fct>
+    void parallelFor(size_t count, Fct &&fct)
+    {
+        std::atomic<size_t> next{0};
+        const auto loop = [&]()
+        {
+            for (size_t index; (index = next++) < count;)
+                fct(index);
+        };
+
+        const size_t nbTasks = std::min(m_threads.size(), count > 0 ? count - 1 : 0);
+        std::latch done{std::ptrdiff_t(nbTasks)};
+        for (size_t i = 0; i < nbTasks; i++)
+            m_tasks.push(
+                [&]()
+                {
+                    loop();
+                    done.count_down();
+                });
+        loop();
+        done.wait();
+    }
+
+private:
+    ConcurrentQueue<std::function<void()>> m_tasks; ///< tasks waiting for a thread
+    std::vector<std::jthread> m_threads;            ///< threads of the pool, last to be initialized
+};
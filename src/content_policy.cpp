@@ -0,0 +1,225 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Policies deciding when the content of files shall be read.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <limits>
+
+#include "content_policy.h"
+#include "context.h"
+
+std::optional<ContentPolicy> contentPolicyFromString(const std::string &name)
+{
+    if (name == "mtime-trust")
+        return ContentPolicy::MtimeTrust;
+    if (name == "ctime-trust")
+        return ContentPolicy::CtimeTrust;
+    if (name == "size-only")
+        return ContentPolicy::SizeOnly;
+    if (name == "always-verify")
+        return ContentPolicy::AlwaysVerify;
+    if (name == "skip")
+        return ContentPolicy::Skip;
+    if (name == "hash-only")
+        return ContentPolicy::HashOnly;
+    return {};
+}
+
+std::optional<int64_t> parseDurationNs(const std::string &str)
+{
+    int64_t value;
+    const char *end = str.data() + str.size();
+    const auto [unitPtr, ec] = std::from_chars(str.data(), end, value);
+    if (ec != std::errc{} or value < 0)
+        return {};
+
+    const std::string unit{unitPtr, end};
+    int64_t multiplier;
+    if (unit == "ns")
+        multiplier = 1;
+    else if (unit == "us")
+        multiplier = 1000;
+    else if (unit == "ms")
+        multiplier = 1000 * 1000;
+    else if (unit == "s" or unit.empty())
+        multiplier = 1000 * 1000 * 1000;
+    else
+        return {};
+    if (value > std::numeric_limits<int64_t>::max() / multiplier)
+        return {}; // not representable in ns
+    return value * multiplier;
+}
+
+/// Convert a timestamp to nanoseconds, truncated to the given precision
+static inline int64_t toNs(const struct timespec &ts, int64_t precisionNs)
+{
+    const int64_t ns = int64_t(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+    if (precisionNs <= 1)
+        return ns;
+    // floor to a multiple of the precision, also for dates before epoch
+    const int64_t rem = ns % precisionNs;
+    return rem < 0 ? ns - rem - precisionNs : ns - rem;
+}
+
+bool timestampMatch(const Settings &settings, const struct timespec &lhs, const struct timespec &rhs)
+{
+    if (settings.mtimeToleranceNs == 0 and settings.mtimePrecisionNs <= 1)
+        return lhs == rhs;
+
+    const int64_t nsL = toNs(lhs, settings.mtimePrecisionNs);
+    const int64_t nsR = toNs(rhs, settings.mtimePrecisionNs);
+    return std::abs(nsL - nsR) <= settings.mtimeToleranceNs;
+}
+
+bool isContentTrusted(const Settings &settings, ContentPolicy policy,
+                      const struct stat &statL, const struct stat &statR)
+{
+    switch (policy)
+    {
+    case ContentPolicy::SizeOnly:
+    case ContentPolicy::Skip:
+        return true;
+
+    case ContentPolicy::AlwaysVerify:
+    case ContentPolicy::HashOnly:
+        return false;
+
+    case ContentPolicy::CtimeTrust:
+        // a change after the last write (including a restored mtime) leaves the ctime after the mtime,
+        // the ctimes of the 2 sides are not compared: they differ on any copy
+        for (const struct stat *statbuf : {&statL, &statR})
+        {
+            if (toNs(statbuf->st_ctim, settings.mtimePrecisionNs) - toNs(statbuf->st_mtim, settings.mtimePrecisionNs) >
+                settings.mtimeToleranceNs)
+                return false;
+        }
+        return timestampMatch(settings, statL.st_mtim, statR.st_mtim);
+
+    case ContentPolicy::MtimeTrust:
+        return timestampMatch(settings, statL.st_mtim, statR.st_mtim);
+    }
+    return false;
+}
+
+std::optional<ContentRules> ContentRules::fromConfig(const YAML::Node &rules, std::string &error)
+{
+    ContentRules result{};
+    if (not rules.IsDefined() or rules.IsNull())
+        return result;
+    if (not rules.IsSequence())
+    {
+        error = "content rules shall be a list";
+        return {};
+    }
+
+    // consecutive rules with the same policy are grouped
+    std::vector<std::pair<std::vector<std::string>, ContentPolicy>> groups{};
+    try
+    {
+        for (const auto &rule : rules)
+        {
+            if (not rule.IsMap() or not rule["pattern"] or not rule["policy"])
+            {
+                error = "content rules need a pattern and a policy";
+                return {};
+            }
+            const std::string name = rule["policy"].as<std::string>();
+            const auto policy = contentPolicyFromString(name);
+            if (not policy.has_value())
+            {
+                error = "invalid content policy '" + name + "'";
+                return {};
+            }
+
+            if (groups.empty() or groups.back().second != *policy)
+                groups.emplace_back(std::vector<std::string>{}, *policy);
+            if (rule["pattern"].IsSequence())
+            {
+                for (const auto &pattern : rule["pattern"])
+                    groups.back().first.push_back(pattern.as<std::string>());
+            }
+            else
+            {
+                groups.back().first.push_back(rule["pattern"].as<std::string>());
+            }
+        }
+    }
+    catch (const YAML::Exception &e)
+    {
+        error = "invalid content rule: " + e.msg;
+        return {};
+    }
+
+    for (const auto &[patterns, policy] : groups)
+    {
+        for (const std::string &pattern : patterns)
+        {
+            error = IgnoreFilter::checkRule(pattern);
+            if (not error.empty())
+                return {};
+        }
+        result.m_groups.emplace_back(IgnoreFilter{patterns}, policy);
+    }
+    return result;
+}
+
+bool ContentRules::usesDigests() const
+{
+    return std::any_of(m_groups.begin(), m_groups.end(), [](const auto &group)
+                       { return group.second == ContentPolicy::HashOnly; });
+}
+
+ContentRules::State ContentRules::getState(const std::string &dirPath) const
+{
+    State state{};
+    state.reserve(m_groups.size());
+    for (const auto &group : m_groups)
+    {
+        GroupState groupState{{}, false};
+        size_t pos = 0;
+        while (dirPath != "." and pos <= dirPath.size() and not groupState.matched)
+        {
+            size_t end = dirPath.find('/', pos);
+            if (end == std::string::npos)
+                end = dirPath.size();
+            IgnoreFilter::State next{};
+            groupState.matched = group.first.match(groupState.filter, dirPath.substr(pos, end - pos), &next);
+            groupState.filter = std::move(next);
+            pos = end + 1;
+        }
+        state.push_back(std::move(groupState));
+    }
+    return state;
+}
+
+std::optional<ContentPolicy> ContentRules::policy(const State &dirState, const std::string &filename) const
+{
+    for (size_t i = 0; i < m_groups.size(); i++)
+    {
+        if (dirState[i].matched or m_groups[i].first.match(dirState[i].filter, filename, nullptr))
+            return m_groups[i].second;
+    }
+    return {};
+}
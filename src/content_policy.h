@@ -0,0 +1,136 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Policies deciding when the content of files shall be read.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <sys/stat.h>
+#include <utility>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "ignore.h"
+
+// forward reference
+struct Settings;
+
+/// Policy deciding whether the content of 2 regular files with the same size shall be read
+enum class ContentPolicy : int
+{
+    MtimeTrust,   ///< same mtime: content assumed equal, read otherwise
+    CtimeTrust,   ///< same mtime and ctime not after mtime on each side: content assumed equal, read otherwise
+    SizeOnly,     ///< content is never read, same size is enough
+    AlwaysVerify, ///< content is always read
+    Skip,         ///< neither the size nor the content is compared
+    HashOnly,     ///< content compared with the digests stored alongside the files, mtime-trust without digests
+};
+
+/** Get a content policy from its name.
+ * @param[in] name  name of the policy, as given by the user
+ * @return content policy, or nullopt if the name is unknown
+ */
+std::optional<ContentPolicy> contentPolicyFromString(const std::string &name);
+
+/** Parse a duration given by the user.
+ * Accepted units are ns, us, ms and s; a number without unit is in seconds.
+ * @param[in] str  duration as given by the user, like "2s" or "1500ms"
+ * @return duration in nanoseconds, or nullopt if the string is invalid
+ */
+std::optional<int64_t> parseDurationNs(const std::string &str);
+
+/** Compare 2 timestamps with the tolerance and precision of the settings.
+ * @param[in] settings  settings of the diff
+ * @param[in] lhs       first timestamp
+ * @param[in] rhs       second timestamp
+ * @return whether the timestamps are considered equal
+ */
+bool timestampMatch(const Settings &settings, const struct timespec &lhs, const struct timespec &rhs);
+
+/** Whether the content of 2 regular files with the same size can be assumed equal without reading it.
+ * @param[in] settings  settings of the diff
+ * @param[in] policy    content policy to apply
+ * @param[in] statL     lstat of the left file
+ * @param[in] statR     lstat of the right file
+ * @return true if the content is trusted to be equal, false if it shall be read
+ */
+bool isContentTrusted(const Settings &settings, ContentPolicy policy,
+                      const struct stat &statL, const struct stat &statR);
+
+/** Content policies of regular files, by path pattern.
+ *
+ * Patterns have the syntax of the ignore rules; a pattern matching a directory
+ * applies to all the files below. The first matching rule gives the policy.
+ * Consecutive rules with the same policy share one IgnoreFilter.
+ */
+class ContentRules
+{
+public:
+    /// Matching state of a directory for one group of rules
+    struct GroupState
+    {
+        IgnoreFilter::State filter; ///< state of the patterns
+        bool matched;               ///< whether the directory or one of its ancestors matches
+    };
+
+    /// Matching state of a directory, for each group of rules
+    typedef std::vector<GroupState> State;
+
+    /** Read the rules from the configuration.
+     *
+     * @param[in]  rules  yaml sequence of maps with a pattern (string or list of strings) and a policy
+     * @param[out] error  description of the error, if the configuration is invalid
+     * @return rules, or nullopt if the configuration is invalid
+     */
+    static std::optional<ContentRules> fromConfig(const YAML::Node &rules, std::string &error);
+
+    /// Get whether there is no rule
+    bool empty() const
+    {
+        return m_groups.empty();
+    }
+
+    /// Get whether a rule compares the content with the stored digests
+    bool usesDigests() const;
+
+    /** Get the matching state of a directory.
+     *
+     * @param[in] dirPath  relative path of the directory, "." for the root
+     */
+    State getState(const std::string &dirPath) const;
+
+    /** Get the policy of an entry of a directory.
+     *
+     * @param[in] dirState  matching state of the directory
+     * @param[in] filename  name of the entry
+     * @return policy of the first matching rule, nullopt if no rule matches
+     */
+    std::optional<ContentPolicy> policy(const State &dirState, const std::string &filename) const;
+
+private:
+    ContentRules() : m_groups{} {}
+
+    std::vector<std::pair<IgnoreFilter, ContentPolicy>> m_groups; ///< rules grouped by policy, in order
+};
@@ -29,16 +29,26 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 #include <optional>
 #include <yaml-cpp/yaml.h>
 
+#include "change_source.h"
+#include "content_policy.h"
 #include "dispatcher.h"
+#include "filter.h"
 #include "ignore.h"
 #include "path.h"
 
 /// Constant settings of the diff
 struct Settings
 {
-    bool debug;               ///< output debug information on stderr
-    bool checkMetadata;       ///< whether metadata shall be checked for differences
-    size_t contentBufferSize; ///< size to be used for buffering file content
+    bool debug;                  ///< output debug information on stderr
+    bool checkMetadata;          ///< whether metadata shall be checked for differences
+    size_t contentBufferSize;    ///< size to be used for buffering file content
+    ContentPolicy contentPolicy; ///< when the content of regular files shall be read
+    int64_t mtimeToleranceNs;    ///< maximum difference between timestamps considered equal, in ns
+    int64_t mtimePrecisionNs;    ///< timestamps are truncated to this precision before comparison, in ns
+    bool useChecksums;           ///< whether digests stored alongside the files can be used instead of the content
+    std::string checksumXattr;   ///< name of the extended attribute storing the digest of a file
+    bool structureOnly;          ///< compare only names and file types, from the directory listings
+    bool gitIgnore;              ///< whether .gitignore and .diffignore files found in the trees are applied
 };
 
 // forward reference
@@ -63,16 +73,22 @@ public:
           cfg{config},
           dispatcher{},
           ignoreFilter{},
+          entryFilter{},
+          contentRules{},
+          changeSource{},
           exitRequested{false}
     {
     }
 
-    const Settings settings;                  ///< settings of the diff
-    const YAML::Node &cfg;                    ///< user configuration
-    RootPath root[2];                         ///< root on left and right sides
-    std::unique_ptr<Dispatcher> dispatcher;   ///< dispatcher for report and file comparison
-    std::optional<IgnoreFilter> ignoreFilter; ///< filter to ignore some paths during the diff
-    std::atomic<bool> exitRequested;          ///< whether user requested exit
+    const Settings settings;                    ///< settings of the diff
+    const YAML::Node &cfg;                      ///< user configuration
+    RootPath root[2];                           ///< root on left and right sides
+    std::unique_ptr<Dispatcher> dispatcher;     ///< dispatcher for report and file comparison
+    std::optional<IgnoreFilter> ignoreFilter;   ///< filter to ignore some paths during the diff
+    std::optional<EntryFilter> entryFilter;     ///< filter to ignore some files from their attributes
+    std::optional<ContentRules> contentRules;   ///< content policies by path pattern, from the configuration
+    std::unique_ptr<ChangeSource> changeSource; ///< paths to compare, everything if not set
+    std::atomic<bool> exitRequested;            ///< whether user requested exit
 };
 
 /** Get the yaml configuration.
@@ -0,0 +1,248 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Background computation of the content details in the interactive mode.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "detail_worker.h"
+
+/// Size of the chunks read between 2 checks of the cancellation
+static constexpr size_t read_chunk_size = 1024 * 1024;
+
+/** Read the content of a file, chunk by chunk.
+ * @return false if the job has been cancelled
+ */
+static bool read_content(int rootFd, const std::string &relPath, off_t size, const std::stop_token &stopToken,
+                         std::string &content)
+{
+    ScopedFd file = ScopedFd::openat(rootFd, relPath, O_RDONLY);
+    if (not file.isValid())
+        return true; // displayed as empty
+
+    content.resize(size);
+    size_t pos = 0;
+    while (pos < content.size())
+    {
+        if (stopToken.stop_requested())
+            return false;
+        const ssize_t nbRead = ::read(file.fd, content.data() + pos, std::min(read_chunk_size, content.size() - pos));
+        if (nbRead < 0 and errno == EINTR)
+            continue;
+        if (nbRead < 0)
+            log_errno("read", relPath);
+        if (nbRead <= 0)
+            break; // file truncated since the comparison
+        pos += nbRead;
+    }
+    content.resize(pos);
+    return true;
+}
+
+DetailWorker::DetailWorker(const Context &diffDirCtx, const TextDifference &textDiff,
+                           std::function<void()> onResult)
+    : m_diffDirCtx{diffDirCtx},
+      m_textDiff{textDiff},
+      m_onResult{std::move(onResult)},
+      m_currentJobId{0},
+      m_lastJobId{0},
+      m_mutex{},
+      m_condVar{},
+      m_job{},
+      m_stopSource{},
+      m_prefetchJobs{},
+      m_prefetchRunning{},
+      m_prefetchStop{},
+      m_results{},
+      m_thread{}
+{
+    m_thread = std::jthread{[this](std::stop_token stopToken)
+                            { run(stopToken); }};
+}
+
+DetailWorker::~DetailWorker()
+{
+    // the stop token of the thread only ends the wait, the running job checks its own token
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopSource.request_stop();
+    m_prefetchStop.request_stop();
+    m_job.reset();
+    m_prefetchJobs.clear();
+}
+
+DetailWorker::Job DetailWorker::makeJob(int index, const ReportEntry &reportEntry, bool prefetched,
+                                        std::stop_token stopToken)
+{
+    return Job{++m_lastJobId,
+               index,
+               reportEntry.relPath,
+               {reportEntry.file[0].type == FileType::Regular, reportEntry.file[1].type == FileType::Regular},
+               {reportEntry.file[0].lstat.st_size, reportEntry.file[1].lstat.st_size},
+               prefetched,
+               stopToken};
+}
+
+void DetailWorker::submit(int index, const ReportEntry &reportEntry)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopSource.request_stop();
+        m_prefetchJobs.clear();
+        if (m_prefetchRunning and m_prefetchRunning->index == index)
+        {
+            // the running prefetch job becomes the submitted job
+            m_currentJobId = m_prefetchRunning->id;
+            m_stopSource = std::exchange(m_prefetchStop, std::stop_source{});
+            m_prefetchRunning.reset();
+            m_job.reset();
+            return;
+        }
+
+        // the submitted job has priority
+        m_prefetchStop.request_stop();
+        m_prefetchStop = std::stop_source{};
+        m_stopSource = std::stop_source{};
+        m_job = makeJob(index, reportEntry, false, m_stopSource.get_token());
+        m_currentJobId = m_job->id;
+    }
+    m_condVar.notify_one();
+}
+
+void DetailWorker::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopSource.request_stop();
+    m_job.reset();
+    m_currentJobId = 0;
+}
+
+void DetailWorker::prefetch(int index, const ReportEntry &reportEntry)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_prefetchRunning and m_prefetchRunning->index == index)
+            return; // already being computed
+        m_prefetchJobs.push_back(makeJob(index, reportEntry, true, m_prefetchStop.get_token()));
+    }
+    m_condVar.notify_one();
+}
+
+void DetailWorker::clearPrefetch()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prefetchJobs.clear();
+}
+
+void DetailWorker::cancelPrefetch()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prefetchJobs.clear();
+    m_prefetchStop.request_stop();
+    m_prefetchStop = std::stop_source{};
+}
+
+void DetailWorker::run(std::stop_token stopToken)
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_prefetchRunning.reset();
+            if (not m_condVar.wait(lock, stopToken,
+                                   [this]() { return m_job.has_value() or not m_prefetchJobs.empty(); }))
+                return; // application exit
+            if (m_job)
+            {
+                job = std::move(*m_job);
+                m_job.reset();
+            }
+            else
+            {
+                // prefetch only when there is no submitted job
+                job = std::move(m_prefetchJobs.front());
+                m_prefetchJobs.pop_front();
+                m_prefetchRunning = job;
+            }
+        }
+
+        Result result{job.id, job.index, job.prefetched, {}};
+        compute(job, result.details);
+        if (not job.stopToken.stop_requested())
+        {
+            m_results.push(std::move(result));
+            m_onResult();
+        }
+    }
+}
+
+/// Contents of the compared files, referenced by the details
+struct DetailContents
+{
+    MappedFile mapped[2];  ///< large files, read from disk when displayed
+    std::string loaded[2]; ///< other files
+};
+
+void DetailWorker::compute(const Job &job, TextDetails &details)
+{
+    // binary files are not loaded, the differing bytes are read by chunks and the displayed rows when drawn
+    const int rootFd[2] = {m_diffDirCtx.root[0].fd, m_diffDirCtx.root[1].fd};
+    auto files = std::make_shared<BinaryFiles>(rootFd, job.relPath, job.isRegular, job.size);
+    const auto compareBinary = [&]()
+    {
+        details.setBinary(std::move(files));
+        m_textDiff.compareBinary(details, job.stopToken);
+    };
+    if (files->hasBinaryHead())
+        return compareBinary();
+
+    auto contents = std::make_shared<DetailContents>();
+    if (m_textDiff.isLarge(job.size[0]) or m_textDiff.isLarge(job.size[1]))
+    {
+        // large files are not loaded, the pages are read from disk during the comparison and the display
+        for (int side = 0; side < 2; side++)
+        {
+            if (job.isRegular[side])
+                contents->mapped[side] = MappedFile{m_diffDirCtx.root[side].fd, job.relPath};
+        }
+        const std::string_view contentL = contents->mapped[0].content();
+        const std::string_view contentR = contents->mapped[1].content();
+        details.setContents(std::move(contents), 0, contentL, contentR);
+        m_textDiff.compareLarge(details, job.stopToken);
+        return;
+    }
+
+    for (int side = 0; side < 2; side++)
+    {
+        if (job.isRegular[side] and job.size[side] != 0 and
+            not read_content(m_diffDirCtx.root[side].fd, job.relPath, job.size[side], job.stopToken,
+                             contents->loaded[side]))
+            return; // cancelled
+    }
+    if (not TextDifference::isText(contents->loaded[0]) or not TextDifference::isText(contents->loaded[1]))
+        return compareBinary();
+    const std::string_view contentL = contents->loaded[0];
+    const std::string_view contentR = contents->loaded[1];
+    details.setContents(std::move(contents), contentL.size() + contentR.size(), contentL, contentR);
+    m_textDiff(details, job.stopToken);
+}
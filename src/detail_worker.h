@@ -0,0 +1,148 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Background computation of the content details in the interactive mode.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent.h"
+#include "report.h"
+#include "text_diff.h"
+
+/** Compute the content details of the selected difference on a worker thread.
+ *
+ * Only the last submitted job matters: submitting a job cancels the previous one,
+ * which stops reading the files and skips the comparison as soon as possible.
+ *
+ * When there is no submitted job, the details of the neighbouring differences are
+ * prefetched. A prefetch job continues as the submitted job when it computes the
+ * same difference, otherwise it is cancelled by the submitted job.
+ */
+class DetailWorker
+{
+public:
+    /// Content details of one difference
+    struct Result
+    {
+        uint64_t jobId;      ///< job which computed the result
+        int index;           ///< index of the difference
+        bool prefetched;     ///< whether the job was a prefetch job
+        TextDetails details; ///< lines to be displayed, referencing the compared contents
+    };
+
+    /** Start the worker thread.
+     *
+     * @param[in] diffDirCtx  diff dir context
+     * @param[in] textDiff    handler to compute difference on text files
+     * @param[in] onResult    called on the worker thread each time a result is available
+     */
+    DetailWorker(const Context &diffDirCtx, const TextDifference &textDiff, std::function<void()> onResult);
+    /// Cancel the jobs, the worker thread is joined as soon as the running job stops
+    ~DetailWorker();
+
+    // not copyable (detect unwanted copies)
+    DetailWorker(const DetailWorker &) = delete;
+    DetailWorker &operator=(const DetailWorker &) = delete;
+
+    /** Start computing the content details of a difference, cancelling the previous job.
+     *
+     * @param[in] index        index of the difference, given back in the result
+     * @param[in] reportEntry  difference with regular files on one side or both
+     */
+    void submit(int index, const ReportEntry &reportEntry);
+
+    /// Cancel the current job, if any
+    void cancel();
+
+    /** Add a difference to prefetch, after the already added ones.
+     *
+     * @param[in] index        index of the difference, given back in the result
+     * @param[in] reportEntry  difference with regular files on one side or both
+     */
+    void prefetch(int index, const ReportEntry &reportEntry);
+
+    /// Remove the differences waiting to be prefetched
+    void clearPrefetch();
+
+    /// Remove the differences waiting to be prefetched, and cancel the running prefetch job
+    void cancelPrefetch();
+
+    /// Get a computed result, nullopt if there is none
+    std::optional<Result> getResult()
+    {
+        return m_results.get(false);
+    }
+
+    /// Get whether a result comes from the last submitted job, which has not been cancelled
+    bool isCurrent(uint64_t jobId) const
+    {
+        return jobId == m_currentJobId;
+    }
+
+private:
+    /// Files to compare
+    struct Job
+    {
+        uint64_t id;               ///< identifier of the job
+        int index;                 ///< index of the difference
+        std::string relPath;       ///< relative path of the files
+        bool isRegular[2];         ///< whether the file is a regular file on each side
+        off_t size[2];             ///< size of the file on each side
+        bool prefetched;           ///< whether the job is a prefetch job
+        std::stop_token stopToken; ///< cancellation of the job
+    };
+
+    /// Build a job, with a new identifier
+    Job makeJob(int index, const ReportEntry &reportEntry, bool prefetched, std::stop_token stopToken);
+
+    /// Thread loop
+    void run(std::stop_token stopToken);
+
+    /// Compute the content details
+    void compute(const Job &job, TextDetails &details);
+
+    const Context &m_diffDirCtx;           ///< diff dir context
+    const TextDifference &m_textDiff;      ///< handler to compute difference on text files
+    std::function<void()> m_onResult;      ///< notification of the available results
+    uint64_t m_currentJobId;               ///< last submitted job, 0 if cancelled (UI thread only)
+    uint64_t m_lastJobId;                  ///< identifier of the last created job (UI thread only)
+    std::mutex m_mutex;                    ///< mutex for the jobs and their cancellation
+    std::condition_variable_any m_condVar; ///< condition variable to wake the worker
+    std::optional<Job> m_job;              ///< job waiting for the worker
+    std::stop_source m_stopSource;         ///< cancellation of the last submitted job
+    std::deque<Job> m_prefetchJobs;        ///< prefetch jobs waiting for the worker
+    std::optional<Job> m_prefetchRunning;  ///< prefetch job computed by the worker
+    std::stop_source m_prefetchStop;       ///< cancellation of the prefetch jobs
+    ConcurrentQueue<Result> m_results;     ///< results for the UI thread
+    std::jthread m_thread;                 ///< worker thread, last to be initialized
+};
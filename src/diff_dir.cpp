@@ -27,11 +27,30 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 #include <stack>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "change_source.h"
+#include "checksum.h"
 #include "diff_dir.h"
 #include "file_comp.h"
+#include "gitignore.h"
 #include "report.h"
 
+/// State of the ignore rules in a directory
+struct DirIgnoreState
+{
+    IgnoreFilter::State filter;                      ///< state of the user ignore rules
+    std::shared_ptr<const GitIgnoreLevel> gitIgnore; ///< ignore files found in the trees
+};
+
+/// Directory to be compared
+struct DirToCompare
+{
+    std::string relPath;        ///< relative path to roots
+    DirIgnoreState ignoreState; ///< state of the ignore rules in the directory, without its own ignore files
+};
+
 /// Determine directories differences
 struct DiffDir
 {
@@ -39,24 +58,82 @@ struct DiffDir
         : ctx{_ctx},
           dirContent{},
           dirStack{},
-          currDirStack{}
+          currDirStack{},
+          checksums{},
+          gitIgnore{},
+          contentRulesDir{},
+          contentRulesState{},
+          descendSameInode{true},
+          walkedTrees{},
+          checkedAncestors{},
+          comparedChildren{}
     {
+        if (ctx.settings.useChecksums or ctx.settings.contentPolicy == ContentPolicy::HashOnly or
+            (ctx.contentRules.has_value() and ctx.contentRules->usesDigests()))
+            checksums.emplace(ctx);
+        if (ctx.settings.gitIgnore)
+            gitIgnore.emplace(ctx);
     }
 
-    /** Run the comparison.
+    /** Run the comparison of the given candidates.
+     *
+     * @param[in,out] candidates  paths to compare, sorted and deduplicated in place
+     */
+    void compare_candidates(std::vector<ChangeCandidate> &candidates);
+
+    /** Compare one candidate and what is below, depending on its scope.
+     *
+     * @param[in] candidate  normalized candidate
+     */
+    void compare_candidate(const ChangeCandidate &candidate);
+
+    /** Check that all ancestors of a path are directories on both sides.
+     * The first ancestor that is not is reported, once.
+     *
+     * @param[in] relPath  relative path to roots
+     * @return whether the path can be compared
+     */
+    bool check_ancestors(const std::string &relPath);
+
+    /** Compare the directories from the stack, recursively.
      */
-    void operator()();
+    void walk();
 
     /** Handle an element existing only on one side.
      * 
-     * @param[in] relPath   relative path to entry
+     * @param[in] dirState  ignore state of the parent directory
+     * @param[in] dirPath   relative path of the parent directory
+     * @param[in] filename  name of the entry
      * @param[in] fileType  type of file
      * @param[in] side      which side the file is present
      */
-    inline void handle_single_side_entry(const std::string &relPath,
+    inline void handle_single_side_entry(const DirIgnoreState &dirState,
+                                         const std::string &dirPath,
+                                         const std::string &filename,
                                          FileType::EnumType fileType,
                                          Side side);
 
+    /** Compare an element existing on both sides.
+     * Directories to be compared are added to currDirStack.
+     *
+     * @param[in] dirState   ignore state of the parent directory
+     * @param[in] dirPath    relative path of the parent directory
+     * @param[in] filename   name of the entry
+     * @param[in] fileTypeL  type of the file on left side
+     * @param[in] fileTypeR  type of the file on right side
+     */
+    void compare_common_entry(const DirIgnoreState &dirState,
+                              const std::string &dirPath, const std::string &filename,
+                              FileType::EnumType fileTypeL, FileType::EnumType fileTypeR);
+
+    /** Add a directory existing on both sides to the directories to compare.
+     *
+     * @param[in] dir   directory to compare
+     * @param[in] inoL  inode of the directory on left side
+     * @param[in] inoR  inode of the directory on right side
+     */
+    void queue_directory(DirToCompare &&dir, ino_t inoL, ino_t inoR);
+
     /** Get the (sorted) content of both directories.
      * 
      * @param[in] dirPath relative path to roots
@@ -64,15 +141,96 @@ struct DiffDir
     void get_dirs_content(const std::string &dirPath);
 
     /** Compare the directories content.
+     * The ignore files of the directory are added to its ignore state.
      *
-     * @param[in] dirPath relative path to roots
+     * @param[in,out] dir directory to compare
+     */
+    void compare_dirs(DirToCompare &dir);
+
+    /** Get whether an entry of a directory is ignored, and the state for its own entries.
+     *
+     * @param[in]  dirState     ignore state of the parent directory
+     * @param[in]  relPath      relative path of the entry
+     * @param[in]  filename     name of the entry
+     * @param[in]  isDirectory  whether the entry is a directory
+     * @param[out] entryState   ignore state of the entry, if not nullptr
      */
-    void compare_dirs(const std::string &dirPath);
+    bool is_ignored(const DirIgnoreState &dirState, const std::string &relPath, const std::string &filename,
+                    bool isDirectory, DirIgnoreState *entryState) const
+    {
+        if (ctx.ignoreFilter.has_value() and
+            ctx.ignoreFilter->match(dirState.filter, filename, entryState ? &entryState->filter : nullptr))
+            return true;
+        if (GitIgnore::isIgnored(dirState.gitIgnore.get(), relPath, isDirectory))
+            return true;
+        if (entryState)
+            entryState->gitIgnore = dirState.gitIgnore;
+        return false;
+    }
+
+    /// Get whether a file is excluded by the filter expression
+    bool is_filtered(const std::string &relPath, FileType::EnumType fileType, const struct stat &statbuf) const
+    {
+        if (not ctx.entryFilter.has_value() or not ctx.entryFilter->matches(fileType, statbuf))
+            return false;
+        if (ctx.settings.debug)
+        {
+            std::cerr << "Filtered out: " << relPath << std::endl;
+        }
+        return true;
+    }
+
+    /// Get whether a directory existing on both sides is excluded by the filter expression
+    bool is_dir_filtered(const std::string &relPath) const
+    {
+        if (not ctx.entryFilter.has_value())
+            return false;
+        struct stat statbuf[2]{};
+        for (int side = 0; side < 2; side++)
+        {
+            if (ctx.entryFilter->needsStat())
+                ctx.root[side].lstat(relPath, statbuf[side]);
+            if (is_filtered(relPath, FileType::Directory, statbuf[side]))
+                return true;
+        }
+        return false;
+    }
+
+    /// Get the content policy of a regular file
+    ContentPolicy content_policy(const std::string &dirPath, const std::string &filename)
+    {
+        if (not ctx.contentRules.has_value())
+            return ctx.settings.contentPolicy;
+        if (dirPath != contentRulesDir)
+        {
+            // entries of a directory are compared together: keep the state of the last one
+            contentRulesState = ctx.contentRules->getState(dirPath);
+            contentRulesDir = dirPath;
+        }
+        return ctx.contentRules->policy(contentRulesState, filename).value_or(ctx.settings.contentPolicy);
+    }
+
+    /// Get the ignore state of a directory from its path
+    DirIgnoreState ignore_state(const std::string &dirPath)
+    {
+        return {ctx.ignoreFilter.has_value() ? ctx.ignoreFilter->getState(dirPath) : IgnoreFilter::State{},
+                gitIgnore.has_value() ? gitIgnore->stackOf(dirPath) : nullptr};
+    }
 
-    const Context &ctx;                   ///< context for the comparison
-    dir_content_type dirContent[2];       ///< content of the current directories on both sides
-    std::stack<std::string> dirStack;     ///< relPath of directories to compare
-    std::stack<std::string> currDirStack; ///< stack of sub-directories of the current directory
+    const Context &ctx;                      ///< context for the comparison
+    dir_content_type dirContent[2];          ///< content of the current directories on both sides
+    std::stack<DirToCompare> dirStack;       ///< directories to compare
+    std::stack<DirToCompare> currDirStack;   ///< stack of sub-directories of the current directory
+    std::optional<ChecksumReader> checksums; ///< digests stored alongside the files, when enabled
+    std::optional<GitIgnore> gitIgnore;      ///< ignore files found in the trees, when enabled
+    std::string contentRulesDir;             ///< directory of contentRulesState
+    ContentRules::State contentRulesState;   ///< state of the content rules in contentRulesDir
+
+    // comparison of candidates
+    bool descendSameInode;                                  ///< whether sub-directories with the same inode on both sides are compared
+    std::unordered_set<std::string> walkedTrees;            ///< directories compared recursively
+    std::unordered_map<std::string, bool> checkedAncestors; ///< whether an ancestor is a directory on both sides
+    std::unordered_set<std::string> comparedChildren;       ///< directories whose children have been compared
 };
 
 static inline std::string make_path(const std::string &dirPath, const std::string &filename)
@@ -82,9 +240,49 @@ static inline std::string make_path(const std::string &dirPath, const std::strin
     return dirPath + "/" + filename;
 }
 
-void DiffDir::handle_single_side_entry(const std::string &relPath, FileType::EnumType fileType, Side side)
+/// Split a relative path into its parent directory and its filename
+static inline std::pair<std::string, std::string> split_path(const std::string &relPath)
 {
-    if (ctx.ignoreFilter.has_value() and ctx.ignoreFilter->isIgnored(relPath))
+    const size_t sep = relPath.rfind('/');
+    if (sep == std::string::npos)
+        return {".", relPath};
+    return {relPath.substr(0, sep), relPath.substr(sep + 1)};
+}
+
+/// Normalize a candidate path: no leading ./, no trailing or duplicated /
+static std::string normalize_path(const std::string &path)
+{
+    std::string result{};
+    size_t pos = 0;
+    while (pos < path.size())
+    {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos)
+            end = path.size();
+        const std::string_view component{path.data() + pos, end - pos};
+        if (not component.empty() and component != ".")
+        {
+            if (not result.empty())
+                result += '/';
+            result += component;
+        }
+        pos = end + 1;
+    }
+    return result.empty() ? "." : result;
+}
+
+/// Check whether a normalized path has a .. component, which can lead out of the roots
+static bool has_parent_component(const std::string &path)
+{
+    return path == ".." or path.starts_with("../") or path.ends_with("/..") or
+           path.find("/../") != std::string::npos;
+}
+
+void DiffDir::handle_single_side_entry(const DirIgnoreState &dirState, const std::string &dirPath,
+                                       const std::string &filename, FileType::EnumType fileType, Side side)
+{
+    const std::string relPath = make_path(dirPath, filename);
+    if (is_ignored(dirState, relPath, filename, fileType == FileType::Directory, nullptr))
     {
         if (ctx.settings.debug)
         {
@@ -97,7 +295,180 @@ void DiffDir::handle_single_side_entry(const std::string &relPath, FileType::Enu
         reportEntry.setDifference(EntryDifference::EntryType);
         FileEntry &file = reportEntry.file[int(side)];
         file.set(ctx.root[int(side)], relPath, fileType);
+        if (not is_filtered(relPath, fileType, file.lstat))
+            ctx.dispatcher->postFilledReport(std::move(reportEntry));
+    }
+}
+
+void DiffDir::compare_common_entry(const DirIgnoreState &dirState,
+                                   const std::string &dirPath, const std::string &filename,
+                                   FileType::EnumType fileTypeL, FileType::EnumType fileTypeR)
+{
+    const std::string relPath = make_path(dirPath, filename);
+    DirIgnoreState entryState{};
+    const bool isDirectory = fileTypeL == FileType::Directory and fileTypeR == FileType::Directory;
+    // a directory on one side only is also matched by the directory rules of the ignore files
+    if (is_ignored(dirState, relPath, filename, fileTypeL == FileType::Directory or fileTypeR == FileType::Directory,
+                   isDirectory ? &entryState : nullptr))
+    {
+        if (ctx.settings.debug)
+        {
+            std::cerr << "Ignoring on both sides: " << relPath << std::endl;
+        }
+        return;
+    }
+
+    if (ctx.settings.structureOnly and fileTypeL == fileTypeR)
+    {
+        // same name and type: nothing else to compare, stat the files only when needed
+        struct stat statbuf[2]{};
+        if ((ctx.entryFilter.has_value() and ctx.entryFilter->needsStat()) or
+            (fileTypeL == FileType::Directory and not descendSameInode))
+        {
+            for (int side = 0; side < 2; side++)
+                ctx.root[side].lstat(relPath, statbuf[side]);
+        }
+        if (is_filtered(relPath, fileTypeL, statbuf[0]) or is_filtered(relPath, fileTypeR, statbuf[1]))
+            return;
+        if (fileTypeL == FileType::Directory)
+            queue_directory({relPath, std::move(entryState)}, statbuf[0].st_ino, statbuf[1].st_ino);
+        return;
+    }
+
+    ReportEntry reportEntry{relPath};
+    reportEntry.file[0].set(ctx.root[0], relPath, fileTypeL);
+    reportEntry.file[1].set(ctx.root[1], relPath, fileTypeR);
+
+    // filter on the attributes, before any content is read
+    if (is_filtered(relPath, fileTypeL, reportEntry.file[0].lstat) or
+        is_filtered(relPath, fileTypeR, reportEntry.file[1].lstat))
+        return;
+
+    if (fileTypeL != fileTypeR)
+    {
+        // type mismatch
+        reportEntry.setDifference(EntryDifference::EntryType);
         ctx.dispatcher->postFilledReport(std::move(reportEntry));
+        return;
+    }
+
+    // same filetype
+    // compare metadata
+    if (ctx.settings.checkMetadata)
+    {
+        // check owership
+        if (reportEntry.file[0].lstat.st_uid != reportEntry.file[1].lstat.st_uid or
+            reportEntry.file[0].lstat.st_gid != reportEntry.file[1].lstat.st_gid)
+        {
+            reportEntry.setDifference(EntryDifference::Ownership);
+        }
+
+        // check permissions
+        if (reportEntry.file[0].lstat.st_mode != reportEntry.file[1].lstat.st_mode)
+        {
+            reportEntry.setDifference(EntryDifference::Permissions);
+        }
+    }
+
+    // comparison based on filetype
+    switch (fileTypeL)
+    {
+    case FileType::Directory:
+        // directories: add to queue for comparison
+        queue_directory({relPath, std::move(entryState)}, reportEntry.file[0].lstat.st_ino, reportEntry.file[1].lstat.st_ino);
+        break;
+
+    case FileType::Regular:
+    {
+        // regular files: compare size, m_time then content
+        const ContentPolicy policy = content_policy(dirPath, filename);
+        if (policy == ContentPolicy::Skip)
+        {
+            // nothing to compare
+        }
+        else if (reportEntry.file[0].lstat.st_size != reportEntry.file[1].lstat.st_size)
+        {
+            // size is different
+            reportEntry.setDifference(EntryDifference::Size);
+        }
+        else if (reportEntry.file[0].lstat.st_size > 0 and
+                 not isContentTrusted(ctx.settings, policy, reportEntry.file[0].lstat, reportEntry.file[1].lstat))
+        {
+            /* files have the same size (> 0, with real content), but the content policy
+             * does not allow to trust them (different m_time by default)
+             * => check file content to see whether they are really different
+             */
+            // digests are used for the hash-only files, and with --checksums for the files not always verified
+            const bool useDigests =
+                policy == ContentPolicy::HashOnly or
+                (ctx.settings.useChecksums and policy != ContentPolicy::AlwaysVerify);
+            const std::optional<bool> sameDigest =
+                checksums.has_value() and useDigests
+                    ? checksums->sameDigest(dirPath, filename, reportEntry.file[0].lstat, reportEntry.file[1].lstat)
+                    : std::nullopt;
+            if (sameDigest.has_value())
+            {
+                // fresh digests on both sides: no need to read the content
+                if (not *sameDigest)
+                    reportEntry.setDifference(EntryDifference::Content);
+            }
+            else if (policy == ContentPolicy::HashOnly and
+                     isContentTrusted(ctx.settings, ContentPolicy::MtimeTrust, reportEntry.file[0].lstat,
+                                      reportEntry.file[1].lstat))
+            {
+                // without digests, hash-only falls back to mtime-trust
+                if (ctx.settings.debug)
+                {
+                    std::cerr << "File with same size and mtime but no digests, assumed equal: " << relPath
+                              << std::endl;
+                }
+            }
+            else
+            {
+                if (ctx.settings.debug)
+                {
+                    std::cerr << "File with same size but untrusted content, checking content: " << relPath << std::endl;
+                }
+                ctx.dispatcher->contentCompareWithPartialReport(std::move(reportEntry), reportEntry.file[0].lstat.st_size);
+                // report has been done, clear so that it is not done twice
+                reportEntry.clear();
+            }
+        }
+        break;
+    }
+
+    case FileType::Symlink:
+    {
+        // symlinks: compare the target names
+        if (reportEntry.file[0].symlinkTarget != reportEntry.file[1].symlinkTarget)
+        {
+            reportEntry.setDifference(EntryDifference::Content);
+        }
+        break;
+    }
+
+    default:
+        // TODO: additional checks for other types ?
+        break;
+    }
+
+    if (reportEntry.isDifferent())
+    {
+        ctx.dispatcher->postFilledReport(std::move(reportEntry));
+    }
+}
+
+void DiffDir::queue_directory(DirToCompare &&dir, ino_t inoL, ino_t inoR)
+{
+    if (descendSameInode)
+    {
+        currDirStack.emplace(std::move(dir));
+    }
+    else if (inoL != inoR)
+    {
+        // not the same directory in both snapshots: compare the whole tree
+        walkedTrees.insert(dir.relPath);
+        currDirStack.emplace(std::move(dir));
     }
 }
 
@@ -115,8 +486,12 @@ void DiffDir::get_dirs_content(const std::string &dirPath)
     }
 }
 
-void DiffDir::compare_dirs(const std::string &dirPath)
+void DiffDir::compare_dirs(DirToCompare &dir)
 {
+    const std::string &dirPath = dir.relPath;
+    if (gitIgnore.has_value())
+        dir.ignoreState.gitIgnore = gitIgnore->enter(dir.ignoreState.gitIgnore, dirPath, dirContent);
+
     // go through the 2 sorted directory entries
     auto itDirL = dirContent[0].cbegin();
     auto itDirR = dirContent[1].cbegin();
@@ -128,110 +503,17 @@ void DiffDir::compare_dirs(const std::string &dirPath)
 
         if (nameL < nameR)
         {
-            handle_single_side_entry(make_path(dirPath, nameL), itDirL->fileType, Side::Left);
+            handle_single_side_entry(dir.ignoreState, dirPath, nameL, itDirL->fileType, Side::Left);
             itDirL++;
         }
         else if (nameL > nameR)
         {
-            handle_single_side_entry(make_path(dirPath, nameR), itDirR->fileType, Side::Right);
+            handle_single_side_entry(dir.ignoreState, dirPath, nameR, itDirR->fileType, Side::Right);
             itDirR++;
         }
         else // nameL == nameR
         {
-            const std::string relPath = make_path(dirPath, nameL);
-            if (ctx.ignoreFilter.has_value() and ctx.ignoreFilter->isIgnored(relPath))
-            {
-                if (ctx.settings.debug)
-                {
-                    std::cerr << "Ignoring on both sides: " << relPath << std::endl;
-                }
-            }
-            else
-            {
-                const FileType::EnumType fileTypeL = itDirL->fileType;
-                const FileType::EnumType fileTypeR = itDirR->fileType;
-                ReportEntry reportEntry{relPath};
-                reportEntry.file[0].set(ctx.root[0], relPath, fileTypeL);
-                reportEntry.file[1].set(ctx.root[1], relPath, fileTypeR);
-
-                if (fileTypeL != fileTypeR)
-                {
-                    // type mismatch
-                    reportEntry.setDifference(EntryDifference::EntryType);
-                    ctx.dispatcher->postFilledReport(std::move(reportEntry));
-                }
-                else
-                {
-                    // same filetype
-                    // compare metadata
-                    if (ctx.settings.checkMetadata)
-                    {
-                        // check owership
-                        if (reportEntry.file[0].lstat.st_uid != reportEntry.file[1].lstat.st_uid or
-                            reportEntry.file[0].lstat.st_gid != reportEntry.file[1].lstat.st_gid)
-                        {
-                            reportEntry.setDifference(EntryDifference::Ownership);
-                        }
-
-                        // check permissions
-                        if (reportEntry.file[0].lstat.st_mode != reportEntry.file[1].lstat.st_mode)
-                        {
-                            reportEntry.setDifference(EntryDifference::Permissions);
-                        }
-                    }
-
-                    // comparison based on filetype
-                    switch (fileTypeL)
-                    {
-                    case FileType::Directory:
-                        // directories: add to queue for comparison
-                        currDirStack.emplace(relPath);
-                        break;
-
-                    case FileType::Regular:
-                        // regular files: compare size, m_time then content
-                        if (reportEntry.file[0].lstat.st_size != reportEntry.file[1].lstat.st_size)
-                        {
-                            // size is different
-                            reportEntry.setDifference(EntryDifference::Size);
-                        }
-                        else if (reportEntry.file[0].lstat.st_size > 0 and
-                                 reportEntry.file[0].lstat.st_mtim != reportEntry.file[1].lstat.st_mtim)
-                        {
-                            /* m_time are different, but files have the same size (> 0, with real content)
-                             * => check file content to see whether they are really different
-                             */
-                            if (ctx.settings.debug)
-                            {
-                                std::cerr << "File with same size but different m_time, checking content: " << relPath << std::endl;
-                            }
-                            ctx.dispatcher->contentCompareWithPartialReport(std::move(reportEntry), reportEntry.file[0].lstat.st_size);
-                            // report has been done, clear so that it is not done twice
-                            reportEntry.clear();
-                        }
-                        break;
-
-                    case FileType::Symlink:
-                    {
-                        // symlinks: compare the target names
-                        if (reportEntry.file[0].symlinkTarget != reportEntry.file[1].symlinkTarget)
-                        {
-                            reportEntry.setDifference(EntryDifference::Content);
-                        }
-                        break;
-                    }
-
-                    default:
-                        // TODO: additional checks for other types ?
-                        break;
-                    }
-
-                    if (reportEntry.isDifferent())
-                    {
-                        ctx.dispatcher->postFilledReport(std::move(reportEntry));
-                    }
-                }
-            }
+            compare_common_entry(dir.ignoreState, dirPath, nameL, itDirL->fileType, itDirR->fileType);
             itDirL++;
             itDirR++;
         }
@@ -240,12 +522,12 @@ void DiffDir::compare_dirs(const std::string &dirPath)
     // process remaining items on one side or the other
     while (itDirL != dirContent[0].cend())
     {
-        handle_single_side_entry(make_path(dirPath, itDirL->filename), itDirL->fileType, Side::Left);
+        handle_single_side_entry(dir.ignoreState, dirPath, itDirL->filename, itDirL->fileType, Side::Left);
         itDirL++;
     }
     while (itDirR != dirContent[1].cend())
     {
-        handle_single_side_entry(make_path(dirPath, itDirR->filename), itDirR->fileType, Side::Right);
+        handle_single_side_entry(dir.ignoreState, dirPath, itDirR->filename, itDirR->fileType, Side::Right);
         itDirR++;
     }
 
@@ -257,21 +539,168 @@ void DiffDir::compare_dirs(const std::string &dirPath)
     }
 }
 
-void DiffDir::operator()()
+void DiffDir::walk()
 {
-    dirStack.emplace("."); // start with empty relPath = root
-
     while (not ctx.exitRequested and not dirStack.empty())
     {
-        const std::string dirPath = std::move(dirStack.top());
+        DirToCompare dir = std::move(dirStack.top());
         dirStack.pop();
 
-        get_dirs_content(dirPath);
-        compare_dirs(dirPath);
+        get_dirs_content(dir.relPath);
+        compare_dirs(dir);
+    }
+}
+
+bool DiffDir::check_ancestors(const std::string &relPath)
+{
+    if (walkedTrees.contains("."))
+        return false; // everything already compared
+
+    size_t sep = 0;
+    while ((sep = relPath.find('/', sep)) != std::string::npos)
+    {
+        const std::string ancestor = relPath.substr(0, sep++);
+        if (walkedTrees.contains(ancestor))
+            return false; // already compared recursively
+
+        auto it = checkedAncestors.find(ancestor);
+        if (it == checkedAncestors.end())
+        {
+            const auto [dirPath, filename] = split_path(ancestor);
+            const DirIgnoreState dirState = ignore_state(dirPath);
+            if (is_ignored(dirState, ancestor, filename, true, nullptr))
+            {
+                if (ctx.settings.debug)
+                {
+                    std::cerr << "Ignoring ancestor: " << ancestor << std::endl;
+                }
+                checkedAncestors.emplace(ancestor, false);
+                return false;
+            }
+            const FileType::EnumType fileTypeL = ctx.root[0].getFileType(ancestor);
+            const FileType::EnumType fileTypeR = ctx.root[1].getFileType(ancestor);
+            const bool isDirectory = fileTypeL == FileType::Directory and fileTypeR == FileType::Directory and
+                                     not is_dir_filtered(ancestor);
+            if (not isDirectory and not comparedChildren.contains(dirPath))
+            {
+                // the difference is on the ancestor: report it instead of the candidate
+                if (fileTypeR == FileType::NoFile and fileTypeL != FileType::NoFile)
+                    handle_single_side_entry(dirState, dirPath, filename, fileTypeL, Side::Left);
+                else if (fileTypeL == FileType::NoFile and fileTypeR != FileType::NoFile)
+                    handle_single_side_entry(dirState, dirPath, filename, fileTypeR, Side::Right);
+                else if (fileTypeL != FileType::NoFile)
+                    compare_common_entry(dirState, dirPath, filename, fileTypeL, fileTypeR);
+            }
+            it = checkedAncestors.emplace(ancestor, isDirectory).first;
+        }
+        if (not it->second)
+            return false;
+    }
+    return true;
+}
+
+void DiffDir::compare_candidate(const ChangeCandidate &candidate)
+{
+    const std::string &relPath = candidate.relPath;
+    DirToCompare dir{relPath, {}};
+    bool descend = true;
+
+    if (relPath != ".")
+    {
+        if (not check_ancestors(relPath))
+            return;
+
+        const FileType::EnumType fileTypeL = ctx.root[0].getFileType(relPath);
+        const FileType::EnumType fileTypeR = ctx.root[1].getFileType(relPath);
+        const auto [dirPath, filename] = split_path(relPath);
+        const DirIgnoreState dirState = ignore_state(dirPath);
+        descend = fileTypeL == FileType::Directory and fileTypeR == FileType::Directory and
+                  not is_ignored(dirState, relPath, filename, true, &dir.ignoreState) and not is_dir_filtered(relPath);
+        checkedAncestors.emplace(relPath, descend);
+
+        if (comparedChildren.contains(dirPath))
+        {
+            // entry already compared with its siblings
+        }
+        else if (fileTypeL != FileType::NoFile and fileTypeR != FileType::NoFile)
+        {
+            compare_common_entry(dirState, dirPath, filename, fileTypeL, fileTypeR);
+            currDirStack = {}; // descent depends on the scope of the candidate
+        }
+        else if (fileTypeL != FileType::NoFile)
+        {
+            handle_single_side_entry(dirState, dirPath, filename, fileTypeL, Side::Left);
+        }
+        else if (fileTypeR != FileType::NoFile)
+        {
+            handle_single_side_entry(dirState, dirPath, filename, fileTypeR, Side::Right);
+        }
+    }
+    if (not descend)
+        return;
+
+    switch (candidate.scope)
+    {
+    case ChangeCandidate::Entry:
+        break;
+
+    case ChangeCandidate::Children:
+        descendSameInode = false;
+        get_dirs_content(relPath);
+        compare_dirs(dir);
+        comparedChildren.insert(relPath);
+        descendSameInode = true;
+        walk();
+        break;
+
+    case ChangeCandidate::Recursive:
+        walkedTrees.insert(relPath);
+        dirStack.emplace(std::move(dir));
+        walk();
+        break;
+    }
+}
+
+void DiffDir::compare_candidates(std::vector<ChangeCandidate> &candidates)
+{
+    for (ChangeCandidate &candidate : candidates)
+        candidate.relPath = normalize_path(candidate.relPath);
+    std::erase_if(candidates,
+                  [&](const ChangeCandidate &candidate)
+                  {
+                      if (not has_parent_component(candidate.relPath))
+                          return false;
+                      if (ctx.settings.debug)
+                      {
+                          std::cerr << "Skipping candidate with ..: " << candidate.relPath << std::endl;
+                      }
+                      return true;
+                  });
+
+    // sorted paths: ancestors come before their descendants
+    std::sort(candidates.begin(), candidates.end());
+
+    if (ctx.settings.debug)
+    {
+        std::cerr << "Comparing " << candidates.size() << " candidates" << std::endl;
+    }
+
+    for (size_t i = 0; i < candidates.size() and not ctx.exitRequested; i++)
+    {
+        // same path several times: keep the widest scope, sorted last
+        if (i + 1 < candidates.size() and candidates[i + 1].relPath == candidates[i].relPath)
+            continue;
+        compare_candidate(candidates[i]);
     }
 }
 
 void diff_dirs(const Context &ctx)
 {
-    DiffDir(ctx).operator()();
-}
\ No newline at end of file
+    std::vector<ChangeCandidate> candidates{};
+    if (not ctx.changeSource or not ctx.changeSource->getCandidates(candidates))
+    {
+        // compare everything from the roots
+        candidates.assign(1, ChangeCandidate{".", ChangeCandidate::Recursive});
+    }
+    DiffDir(ctx).compare_candidates(candidates);
+}
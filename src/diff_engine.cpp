@@ -0,0 +1,155 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Line difference algorithms, on sequences of line identifiers.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "diff_engine.h"
+#include "dtl.hpp"
+
+/// Occurrences of a line in 2 sequences
+struct LineOccurrence
+{
+    uint32_t countA; ///< number of occurrences in a
+    uint32_t countB; ///< number of occurrences in b
+    uint32_t posB;   ///< position of the last occurrence in b
+};
+
+std::vector<DiffAnchor> findUniqueAnchors(std::span<const line_id> a, std::span<const line_id> b)
+{
+    // lines unique on both sides, in the order of a
+    std::vector<DiffAnchor> unique{};
+    {
+        std::unordered_map<line_id, LineOccurrence> occurrences{};
+        occurrences.reserve(a.size());
+        for (line_id id : a)
+            occurrences.try_emplace(id, LineOccurrence{0, 0, 0}).first->second.countA++;
+        for (uint32_t i = 0; i < b.size(); i++)
+        {
+            const auto it = occurrences.find(b[i]);
+            if (it != occurrences.end())
+            {
+                it->second.countB++;
+                it->second.posB = i;
+            }
+        }
+        for (uint32_t i = 0; i < a.size(); i++)
+        {
+            const LineOccurrence &occurrence = occurrences.find(a[i])->second;
+            if (occurrence.countA == 1 and occurrence.countB == 1)
+                unique.push_back({i, occurrence.posB});
+        }
+    }
+
+    // longest increasing sequence on the position in b, by patience sorting:
+    // each pile keeps its top card, each card links to the top of the previous pile when it was placed
+    std::vector<uint32_t> tops{};
+    std::vector<uint32_t> previous(unique.size());
+    for (uint32_t i = 0; i < unique.size(); i++)
+    {
+        const auto pile = std::lower_bound(tops.begin(), tops.end(), unique[i].posB,
+                                           [&](uint32_t top, uint32_t posB) { return unique[top].posB < posB; });
+        previous[i] = pile == tops.begin() ? UINT32_MAX : *(pile - 1);
+        if (pile == tops.end())
+            tops.push_back(i);
+        else
+            *pile = i;
+    }
+
+    // walk back from the top of the last pile
+    std::vector<DiffAnchor> anchors(tops.size());
+    uint32_t card = tops.empty() ? UINT32_MAX : tops.back();
+    for (auto it = anchors.rbegin(); it != anchors.rend(); it++)
+    {
+        *it = unique[card];
+        card = previous[card];
+    }
+    return anchors;
+}
+
+void appendDiffMyers(std::span<const line_id> a, std::span<const line_id> b, uint32_t offsetA, uint32_t offsetB,
+                     std::vector<DiffEdit> &script)
+{
+    if (a.empty() or b.empty())
+    {
+        // trivial cases, no need for dtl
+        for (uint32_t i = 0; i < a.size(); i++)
+            script.push_back({DiffEdit::Delete, offsetA + i});
+        for (uint32_t i = 0; i < b.size(); i++)
+            script.push_back({DiffEdit::Add, offsetB + i});
+        return;
+    }
+
+    const std::vector<line_id> seqA{a.begin(), a.end()};
+    const std::vector<line_id> seqB{b.begin(), b.end()};
+    dtl::Diff<line_id, std::vector<line_id>> diff{seqA, seqB, true};
+    diff.enableTrivial();
+    diff.enableHuge();
+    diff.compose();
+
+    // dtl positions start at 1
+    for (const auto &[id, info] : diff.getSes().getSequence())
+    {
+        switch (info.type)
+        {
+        case dtl::SES_COMMON:
+            script.push_back({DiffEdit::Common, offsetA + uint32_t(info.beforeIdx - 1)});
+            break;
+        case dtl::SES_DELETE:
+            script.push_back({DiffEdit::Delete, offsetA + uint32_t(info.beforeIdx - 1)});
+            break;
+        case dtl::SES_ADD:
+            script.push_back({DiffEdit::Add, offsetB + uint32_t(info.afterIdx - 1)});
+            break;
+        }
+    }
+}
+
+/// DiffEngine using dtl on the whole sequences
+class DiffEngineMyers : public DiffEngine
+{
+public:
+    void diff(std::span<const line_id> a, std::span<const line_id> b, std::vector<DiffEdit> &script,
+              std::stop_token stopToken) const override
+    {
+        if (not stopToken.stop_requested())
+            appendDiffMyers(a, b, 0, 0, script);
+    }
+};
+
+std::unique_ptr<DiffEngine> makeDiffEngineMyers()
+{
+    return std::make_unique<DiffEngineMyers>();
+}
+
+std::unique_ptr<DiffEngine> makeDiffEngine(const std::string &name)
+{
+    if (name == "myers")
+        return makeDiffEngineMyers();
+    if (name == "patience")
+        return makeDiffEnginePatience();
+    if (name == "histogram")
+        return makeDiffEngineHistogram();
+    return nullptr;
+}
@@ -0,0 +1,166 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Line difference algorithms, on sequences of line identifiers.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "concurrent.h"
+
+/// Identifier of a line: equal lines have the same identifier
+typedef uint32_t line_id;
+
+/// One step of an edit script
+struct DiffEdit
+{
+    /// Kind of step
+    enum Type : uint8_t
+    {
+        Common, ///< line in both sequences
+        Delete, ///< line only in the first sequence
+        Add,    ///< line only in the second sequence
+    };
+
+    Type type;    ///< kind of step
+    uint32_t pos; ///< position of the line, in the first sequence for Common and Delete, in the second for Add
+};
+
+/// Ranges of lines differing between 2 sequences, the lines before and after are common
+struct DiffHunk
+{
+    uint32_t beginA; ///< first position in the first sequence
+    uint32_t endA;   ///< end position in the first sequence
+    uint32_t beginB; ///< first position in the second sequence
+    uint32_t endB;   ///< end position in the second sequence
+};
+
+/// Pair of matching positions in 2 sequences
+struct DiffAnchor
+{
+    uint32_t posA; ///< position in the first sequence
+    uint32_t posB; ///< position in the second sequence
+};
+
+/// Algorithm computing the differences between 2 sequences of lines
+class DiffEngine
+{
+public:
+    virtual ~DiffEngine() = default;
+
+    /** Compute an edit script transforming a into b.
+     *
+     * @param[in]  a          first sequence
+     * @param[in]  b          second sequence
+     * @param[out] script     edit script, in the order of the sequences
+     * @param[in]  stopToken  cancellation, the script is incomplete when stop is requested
+     */
+    virtual void diff(std::span<const line_id> a, std::span<const line_id> b, std::vector<DiffEdit> &script,
+                      std::stop_token stopToken = {}) const = 0;
+
+    /** Find common lines splitting the comparison: the script of the whole sequences is the
+     * concatenation of the scripts of the ranges between them, computed by this engine.
+     *
+     * @param[in] a  first sequence, without the lines common at the beginning and at the end
+     * @param[in] b  second sequence, without the lines common at the beginning and at the end
+     * @return anchors, increasing on both sides, empty if the engine cannot split the sequences
+     */
+    virtual std::vector<DiffAnchor> splitAnchors(std::span<const line_id> /*a*/, std::span<const line_id> /*b*/) const
+    {
+        return {};
+    }
+};
+
+/// Build the DiffEngine using the O(NP) algorithm of dtl (Wu, Manber, Myers)
+std::unique_ptr<DiffEngine> makeDiffEngineMyers();
+
+/** Build the DiffEngine using the patience algorithm: the lines unique on both sides
+ * are matched first, the ranges in between are compared recursively.
+ */
+std::unique_ptr<DiffEngine> makeDiffEnginePatience();
+
+/** Build the DiffEngine using the histogram algorithm: the common region with the
+ * least frequent lines is matched first, the ranges around are compared recursively.
+ */
+std::unique_ptr<DiffEngine> makeDiffEngineHistogram();
+
+/** Build a DiffEngine from its name: myers, patience or histogram.
+ * @return engine, or nullptr if the name is unknown
+ */
+std::unique_ptr<DiffEngine> makeDiffEngine(const std::string &name);
+
+/** Find the lines occurring once in each sequence, and keep the longest chain
+ * of them in the same order on both sides.
+ *
+ * @param[in] a  first sequence
+ * @param[in] b  second sequence
+ * @return anchors, increasing on both sides
+ */
+std::vector<DiffAnchor> findUniqueAnchors(std::span<const line_id> a, std::span<const line_id> b);
+
+/** Compute an edit script with an engine, splitting the sequences into independent segments
+ * compared in parallel.
+ *
+ * The segments are separated by the anchors given by DiffEngine::splitAnchors, so that the
+ * script is the same as the one of the whole sequences. The sequences are compared as a whole
+ * by the engines which cannot split them.
+ *
+ * @param[in]  engine       algorithm comparing each segment
+ * @param[in]  a            first sequence
+ * @param[in]  b            second sequence
+ * @param[out] script       edit script, in the order of the sequences
+ * @param[in]  pool         threads comparing the segments
+ * @param[in]  segmentSize  minimal number of lines of a segment, on both sides
+ * @param[in]  stopToken    cancellation, the script is incomplete when stop is requested
+ */
+void diffSegmented(const DiffEngine &engine, std::span<const line_id> a, std::span<const line_id> b,
+                   std::vector<DiffEdit> &script, ThreadPool &pool, size_t segmentSize, std::stop_token stopToken = {});
+
+/** Append the edit script of 2 ranges to a script, with the O(NP) algorithm.
+ * Used by the engines splitting the sequences, on ranges without anchor.
+ *
+ * @param[in]     a        range of the first sequence
+ * @param[in]     b        range of the second sequence
+ * @param[in]     offsetA  position of the range in the first sequence
+ * @param[in]     offsetB  position of the range in the second sequence
+ * @param[in,out] script   edit script to complete
+ */
+void appendDiffMyers(std::span<const line_id> a, std::span<const line_id> b, uint32_t offsetA, uint32_t offsetB,
+                     std::vector<DiffEdit> &script);
+
+/** Compute the differing ranges of 2 sequences, in linear space: divide and conquer
+ * on the middle snake (Myers), the memory does not depend on the number of differences.
+ *
+ * @param[in]  a          first sequence
+ * @param[in]  b          second sequence
+ * @param[in]  maxCost    ranges needing more edits are reported as one hunk, without looking for common lines inside
+ * @param[out] hunks      differing ranges, in the order of the sequences
+ * @param[in]  stopToken  cancellation, the hunks are incomplete when stop is requested
+ */
+void diffHunksLinear(std::span<const line_id> a, std::span<const line_id> b, uint32_t maxCost,
+                     std::vector<DiffHunk> &hunks, std::stop_token stopToken = {});
@@ -0,0 +1,174 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Histogram difference algorithm, as in JGit and git diff --histogram.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "diff_engine.h"
+
+/// DiffEngine matching the common region with the least frequent lines first
+class DiffEngineHistogram : public DiffEngine
+{
+public:
+    void diff(std::span<const line_id> a, std::span<const line_id> b, std::vector<DiffEdit> &script,
+              std::stop_token stopToken) const override
+    {
+        script.reserve(std::max(a.size(), b.size()));
+        diffRange(a, b, 0, 0, script, stopToken, 0);
+    }
+
+private:
+    /// Lines occurring more often in a are not used to find regions
+    static constexpr uint32_t maxOccurrences = 64;
+    /// Deeper ranges are compared with the O(NP) algorithm
+    static constexpr unsigned maxDepth = 64;
+
+    /// Common region of the ranges
+    struct Region
+    {
+        uint32_t beginA;      ///< first position in a
+        uint32_t beginB;      ///< first position in b
+        uint32_t length;      ///< number of lines
+        uint32_t occurrences; ///< lowest number of occurrences in a of the lines of the region
+    };
+
+    /// Occurrences of a line in a
+    struct Chain
+    {
+        uint32_t first; ///< first position, the next ones are chained
+        uint32_t count; ///< number of occurrences
+    };
+
+    /// Compare 2 ranges, offsets are the positions of the ranges in the whole sequences
+    static void diffRange(std::span<const line_id> a, std::span<const line_id> b, uint32_t offsetA, uint32_t offsetB,
+                          std::vector<DiffEdit> &script, const std::stop_token &stopToken, unsigned depth);
+
+    /** Find the common region with the least frequent lines, the longest one in case of tie.
+     * @return region, with length 0 if there is no line with few occurrences in common
+     */
+    static Region findRegion(std::span<const line_id> a, std::span<const line_id> b);
+};
+
+DiffEngineHistogram::Region DiffEngineHistogram::findRegion(std::span<const line_id> a, std::span<const line_id> b)
+{
+    // histogram of a: number of occurrences of each line, and chain of its positions
+    std::unordered_map<line_id, Chain> chains{};
+    chains.reserve(a.size());
+    std::vector<uint32_t> next(a.size());
+    for (uint32_t i = a.size(); i-- > 0;)
+    {
+        Chain &chain = chains.try_emplace(a[i], Chain{UINT32_MAX, 0}).first->second;
+        next[i] = chain.first;
+        chain.first = i;
+        chain.count++;
+    }
+
+    Region best{0, 0, 0, maxOccurrences + 1};
+    uint32_t j = 0;
+    while (j < b.size())
+    {
+        const auto it = chains.find(b[j]);
+        // a more frequent line cannot start a better region: the region would be found from its rarest line
+        if (it == chains.end() or it->second.count > best.occurrences)
+        {
+            j++;
+            continue;
+        }
+
+        uint32_t nextJ = j + 1;
+        for (uint32_t i = it->second.first; i != UINT32_MAX; i = next[i])
+        {
+            // extend the match in both directions
+            Region region{i, j, 1, it->second.count};
+            while (region.beginA > 0 and region.beginB > 0 and a[region.beginA - 1] == b[region.beginB - 1])
+            {
+                region.beginA--;
+                region.beginB--;
+                region.length++;
+            }
+            while (region.beginA + region.length < a.size() and region.beginB + region.length < b.size() and
+                   a[region.beginA + region.length] == b[region.beginB + region.length])
+                region.length++;
+            for (uint32_t k = 0; k < region.length; k++)
+                region.occurrences = std::min(region.occurrences, chains.find(a[region.beginA + k])->second.count);
+
+            if (region.occurrences < best.occurrences or
+                (region.occurrences == best.occurrences and region.length > best.length))
+                best = region;
+            nextJ = std::max(nextJ, region.beginB + region.length);
+        }
+        j = nextJ;
+    }
+    if (best.occurrences > maxOccurrences)
+        best.length = 0;
+    return best;
+}
+
+void DiffEngineHistogram::diffRange(std::span<const line_id> a, std::span<const line_id> b, uint32_t offsetA,
+                                    uint32_t offsetB, std::vector<DiffEdit> &script, const std::stop_token &stopToken,
+                                    unsigned depth)
+{
+    if (stopToken.stop_requested())
+        return;
+
+    // common prefix and suffix
+    size_t prefix = 0;
+    while (prefix < a.size() and prefix < b.size() and a[prefix] == b[prefix])
+        script.push_back({DiffEdit::Common, offsetA + uint32_t(prefix++)});
+    size_t suffix = 0;
+    while (suffix < a.size() - prefix and suffix < b.size() - prefix and
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+        suffix++;
+    const std::span<const line_id> midA = a.subspan(prefix, a.size() - prefix - suffix);
+    const std::span<const line_id> midB = b.subspan(prefix, b.size() - prefix - suffix);
+    const uint32_t midOffsetA = offsetA + prefix;
+    const uint32_t midOffsetB = offsetB + prefix;
+
+    const Region region = midA.empty() or midB.empty() or depth >= maxDepth ? Region{0, 0, 0, 0} : findRegion(midA, midB);
+    if (region.length == 0)
+    {
+        // nothing to split on: compare the whole range
+        appendDiffMyers(midA, midB, midOffsetA, midOffsetB, script);
+    }
+    else
+    {
+        // compare before and after the region
+        diffRange(midA.first(region.beginA), midB.first(region.beginB), midOffsetA, midOffsetB, script, stopToken,
+                  depth + 1);
+        for (uint32_t k = 0; k < region.length; k++)
+            script.push_back({DiffEdit::Common, midOffsetA + region.beginA + k});
+        const uint32_t endA = region.beginA + region.length;
+        const uint32_t endB = region.beginB + region.length;
+        diffRange(midA.subspan(endA), midB.subspan(endB), midOffsetA + endA, midOffsetB + endB, script, stopToken,
+                  depth + 1);
+    }
+
+    for (size_t i = a.size() - suffix; i < a.size(); i++)
+        script.push_back({DiffEdit::Common, offsetA + uint32_t(i)});
+}
+
+std::unique_ptr<DiffEngine> makeDiffEngineHistogram()
+{
+    return std::make_unique<DiffEngineHistogram>();
+}
@@ -0,0 +1,187 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Linear space difference algorithm, for the huge files.
+ */
+
+#include <algorithm>
+
+#include "diff_engine.h"
+
+/// Divide and conquer on the middle snake of Myers' O(ND) algorithm
+class LinearDiff
+{
+public:
+    LinearDiff(std::span<const line_id> _a, std::span<const line_id> _b, uint32_t _maxCost,
+               std::vector<DiffHunk> &_hunks, const std::stop_token &_stopToken)
+        : a{_a},
+          b{_b},
+          maxStep{std::min<size_t>((size_t(_maxCost) + 1) / 2, (a.size() + b.size() + 1) / 2)},
+          offset{int64_t(maxStep) + 1},
+          forward(2 * maxStep + 3),
+          backward(2 * maxStep + 3),
+          hunks{_hunks},
+          stopToken{_stopToken}
+    {
+    }
+
+    /// Compare the ranges [beginA, endA[ and [beginB, endB[
+    void compare(uint32_t beginA, uint32_t endA, uint32_t beginB, uint32_t endB);
+
+private:
+    /// Common lines crossing the middle of the shortest edit path
+    struct Snake
+    {
+        uint32_t beginA; ///< first common position in a
+        uint32_t beginB; ///< first common position in b
+        uint32_t endA;   ///< end of the common positions in a
+        uint32_t endB;   ///< end of the common positions in b
+    };
+
+    /** Find the middle snake of the ranges, which have no common prefix nor suffix.
+     * @return false if the ranges need too many edits
+     */
+    bool middleSnake(uint32_t beginA, uint32_t endA, uint32_t beginB, uint32_t endB, Snake &snake);
+
+    /// Add a differing range, merged with the previous one if contiguous
+    void addHunk(uint32_t beginA, uint32_t endA, uint32_t beginB, uint32_t endB);
+
+    const std::span<const line_id> a; ///< first sequence
+    const std::span<const line_id> b; ///< second sequence
+    const size_t maxStep;             ///< maximal number of edits searched from each end of a range
+    const int64_t offset;             ///< index of the diagonal 0 in forward and backward
+    std::vector<int64_t> forward;     ///< furthest position in a on each diagonal, from the beginning
+    std::vector<int64_t> backward;    ///< furthest position in a on each diagonal, from the end
+    std::vector<DiffHunk> &hunks;     ///< differing ranges
+    const std::stop_token &stopToken; ///< cancellation
+};
+
+void LinearDiff::addHunk(uint32_t beginA, uint32_t endA, uint32_t beginB, uint32_t endB)
+{
+    if (not hunks.empty() and hunks.back().endA == beginA and hunks.back().endB == beginB)
+    {
+        hunks.back().endA = endA;
+        hunks.back().endB = endB;
+    }
+    else
+        hunks.push_back({beginA, endA, beginB, endB});
+}
+
+bool LinearDiff::middleSnake(uint32_t beginA, uint32_t endA, uint32_t beginB, uint32_t endB, Snake &snake)
+{
+    const int64_t n = endA - beginA;
+    const int64_t m = endB - beginB;
+    const int64_t delta = n - m;
+    const bool odd = delta & 1;
+    const int64_t maxD = std::min<int64_t>(maxStep, (n + m + 1) / 2);
+
+    // diagonal k: x - y = k, x and y relative to the beginning (forward) or to the end (backward)
+    forward[offset + 1] = 0;
+    backward[offset + 1] = 0;
+    for (int64_t d = 0; d <= maxD; d++)
+    {
+        if (stopToken.stop_requested())
+            return false;
+
+        for (int64_t k = -d; k <= d; k += 2)
+        {
+            int64_t x = k == -d or (k != d and forward[offset + k - 1] < forward[offset + k + 1])
+                            ? forward[offset + k + 1]
+                            : forward[offset + k - 1] + 1;
+            int64_t y = x - k;
+            const int64_t x0 = x, y0 = y;
+            while (x < n and y < m and a[beginA + x] == b[beginB + y])
+            {
+                x++;
+                y++;
+            }
+            forward[offset + k] = x;
+            // overlap with the backward path of the previous step, on the same diagonal
+            const int64_t kb = delta - k;
+            if (odd and kb >= -(d - 1) and kb <= d - 1 and x + backward[offset + kb] >= n)
+            {
+                snake = {uint32_t(beginA + x0), uint32_t(beginB + y0), uint32_t(beginA + x), uint32_t(beginB + y)};
+                return true;
+            }
+        }
+
+        for (int64_t k = -d; k <= d; k += 2)
+        {
+            int64_t x = k == -d or (k != d and backward[offset + k - 1] < backward[offset + k + 1])
+                            ? backward[offset + k + 1]
+                            : backward[offset + k - 1] + 1;
+            int64_t y = x - k;
+            const int64_t x0 = x, y0 = y;
+            while (x < n and y < m and a[endA - 1 - x] == b[endB - 1 - y])
+            {
+                x++;
+                y++;
+            }
+            backward[offset + k] = x;
+            // overlap with the forward path of the same step, on the same diagonal
+            const int64_t kf = delta - k;
+            if (not odd and kf >= -d and kf <= d and x + forward[offset + kf] >= n)
+            {
+                snake = {uint32_t(endA - x), uint32_t(endB - y), uint32_t(endA - x0), uint32_t(endB - y0)};
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void LinearDiff::compare(uint32_t beginA, uint32_t endA, uint32_t beginB, uint32_t endB)
+{
+    // common prefix and suffix
+    while (beginA < endA and beginB < endB and a[beginA] == b[beginB])
+    {
+        beginA++;
+        beginB++;
+    }
+    while (beginA < endA and beginB < endB and a[endA - 1] == b[endB - 1])
+    {
+        endA--;
+        endB--;
+    }
+
+    if (beginA == endA or beginB == endB)
+    {
+        if (beginA != endA or beginB != endB)
+            addHunk(beginA, endA, beginB, endB);
+        return;
+    }
+
+    Snake snake;
+    if (not middleSnake(beginA, endA, beginB, endB, snake))
+    {
+        // too expensive, or cancelled: the whole range differs
+        addHunk(beginA, endA, beginB, endB);
+        return;
+    }
+    compare(beginA, snake.beginA, beginB, snake.beginB);
+    compare(snake.endA, endA, snake.endB, endB);
+}
+
+void diffHunksLinear(std::span<const line_id> a, std::span<const line_id> b, uint32_t maxCost,
+                     std::vector<DiffHunk> &hunks, std::stop_token stopToken)
+{
+    LinearDiff{a, b, maxCost, hunks, stopToken}.compare(0, a.size(), 0, b.size());
+}
@@ -0,0 +1,100 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Patience difference algorithm.
+ */
+
+#include <algorithm>
+
+#include "diff_engine.h"
+
+/// DiffEngine matching the lines unique on both sides first
+class DiffEnginePatience : public DiffEngine
+{
+public:
+    void diff(std::span<const line_id> a, std::span<const line_id> b, std::vector<DiffEdit> &script,
+              std::stop_token stopToken) const override
+    {
+        script.reserve(std::max(a.size(), b.size()));
+        diffRange(a, b, 0, 0, script, stopToken);
+    }
+
+    /// The ranges between the unique lines are compared recursively by diff
+    std::vector<DiffAnchor> splitAnchors(std::span<const line_id> a, std::span<const line_id> b) const override
+    {
+        return findUniqueAnchors(a, b);
+    }
+
+private:
+    /// Compare 2 ranges, offsets are the positions of the ranges in the whole sequences
+    static void diffRange(std::span<const line_id> a, std::span<const line_id> b, uint32_t offsetA, uint32_t offsetB,
+                          std::vector<DiffEdit> &script, const std::stop_token &stopToken);
+};
+
+void DiffEnginePatience::diffRange(std::span<const line_id> a, std::span<const line_id> b, uint32_t offsetA,
+                                   uint32_t offsetB, std::vector<DiffEdit> &script, const std::stop_token &stopToken)
+{
+    if (stopToken.stop_requested())
+        return;
+
+    // common prefix and suffix
+    size_t prefix = 0;
+    while (prefix < a.size() and prefix < b.size() and a[prefix] == b[prefix])
+        script.push_back({DiffEdit::Common, offsetA + uint32_t(prefix++)});
+    size_t suffix = 0;
+    while (suffix < a.size() - prefix and suffix < b.size() - prefix and
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+        suffix++;
+    const std::span<const line_id> midA = a.subspan(prefix, a.size() - prefix - suffix);
+    const std::span<const line_id> midB = b.subspan(prefix, b.size() - prefix - suffix);
+    const uint32_t midOffsetA = offsetA + prefix;
+    const uint32_t midOffsetB = offsetB + prefix;
+
+    // lines unique on both sides, in the same order
+    const std::vector<DiffAnchor> anchors = findUniqueAnchors(midA, midB);
+    if (anchors.empty())
+    {
+        // nothing to split on: compare the whole range
+        appendDiffMyers(midA, midB, midOffsetA, midOffsetB, script);
+    }
+    else
+    {
+        // compare between the anchors
+        uint32_t posA = 0, posB = 0;
+        for (const DiffAnchor &anchor : anchors)
+        {
+            diffRange(midA.subspan(posA, anchor.posA - posA), midB.subspan(posB, anchor.posB - posB),
+                      midOffsetA + posA, midOffsetB + posB, script, stopToken);
+            script.push_back({DiffEdit::Common, midOffsetA + anchor.posA});
+            posA = anchor.posA + 1;
+            posB = anchor.posB + 1;
+        }
+        diffRange(midA.subspan(posA), midB.subspan(posB), midOffsetA + posA, midOffsetB + posB, script, stopToken);
+    }
+
+    for (size_t i = a.size() - suffix; i < a.size(); i++)
+        script.push_back({DiffEdit::Common, offsetA + uint32_t(i)});
+}
+
+std::unique_ptr<DiffEngine> makeDiffEnginePatience()
+{
+    return std::make_unique<DiffEnginePatience>();
+}
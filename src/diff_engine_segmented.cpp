@@ -0,0 +1,117 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Parallel comparison of independent segments of the sequences.
+ */
+
+#include "diff_engine.h"
+
+/// Segment of the sequences, between 2 anchors
+struct DiffSegment
+{
+    uint32_t beginA;                     ///< first position in a
+    uint32_t endA;                       ///< end position in a, position of the anchor closing the segment
+    uint32_t beginB;                     ///< first position in b
+    uint32_t endB;                       ///< end position in b, position of the anchor closing the segment
+    std::span<const DiffAnchor> anchors; ///< anchors inside the segment, positions in the whole sequences
+    std::vector<DiffEdit> script;        ///< edit script of the segment, without the closing anchor
+};
+
+/// Append the script of the ranges of a segment to its script, with positions in the whole sequences
+static void diffSegment(const DiffEngine &engine, std::span<const line_id> a, std::span<const line_id> b,
+                        DiffSegment &segment, const std::stop_token &stopToken)
+{
+    std::vector<DiffEdit> rangeScript{};
+    uint32_t posA = segment.beginA, posB = segment.beginB;
+    const auto diffRange = [&](uint32_t endA, uint32_t endB)
+    {
+        rangeScript.clear();
+        engine.diff(a.subspan(posA, endA - posA), b.subspan(posB, endB - posB), rangeScript, stopToken);
+        for (DiffEdit edit : rangeScript)
+        {
+            edit.pos += edit.type == DiffEdit::Add ? posB : posA;
+            segment.script.push_back(edit);
+        }
+    };
+
+    for (const DiffAnchor &anchor : segment.anchors)
+    {
+        diffRange(anchor.posA, anchor.posB);
+        segment.script.push_back({DiffEdit::Common, anchor.posA});
+        posA = anchor.posA + 1;
+        posB = anchor.posB + 1;
+    }
+    diffRange(segment.endA, segment.endB);
+}
+
+void diffSegmented(const DiffEngine &engine, std::span<const line_id> a, std::span<const line_id> b,
+                   std::vector<DiffEdit> &script, ThreadPool &pool, size_t segmentSize, std::stop_token stopToken)
+{
+    // common prefix and suffix
+    uint32_t prefix = 0;
+    while (prefix < a.size() and prefix < b.size() and a[prefix] == b[prefix])
+        prefix++;
+    uint32_t suffix = 0;
+    while (suffix < a.size() - prefix and suffix < b.size() - prefix and
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+        suffix++;
+    const uint32_t endA = a.size() - suffix, endB = b.size() - suffix;
+
+    // anchors given by the engine, grouped into segments of at least segmentSize lines
+    std::vector<DiffAnchor> anchors{};
+    std::vector<DiffSegment> segments{};
+    if (endA - prefix + endB - prefix >= 2 * segmentSize and pool.concurrency() > 1)
+        anchors = engine.splitAnchors(a.subspan(prefix, endA - prefix), b.subspan(prefix, endB - prefix));
+    uint32_t beginA = prefix, beginB = prefix;
+    size_t firstAnchor = 0;
+    for (size_t i = 0; i < anchors.size(); i++)
+    {
+        DiffAnchor &anchor = anchors[i];
+        anchor.posA += prefix;
+        anchor.posB += prefix;
+        if (anchor.posA - beginA < segmentSize or anchor.posB - beginB < segmentSize)
+            continue;
+        segments.push_back({beginA, anchor.posA, beginB, anchor.posB,
+                            std::span{anchors}.subspan(firstAnchor, i - firstAnchor), {}});
+        beginA = anchor.posA + 1;
+        beginB = anchor.posB + 1;
+        firstAnchor = i + 1;
+    }
+    if (segments.empty())
+        return engine.diff(a, b, script, stopToken); // nothing to split
+    segments.push_back({beginA, endA, beginB, endB, std::span{anchors}.subspan(firstAnchor), {}});
+
+    pool.parallelFor(segments.size(), [&](size_t index) { diffSegment(engine, a, b, segments[index], stopToken); });
+    if (stopToken.stop_requested())
+        return;
+
+    // stitch the scripts of the segments
+    for (uint32_t i = 0; i < prefix; i++)
+        script.push_back({DiffEdit::Common, i});
+    for (const DiffSegment &segment : segments)
+    {
+        script.insert(script.end(), segment.script.begin(), segment.script.end());
+        if (segment.endA != endA)
+            script.push_back({DiffEdit::Common, segment.endA});
+    }
+    for (uint32_t i = endA; i < a.size(); i++)
+        script.push_back({DiffEdit::Common, i});
+}
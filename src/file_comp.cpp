@@ -24,30 +24,169 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <fstream>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 
 #include "file_comp.h"
 #include "log.h"
 
-bool FileCompareContent::operator()(const std::string &relPath, size_t fileSize)
+/// ExtentProvider using the FS_IOC_FIEMAP ioctl
+class ExtentProviderFiemap : public ExtentProvider
 {
-    ScopedFd fdL = ScopedFd::openat(ctx.root[0].fd, relPath, O_RDONLY);
-    ScopedFd fdR = ScopedFd::openat(ctx.root[1].fd, relPath, O_RDONLY);
+public:
+    bool getExtents(int fd, size_t size, std::vector<FileExtent> &extents) override;
 
-    if (!fdL.isValid() or !fdR.isValid())
-        return false; // cannot compare files => consider them different
+private:
+    static constexpr int maxExtents = 128; ///< number of extents retrieved per ioctl
+};
+
+bool ExtentProviderFiemap::getExtents(int fd, size_t size, std::vector<FileExtent> &extents)
+{
+    extents.clear();
+
+    union
+    {
+        struct fiemap fiemap;
+        uint8_t raw[sizeof(struct fiemap) + maxExtents * sizeof(struct fiemap_extent)];
+    } buffer;
+
+    uint64_t start = 0;
+    while (start < size)
+    {
+        std::memset(&buffer.fiemap, 0, sizeof(buffer.fiemap));
+        buffer.fiemap.fm_start = start;
+        buffer.fiemap.fm_length = size - start;
+        buffer.fiemap.fm_extent_count = maxExtents;
+        // write the dirty pages first: shared extents could hold stale data of a file modified in the page cache
+        if (start == 0)
+            buffer.fiemap.fm_flags = FIEMAP_FLAG_SYNC;
+        if (::ioctl(fd, FS_IOC_FIEMAP, &buffer.fiemap) < 0)
+            return false; // not supported by the filesystem
+
+        const uint32_t nbExtents = buffer.fiemap.fm_mapped_extents;
+        if (nbExtents == 0)
+            break; // no more extents: remaining part is a hole
+
+        for (uint32_t i = 0; i < nbExtents; i++)
+        {
+            const struct fiemap_extent &extent = buffer.fiemap.fm_extents[i];
+            extents.emplace_back(extent.fe_logical, extent.fe_physical, extent.fe_length, extent.fe_flags);
+        }
+        if ((extents.back().flags & FIEMAP_EXTENT_LAST) != 0)
+            break;
+        start = extents.back().logical + extents.back().length;
+    }
+    return true;
+}
+
+std::shared_ptr<ExtentProvider> makeExtentProviderFiemap()
+{
+    return std::make_shared<ExtentProviderFiemap>();
+}
+
+/// Extent flags for which the physical location does not identify the content
+static constexpr uint32_t unreliableExtentFlags =
+    FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_DATA_ENCRYPTED |
+    FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL |
+    FIEMAP_EXTENT_UNWRITTEN;
+
+void FileCompareContent::determineRanges(int fdL, int fdR, size_t fileSize)
+{
+    m_ranges.clear();
+
+    // physical offsets on different devices say nothing about the content
+    dev_t device[2];
+    if (m_extentProvider and
+        m_extentProvider->getDevice(fdL, device[0]) and
+        m_extentProvider->getDevice(fdR, device[1]) and
+        device[0] == device[1] and
+        m_extentProvider->getExtents(fdL, fileSize, m_extents[0]) and
+        m_extentProvider->getExtents(fdR, fileSize, m_extents[1]))
+    {
+        // go through both extent maps, keep the ranges that are not shared
+        uint64_t compareStart = 0; // start of the range not shared yet
+        auto itL = m_extents[0].cbegin();
+        auto itR = m_extents[1].cbegin();
+        while (itL != m_extents[0].cend() and itR != m_extents[1].cend())
+        {
+            const uint64_t endL = itL->logical + itL->length;
+            const uint64_t endR = itR->logical + itR->length;
+            const uint64_t start = std::max(itL->logical, itR->logical);
+            const uint64_t end = std::min({endL, endR, (uint64_t)fileSize});
+
+            const bool reliable = ((itL->flags | itR->flags) & unreliableExtentFlags) == 0;
+            // encoded (compressed) extents can only be shared as a whole
+            const bool encoded = ((itL->flags | itR->flags) & FIEMAP_EXTENT_ENCODED) != 0;
+            const bool shared = encoded
+                                    ? itL->logical == itR->logical and itL->physical == itR->physical and itL->length == itR->length
+                                    : itL->physical - itL->logical == itR->physical - itR->logical;
+            if (start < end and reliable and shared)
+            {
+                // [start, end) is the same physical data on both sides
+                if (compareStart < start)
+                    m_ranges.emplace_back(compareStart, start);
+                compareStart = end;
+            }
+
+            // go to next extent
+            if (endL <= endR)
+                itL++;
+            else
+                itR++;
+        }
+        if (compareStart < fileSize)
+            m_ranges.emplace_back(compareStart, fileSize);
+    }
+    else
+    {
+        // no comparable extent maps: compare everything
+        m_ranges.emplace_back(0, fileSize);
+    }
+}
 
-    while (fileSize > 0)
+bool FileCompareContent::compareRange(int fdL, int fdR, const range_type &range, const std::string &relPath)
+{
+    uint64_t offset = range.first;
+    while (offset < range.second)
     {
-        ssize_t dataReadL = ::read(fdL.fd, m_contentBuffL.get(), ctx.settings.contentBufferSize);
-        ssize_t dataReadR = ::read(fdR.fd, m_contentBuffR.get(), dataReadL);
-        if (dataReadL < 0 or dataReadR != dataReadL)
+        const size_t toRead = std::min<uint64_t>(ctx.settings.contentBufferSize, range.second - offset);
+        ssize_t dataReadL = ::pread(fdL, m_contentBuffL.get(), toRead, offset);
+        ssize_t dataReadR = ::pread(fdR, m_contentBuffR.get(), toRead, offset);
+        if (dataReadL <= 0 or dataReadR != dataReadL)
         {
-            log_errno("read", relPath);
+            log_errno("pread", relPath);
             return false; // cannot compare files => consider them different
         }
         if (::memcmp(m_contentBuffL.get(), m_contentBuffR.get(), dataReadL) != 0)
             return false; // exit on first diff
-        fileSize -= dataReadL;
+        offset += dataReadL;
+    }
+    return true;
+}
+
+bool FileCompareContent::operator()(const std::string &relPath, size_t fileSize)
+{
+    ScopedFd fdL = ScopedFd::openat(ctx.root[0].fd, relPath, O_RDONLY);
+    ScopedFd fdR = ScopedFd::openat(ctx.root[1].fd, relPath, O_RDONLY);
+
+    if (!fdL.isValid() or !fdR.isValid())
+        return false; // cannot compare files => consider them different
+
+    determineRanges(fdL.fd, fdR.fd, fileSize);
+
+    if (ctx.settings.debug and (m_ranges.size() != 1 or m_ranges[0].second - m_ranges[0].first != fileSize))
+    {
+        uint64_t toCompare = 0;
+        for (const auto &range : m_ranges)
+            toCompare += range.second - range.first;
+        std::cerr << "Shared extents, comparing " << toCompare << " of " << fileSize << " bytes: " << relPath << std::endl;
+    }
+
+    for (const auto &range : m_ranges)
+    {
+        if (not compareRange(fdL.fd, fdR.fd, range, relPath))
+            return false;
     }
     return true;
-}
\ No newline at end of file
+}
@@ -25,17 +25,64 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <memory.h>
+#include <memory>
+#include <sys/stat.h>
+#include <vector>
 
 #include "context.h"
 
+/// Mapping of a range of a file to its physical location
+struct FileExtent
+{
+    uint64_t logical;  ///< offset of the extent in the file
+    uint64_t physical; ///< offset of the extent on the device
+    uint64_t length;   ///< length of the extent
+    uint32_t flags;    ///< FIEMAP_EXTENT_* flags
+};
+
+/// Provide the extent map of files
+class ExtentProvider
+{
+public:
+    virtual ~ExtentProvider() = default;
+
+    /** Get the extents of a file, after writing its data still in the page cache.
+     * @param[in]  fd       file handle
+     * @param[in]  size     size of the file
+     * @param[out] extents  extents of the file, sorted by logical offset
+     * @return false if the extent map is not available
+     */
+    virtual bool getExtents(int fd, size_t size, std::vector<FileExtent> &extents) = 0;
+
+    /** Get the device holding a file: physical offsets can only be compared on the same device.
+     * @param[in]  fd      file handle
+     * @param[out] device  device of the file
+     * @return false if the device is not available
+     */
+    virtual bool getDevice(int fd, dev_t &device)
+    {
+        struct stat statbuf;
+        if (::fstat(fd, &statbuf) < 0)
+            return false;
+        device = statbuf.st_dev;
+        return true;
+    }
+};
+
+/// Build an ExtentProvider using FS_IOC_FIEMAP
+std::shared_ptr<ExtentProvider> makeExtentProviderFiemap();
+
 class FileCompareContent
 {
 public:
-    FileCompareContent(const Context &context)
+    FileCompareContent(const Context &context, std::shared_ptr<ExtentProvider> extentProvider = makeExtentProviderFiemap())
         : ctx{context},
           // TODO: use std::make_unique_for_overwrite when available
           m_contentBuffL{new uint8_t[context.settings.contentBufferSize]},
-          m_contentBuffR{new uint8_t[context.settings.contentBufferSize]}
+          m_contentBuffR{new uint8_t[context.settings.contentBufferSize]},
+          m_extentProvider{std::move(extentProvider)},
+          m_extents{},
+          m_ranges{}
     {
     }
 
@@ -43,7 +90,7 @@ public:
 
     // copyable
     FileCompareContent(const FileCompareContent &other)
-        : FileCompareContent{other.ctx}
+        : FileCompareContent{other.ctx, other.m_extentProvider}
     {
     }
     // not assign copyable (no default constructor)
@@ -53,7 +100,10 @@ public:
     FileCompareContent(FileCompareContent &&other) noexcept
         : ctx{other.ctx},
           m_contentBuffL{std::exchange(other.m_contentBuffL, nullptr)},
-          m_contentBuffR{std::exchange(other.m_contentBuffR, nullptr)}
+          m_contentBuffR{std::exchange(other.m_contentBuffR, nullptr)},
+          m_extentProvider{std::move(other.m_extentProvider)},
+          m_extents{std::move(other.m_extents[0]), std::move(other.m_extents[1])},
+          m_ranges{std::move(other.m_ranges)}
     {
     }
     // not assign movable (no default constructor)
@@ -67,6 +117,26 @@ public:
     bool operator()(const std::string &relPath, size_t fileSize);
 
 private:
+    /// Range of the files to be compared, [start, end)
+    typedef std::pair<uint64_t, uint64_t> range_type;
+
+    /** Determine the ranges of the files that need to be read.
+     * Ranges where both files share the same physical extents (reflinks, snapshots) are skipped,
+     * when both files are on the same device.
+     * @param[in] fdL       left file handle
+     * @param[in] fdR       right file handle
+     * @param[in] fileSize  size of both files
+     */
+    void determineRanges(int fdL, int fdR, size_t fileSize);
+
+    /** Compare one range of the files.
+     * @return whether the files contents match on this range
+     */
+    bool compareRange(int fdL, int fdR, const range_type &range, const std::string &relPath);
+
     const Context &ctx;
     std::unique_ptr<uint8_t[]> m_contentBuffL, m_contentBuffR; ///< buffer for file content on both sides
+    std::shared_ptr<ExtentProvider> m_extentProvider;          ///< provider of extent maps, may be null
+    std::vector<FileExtent> m_extents[2];                      ///< extents of the files on both sides
+    std::vector<range_type> m_ranges;                          ///< ranges of the files to be compared
 };
\ No newline at end of file
@@ -0,0 +1,492 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Filter expressions on the attributes of the files.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+#include "filter.h"
+
+/// Recursive descent parser producing the postfix program
+class EntryFilter::Parser
+{
+public:
+    Parser(const std::string &expression, EntryFilter &filter)
+        : m_str{expression}, m_pos{0}, m_token{}, m_depth{0}, m_now{::time(nullptr)}, m_filter{filter}, m_error{}
+    {
+    }
+
+    /// Parse the whole expression, get the error or an empty string
+    std::string parse()
+    {
+        parseOr();
+        if (m_error.empty() and peek() != End)
+            m_error = "unexpected '" + std::string{m_token} + "'";
+        return m_error;
+    }
+
+private:
+    /// Kind of token
+    enum Token
+    {
+        End,
+        Word,
+        LParen,
+        RParen,
+        Not,
+        And,
+        Or,
+        Operator,
+    };
+
+    /// Get the next token without consuming it, its text is in m_token
+    Token peek()
+    {
+        while (m_pos < m_str.size() and std::isspace(static_cast<unsigned char>(m_str[m_pos])))
+            m_pos++;
+        if (m_pos >= m_str.size())
+        {
+            m_token = {};
+            return End;
+        }
+
+        const std::string_view rest = std::string_view{m_str}.substr(m_pos);
+        for (const auto &[text, token] : {std::pair{"&&", And}, {"||", Or}, {"==", Operator}, {"!=", Operator},
+                                          {"<=", Operator}, {">=", Operator}, {"(", LParen}, {")", RParen},
+                                          {"!", Not}, {"<", Operator}, {">", Operator}, {"=", Operator}})
+        {
+            if (rest.starts_with(text))
+            {
+                m_token = rest.substr(0, std::string_view{text}.size());
+                return token;
+            }
+        }
+
+        size_t len = 0;
+        while (len < rest.size() and not std::isspace(static_cast<unsigned char>(rest[len])) and
+               std::string_view{"()!<>=&|"}.find(rest[len]) == std::string_view::npos)
+            len++;
+        m_token = rest.substr(0, len);
+        if (m_token == "and")
+            return And;
+        if (m_token == "or")
+            return Or;
+        if (m_token == "not")
+            return Not;
+        return Word;
+    }
+
+    /// Consume the token returned by peek
+    void consume()
+    {
+        m_pos += m_token.size();
+    }
+
+    /// Add an instruction, keeping track of the stack depth
+    void emit(Opcode opcode, Field field = Field::Size, Compare cmp = Compare::Eq, int64_t value = 0)
+    {
+        if (opcode == Opcode::Test)
+        {
+            if (++m_depth > maxDepth and m_error.empty())
+                m_error = "expression too complex";
+        }
+        else if (opcode != Opcode::Not)
+        {
+            m_depth--;
+        }
+        m_filter.m_program.push_back({opcode, field, cmp, value});
+    }
+
+    void parseOr()
+    {
+        parseAnd();
+        while (m_error.empty() and peek() == Or)
+        {
+            consume();
+            parseAnd();
+            emit(Opcode::Or);
+        }
+    }
+
+    void parseAnd()
+    {
+        parseNot();
+        while (m_error.empty() and peek() == And)
+        {
+            consume();
+            parseNot();
+            emit(Opcode::And);
+        }
+    }
+
+    void parseNot()
+    {
+        if (peek() == Not)
+        {
+            consume();
+            parseNot();
+            emit(Opcode::Not);
+        }
+        else
+        {
+            parsePrimary();
+        }
+    }
+
+    void parsePrimary()
+    {
+        if (not m_error.empty())
+            return;
+
+        const Token token = peek();
+        if (token == LParen)
+        {
+            consume();
+            parseOr();
+            if (m_error.empty() and peek() != RParen)
+                m_error = "missing ')'";
+            consume();
+            return;
+        }
+        if (token != Word)
+        {
+            m_error = token == End ? "unexpected end of expression" : "unexpected '" + std::string{m_token} + "'";
+            return;
+        }
+
+        const std::string field{m_token};
+        consume();
+        if (peek() != Operator)
+        {
+            m_error = "missing comparison after '" + field + "'";
+            return;
+        }
+        Compare cmp = Compare::Eq;
+        if (m_token == "!=")
+            cmp = Compare::Ne;
+        else if (m_token == "<")
+            cmp = Compare::Lt;
+        else if (m_token == "<=")
+            cmp = Compare::Le;
+        else if (m_token == ">")
+            cmp = Compare::Gt;
+        else if (m_token == ">=")
+            cmp = Compare::Ge;
+        consume();
+        if (peek() != Word)
+        {
+            m_error = "missing value after '" + field + "'";
+            return;
+        }
+        const std::string value{m_token};
+        consume();
+
+        if (field == "size")
+        {
+            const auto size = parseScaled(value, {{"K", 1LL << 10}, {"M", 1LL << 20}, {"G", 1LL << 30}, {"T", 1LL << 40}});
+            if (not size.has_value())
+                m_error = "invalid size '" + value + "'";
+            emit(Opcode::Test, Field::Size, cmp, size.value_or(0));
+            m_filter.m_needsStat = true;
+        }
+        else if (field == "mtime")
+        {
+            const auto range = parseTime(value);
+            if (not range.has_value())
+                m_error = "invalid time '" + value + "'";
+            emitTimeRange(cmp, range.value_or(TimeRange{0, 0}));
+            m_filter.m_needsStat = true;
+        }
+        else if (field == "age")
+        {
+            // age is compiled as a modification time, in the opposite direction
+            const auto age = parseScaled(value, {{"s", 1}, {"m", 60}, {"h", 3600}, {"d", 86400}, {"w", 604800}});
+            const auto mtime = age.has_value() ? secondsToNs(m_now - *age) : std::nullopt;
+            if (not mtime.has_value())
+                m_error = "invalid age '" + value + "'";
+            static constexpr Compare reversed[] = {Compare::Eq, Compare::Ne, Compare::Gt,
+                                                   Compare::Ge, Compare::Lt, Compare::Le};
+            emit(Opcode::Test, Field::Mtime, reversed[int(cmp)], mtime.value_or(0));
+            m_filter.m_needsStat = true;
+        }
+        else if (field == "type")
+        {
+            const auto fileType = parseType(value);
+            if (not fileType.has_value())
+                m_error = "invalid type '" + value + "'";
+            else if (cmp != Compare::Eq and cmp != Compare::Ne)
+                m_error = "type can only be compared with == and !=";
+            emit(Opcode::Test, Field::Type, cmp, fileType.value_or(FileType::NoFile));
+        }
+        else
+        {
+            m_error = "unknown attribute '" + field + "'";
+        }
+    }
+
+    /// Parse a number with an optional unit
+    static std::optional<int64_t> parseScaled(const std::string &str,
+                                              std::initializer_list<std::pair<std::string_view, int64_t>> units)
+    {
+        size_t end = 0;
+        double number;
+        try
+        {
+            number = std::stod(str, &end);
+        }
+        catch (const std::exception &)
+        {
+            return {};
+        }
+        if (number < 0 or not std::isfinite(number))
+            return {};
+
+        const std::string_view unit = std::string_view{str}.substr(end);
+        int64_t multiplier = 1;
+        if (not unit.empty())
+        {
+            const auto it = std::find_if(units.begin(), units.end(), [&](const auto &u)
+                                         { return u.first == unit; });
+            if (it == units.end())
+                return {};
+            multiplier = it->second;
+        }
+        const double scaled = number * double(multiplier);
+        if (scaled >= 0x1p63)
+            return {};
+        return int64_t(scaled);
+    }
+
+    /// Convert seconds since the epoch to nanoseconds, if representable
+    static std::optional<int64_t> secondsToNs(int64_t seconds)
+    {
+        static constexpr int64_t nsPerSecond = 1000000000;
+        if (seconds > std::numeric_limits<int64_t>::max() / nsPerSecond or
+            seconds < std::numeric_limits<int64_t>::min() / nsPerSecond)
+            return {};
+        return seconds * nsPerSecond;
+    }
+
+    /// Range of times designated by a date, in nanoseconds since the epoch
+    struct TimeRange
+    {
+        int64_t begin; ///< first time of the range
+        int64_t end;   ///< end of the range, excluded
+    };
+
+    /** Parse a date in local time, or @seconds since the epoch.
+     * @return range of the times matching the date at its precision: second, minute or day
+     */
+    static std::optional<TimeRange> parseTime(const std::string &str)
+    {
+        if (str.starts_with('@'))
+        {
+            char *end;
+            errno = 0;
+            const long long seconds = std::strtoll(str.c_str() + 1, &end, 10);
+            if (end == str.c_str() + 1 or *end != '\0' or errno == ERANGE)
+                return {};
+            return makeTimeRange(seconds, seconds + 1);
+        }
+        for (const char *format : {"%Y-%m-%dT%H:%M:%S", "%Y-%m-%dT%H:%M", "%Y-%m-%d"})
+        {
+            struct tm tm{};
+            const char *end = ::strptime(str.c_str(), format, &tm);
+            if (end != nullptr and *end == '\0')
+            {
+                tm.tm_isdst = -1;
+                struct tm next = tm;
+                if (std::string_view{format}.ends_with("%S"))
+                    next.tm_sec++;
+                else if (std::string_view{format}.ends_with("%M"))
+                    next.tm_min++;
+                else
+                    next.tm_mday++;
+                return makeTimeRange(::mktime(&tm), ::mktime(&next));
+            }
+        }
+        return {};
+    }
+
+    /// Build a TimeRange from seconds since the epoch, if representable
+    static std::optional<TimeRange> makeTimeRange(int64_t begin, int64_t end)
+    {
+        const auto beginNs = secondsToNs(begin), endNs = secondsToNs(end);
+        if (not beginNs.has_value() or not endNs.has_value())
+            return {};
+        return TimeRange{*beginNs, *endNs};
+    }
+
+    /// Add the comparison of the modification time with a range: equal means within the range
+    void emitTimeRange(Compare cmp, TimeRange range)
+    {
+        switch (cmp)
+        {
+        case Compare::Eq:
+            emit(Opcode::Test, Field::Mtime, Compare::Ge, range.begin);
+            emit(Opcode::Test, Field::Mtime, Compare::Lt, range.end);
+            emit(Opcode::And);
+            break;
+        case Compare::Ne:
+            emit(Opcode::Test, Field::Mtime, Compare::Lt, range.begin);
+            emit(Opcode::Test, Field::Mtime, Compare::Ge, range.end);
+            emit(Opcode::Or);
+            break;
+        case Compare::Lt:
+        case Compare::Ge:
+            emit(Opcode::Test, Field::Mtime, cmp, range.begin);
+            break;
+        case Compare::Le:
+            emit(Opcode::Test, Field::Mtime, Compare::Lt, range.end);
+            break;
+        case Compare::Gt:
+            emit(Opcode::Test, Field::Mtime, Compare::Ge, range.end);
+            break;
+        }
+    }
+
+    /// Parse the name of a file type
+    static std::optional<FileType::EnumType> parseType(const std::string &str)
+    {
+        static const std::pair<const char *, FileType::EnumType> names[] = {
+            {"file", FileType::Regular},
+            {"dir", FileType::Directory},
+            {"symlink", FileType::Symlink},
+            {"socket", FileType::Socket},
+            {"fifo", FileType::Fifo},
+            {"block", FileType::Block},
+            {"char", FileType::Character},
+        };
+        for (const auto &[name, fileType] : names)
+        {
+            if (str == name)
+                return fileType;
+        }
+        return {};
+    }
+
+    const std::string &m_str; ///< expression
+    size_t m_pos;             ///< position of the next token
+    std::string_view m_token; ///< text of the last peeked token
+    size_t m_depth;           ///< depth of the evaluation stack
+    time_t m_now;             ///< reference time for the ages
+    EntryFilter &m_filter;    ///< filter being compiled
+    std::string m_error;      ///< first error
+};
+
+std::optional<EntryFilter> EntryFilter::compile(const std::string &expression, std::string &error)
+{
+    EntryFilter filter{};
+    error = Parser{expression, filter}.parse();
+    if (not error.empty())
+        return {};
+    return filter;
+}
+
+bool EntryFilter::matches(FileType::EnumType fileType, const struct stat &statbuf) const
+{
+    // stacks of booleans, top at bit 0; the value of an unknown result is meaningless
+    uint64_t stack = 0;
+    uint64_t known = 0;
+    for (const Instruction &instruction : m_program)
+    {
+        switch (instruction.opcode)
+        {
+        case Opcode::Test:
+        {
+            int64_t actual = 0;
+            bool isKnown = true; // size and mtime of a directory do not apply to its entries
+            switch (instruction.field)
+            {
+            case Field::Size:
+                isKnown = fileType != FileType::Directory;
+                actual = statbuf.st_size;
+                break;
+            case Field::Mtime:
+                isKnown = fileType != FileType::Directory;
+                actual = int64_t(statbuf.st_mtim.tv_sec) * 1000000000LL + statbuf.st_mtim.tv_nsec;
+                break;
+            case Field::Type:
+                actual = fileType;
+                break;
+            }
+
+            bool result = false;
+            switch (instruction.cmp)
+            {
+            case Compare::Eq:
+                result = actual == instruction.value;
+                break;
+            case Compare::Ne:
+                result = actual != instruction.value;
+                break;
+            case Compare::Lt:
+                result = actual < instruction.value;
+                break;
+            case Compare::Le:
+                result = actual <= instruction.value;
+                break;
+            case Compare::Gt:
+                result = actual > instruction.value;
+                break;
+            case Compare::Ge:
+                result = actual >= instruction.value;
+                break;
+            }
+            stack = (stack << 1) | uint64_t(result);
+            known = (known << 1) | uint64_t(isKnown);
+            break;
+        }
+
+        case Opcode::Not:
+            stack ^= 1;
+            break;
+
+        case Opcode::And:
+        {
+            // known if both are known, or if one is known to be false
+            const uint64_t isKnown = (known & (known >> 1)) | (known & ~stack) | ((known & ~stack) >> 1);
+            stack = ((stack >> 2) << 1) | (stack & (stack >> 1) & 1);
+            known = ((known >> 2) << 1) | (isKnown & 1);
+            break;
+        }
+
+        case Opcode::Or:
+        {
+            // known if both are known, or if one is known to be true
+            const uint64_t isKnown = (known & (known >> 1)) | (known & stack) | ((known & stack) >> 1);
+            stack = ((stack >> 2) << 1) | ((stack | (stack >> 1)) & 1);
+            known = ((known >> 2) << 1) | (isKnown & 1);
+            break;
+        }
+        }
+    }
+    return stack & known & 1;
+}
@@ -0,0 +1,123 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Filter expressions on the attributes of the files.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "path.h"
+
+/** Filter expression on the attributes of a file, like "size>1G or type==socket".
+ *
+ * Comparisons:
+ * - size: size in bytes, with an optional unit K, M, G, T (powers of 1024)
+ * - mtime: modification time, as YYYY-MM-DD[THH:MM[:SS]] in local time, or @seconds since the epoch
+ *   compared at the precision of the date: mtime==2020-05-01 matches the whole day, mtime>2020-05-01 the next days
+ * - age: time elapsed since the modification, with an optional unit s, m, h, d, w (seconds by default)
+ * - type: file, dir, symlink, socket, fifo, block, char (only == and !=)
+ *
+ * Operators: ==, !=, <, <=, >, >= and not, and, or (also !, &&, ||), with parentheses.
+ *
+ * The size, mtime and age of a directory are unknown: a directory, and thus its whole tree, matches
+ * only if the result does not depend on them, like "type==dir" or "type==dir or size>1G".
+ *
+ * The expression is compiled into a postfix program evaluated without allocation.
+ */
+class EntryFilter
+{
+public:
+    /** Compile an expression.
+     *
+     * @param[in]  expression  expression given by the user
+     * @param[out] error       description of the error, if the expression is invalid
+     * @return compiled filter, or nullopt if the expression is invalid
+     */
+    static std::optional<EntryFilter> compile(const std::string &expression, std::string &error);
+
+    /// Get whether the expression needs the stat of the file, not only its type
+    bool needsStat() const
+    {
+        return m_needsStat;
+    }
+
+    /** Evaluate the expression on a file.
+     *
+     * @param[in] fileType  type of the file
+     * @param[in] statbuf   lstat of the file, may be left empty if needsStat() is false
+     * @return whether the file matches the expression, false if the result is unknown
+     */
+    bool matches(FileType::EnumType fileType, const struct stat &statbuf) const;
+
+private:
+    /// Kind of instruction
+    enum class Opcode : uint8_t
+    {
+        Test, ///< push the result of a comparison
+        Not,  ///< negate the top of the stack
+        And,  ///< replace the 2 values at the top of the stack by their conjunction
+        Or,   ///< replace the 2 values at the top of the stack by their disjunction
+    };
+
+    /// Attribute of the file
+    enum class Field : uint8_t
+    {
+        Size,  ///< size in bytes
+        Mtime, ///< modification time in ns since the epoch
+        Type,  ///< FileType
+    };
+
+    /// Comparison operator
+    enum class Compare : uint8_t
+    {
+        Eq,
+        Ne,
+        Lt,
+        Le,
+        Gt,
+        Ge,
+    };
+
+    /// Instruction of the postfix program
+    struct Instruction
+    {
+        Opcode opcode; ///< kind of instruction
+        Field field;   ///< attribute, for Test
+        Compare cmp;   ///< comparison, for Test
+        int64_t value; ///< value to compare with, for Test
+    };
+
+    /// Maximum depth of the evaluation stack (bits of a uint64_t)
+    static constexpr size_t maxDepth = 64;
+
+    class Parser;
+
+    EntryFilter() : m_program{}, m_needsStat{false} {}
+
+    std::vector<Instruction> m_program; ///< postfix program
+    bool m_needsStat;                   ///< whether a comparison uses the stat of the file
+};
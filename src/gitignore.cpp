@@ -0,0 +1,310 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Ignore rules read from .gitignore and .diffignore files found in the trees.
+ */
+
+#include <algorithm>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <iostream>
+#include <string_view>
+#include <sys/stat.h>
+
+#include "gitignore.h"
+
+/// Names of the ignore files, by increasing precedence
+static constexpr const char *ignore_filenames[2] = {".gitignore", ".diffignore"};
+
+/** Match a glob on a path, with the gitignore syntax.
+ * *, ? and [...] do not match /, ** matches any number of directories.
+ */
+static bool wildmatch(std::string_view pattern, std::string_view text)
+{
+    size_t p = 0;
+    size_t t = 0;
+    while (p < pattern.size())
+    {
+        const char c = pattern[p];
+        if (c == '*')
+        {
+            const bool segmentStart = p == 0 or pattern[p - 1] == '/';
+            if (segmentStart and p + 1 < pattern.size() and pattern[p + 1] == '*')
+            {
+                if (p + 2 == pattern.size())
+                    return true; // trailing **: everything inside
+                if (pattern[p + 2] == '/')
+                {
+                    // **/: zero or more directories
+                    const std::string_view rest = pattern.substr(p + 3);
+                    for (size_t pos = t;; pos++)
+                    {
+                        if (wildmatch(rest, text.substr(pos)))
+                            return true;
+                        pos = text.find('/', pos);
+                        if (pos == std::string_view::npos)
+                            return false;
+                    }
+                }
+            }
+            // any number of characters, except /
+            while (p < pattern.size() and pattern[p] == '*')
+                p++;
+            const std::string_view rest = pattern.substr(p);
+            for (size_t pos = t;; pos++)
+            {
+                if (wildmatch(rest, text.substr(pos)))
+                    return true;
+                if (pos >= text.size() or text[pos] == '/')
+                    return false;
+            }
+        }
+
+        if (t >= text.size())
+            return false;
+        if (c == '?')
+        {
+            if (text[t] == '/')
+                return false;
+        }
+        else if (c == '[')
+        {
+            // bracket expression: delegate to fnmatch on the single character
+            size_t end = p + 1;
+            if (end < pattern.size() and (pattern[end] == '!' or pattern[end] == '^'))
+                end++;
+            if (end < pattern.size() and pattern[end] == ']')
+                end++;
+            end = pattern.find(']', end);
+            if (end == std::string_view::npos)
+            {
+                if (text[t] != c)
+                    return false; // no closing bracket: literal [
+            }
+            else
+            {
+                const std::string bracket{pattern.substr(p, end + 1 - p)};
+                const char ch[2] = {text[t], '\0'};
+                if (::fnmatch(bracket.c_str(), ch, FNM_PATHNAME) != 0)
+                    return false;
+                p = end;
+            }
+        }
+        else if (c == '\\' and p + 1 < pattern.size())
+        {
+            p++;
+            if (pattern[p] != text[t])
+                return false;
+        }
+        else if (c != text[t])
+        {
+            return false;
+        }
+        p++;
+        t++;
+    }
+    return t == text.size();
+}
+
+GitIgnoreRules::GitIgnoreRules(const std::string &content)
+    : m_rules{}
+{
+    size_t pos = 0;
+    while (pos < content.size())
+    {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos)
+            end = content.size();
+        std::string line = content.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (not line.empty() and line.back() == '\r')
+            line.pop_back();
+        if (line.empty() or line[0] == '#')
+            continue;
+
+        Rule rule{{}, false, false, false};
+        if (line[0] == '!')
+        {
+            rule.negated = true;
+            line.erase(0, 1);
+        }
+        else if (line.starts_with("\\!") or line.starts_with("\\#"))
+        {
+            line.erase(0, 1);
+        }
+
+        // trailing spaces are ignored, unless escaped
+        while (not line.empty() and line.back() == ' ' and not(line.size() >= 2 and line[line.size() - 2] == '\\'))
+            line.pop_back();
+
+        if (not line.empty() and line.back() == '/')
+        {
+            rule.directoryOnly = true;
+            line.pop_back();
+        }
+        // a / at the beginning or in the middle anchors the pattern to the directory of the file
+        rule.anchored = line.find('/') != std::string::npos;
+        if (not line.empty() and line[0] == '/')
+            line.erase(0, 1);
+        if (line.empty())
+            continue;
+
+        rule.pattern = std::move(line);
+        m_rules.push_back(std::move(rule));
+    }
+}
+
+std::optional<bool> GitIgnoreRules::match(const std::string &relPath, bool isDirectory) const
+{
+    const size_t sep = relPath.rfind('/');
+    const std::string_view filename = sep == std::string::npos ? std::string_view{relPath}
+                                                               : std::string_view{relPath}.substr(sep + 1);
+    for (auto it = m_rules.rbegin(); it != m_rules.rend(); it++)
+    {
+        if (it->directoryOnly and not isDirectory)
+            continue;
+        if (wildmatch(it->pattern, it->anchored ? std::string_view{relPath} : filename))
+            return not it->negated;
+    }
+    return {};
+}
+
+std::shared_ptr<const GitIgnoreRules> GitIgnore::load(Side side, const std::string &relPath)
+{
+    const RootPath &root = ctx.root[int(side)];
+    struct stat statbuf;
+    if (::fstatat(root.fd, relPath.c_str(), &statbuf, AT_NO_AUTOMOUNT) < 0 or not S_ISREG(statbuf.st_mode))
+        return nullptr;
+
+    // same file already compiled
+    const file_id_type fileId{statbuf.st_dev, statbuf.st_ino, statbuf.st_size,
+                              statbuf.st_mtim.tv_sec, statbuf.st_mtim.tv_nsec};
+    auto itId = m_byIdentity.find(fileId);
+    if (itId == m_byIdentity.end())
+    {
+        ScopedFd fd = ScopedFd::openat(root.fd, relPath, O_RDONLY);
+        if (not fd.isValid())
+            return nullptr;
+        std::string content = fd.getContent();
+
+        // same content already compiled, typically the same file on the other side
+        auto itContent = m_byContent.find(content);
+        if (itContent == m_byContent.end())
+        {
+            auto rules = std::make_shared<const GitIgnoreRules>(content);
+            itContent = m_byContent.emplace(std::move(content), std::move(rules)).first;
+            if (ctx.settings.debug)
+            {
+                std::cerr << "Loaded ignore file: " << relPath << std::endl;
+            }
+        }
+        itId = m_byIdentity.emplace(fileId, itContent->second).first;
+    }
+    return itId->second->empty() ? nullptr : itId->second;
+}
+
+std::shared_ptr<const GitIgnoreLevel> GitIgnore::push(const std::shared_ptr<const GitIgnoreLevel> &parent,
+                                                      const std::string &dirPath, const bool hasFile[2][2])
+{
+    std::vector<std::shared_ptr<const GitIgnoreRules>> rules[2];
+    for (int side = 0; side < 2; side++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            if (not hasFile[side][i])
+                continue;
+            const std::string relPath = dirPath == "." ? ignore_filenames[i] : dirPath + "/" + ignore_filenames[i];
+            auto fileRules = load(Side(side), relPath);
+            if (fileRules)
+                rules[side].push_back(std::move(fileRules));
+        }
+    }
+    if (rules[0].empty() and rules[1].empty())
+        return parent; // no ignore file in this directory
+
+    const bool symmetric = (not parent or parent->symmetric) and rules[0] == rules[1];
+    return std::make_shared<const GitIgnoreLevel>(
+        GitIgnoreLevel{parent, dirPath, {std::move(rules[0]), std::move(rules[1])}, symmetric});
+}
+
+std::shared_ptr<const GitIgnoreLevel> GitIgnore::enter(const std::shared_ptr<const GitIgnoreLevel> &parent,
+                                                       const std::string &dirPath, const dir_content_type dirContent[2])
+{
+    bool hasFile[2][2];
+    for (int side = 0; side < 2; side++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            // directory content is sorted by filename
+            const auto it = std::lower_bound(dirContent[side].cbegin(), dirContent[side].cend(), ignore_filenames[i],
+                                             [](const DirEntry &entry, const char *filename)
+                                             { return entry.filename < filename; });
+            hasFile[side][i] = it != dirContent[side].cend() and it->filename == ignore_filenames[i];
+        }
+    }
+    return push(parent, dirPath, hasFile);
+}
+
+std::shared_ptr<const GitIgnoreLevel> GitIgnore::stackOf(const std::string &dirPath)
+{
+    const auto it = m_stackOf.find(dirPath);
+    if (it != m_stackOf.end())
+        return it->second;
+
+    std::shared_ptr<const GitIgnoreLevel> parent{};
+    if (dirPath != ".")
+    {
+        const size_t sep = dirPath.rfind('/');
+        parent = stackOf(sep == std::string::npos ? "." : dirPath.substr(0, sep));
+    }
+    // directory content is not known: look for all the ignore files
+    static constexpr bool allFiles[2][2] = {{true, true}, {true, true}};
+    auto level = push(parent, dirPath, allFiles);
+    m_stackOf.emplace(dirPath, level);
+    return level;
+}
+
+bool GitIgnore::isIgnored(const GitIgnoreLevel *level, const std::string &relPath, bool isDirectory)
+{
+    if (level == nullptr)
+        return false;
+
+    for (int side = 0; side < 2; side++)
+    {
+        if (side == 1 and level->symmetric)
+            break; // same result as left side
+
+        // deepest ignore files first, the first matching rule wins
+        std::optional<bool> ignored{};
+        for (const GitIgnoreLevel *current = level; current != nullptr and not ignored.has_value();
+             current = current->parent.get())
+        {
+            const std::string pathInDir = current->dirPath == "." ? relPath : relPath.substr(current->dirPath.size() + 1);
+            const auto &rules = current->rules[side];
+            for (auto it = rules.rbegin(); it != rules.rend() and not ignored.has_value(); it++)
+                ignored = (*it)->match(pathInDir, isDirectory);
+        }
+        if (ignored.value_or(false))
+            return true;
+    }
+    return false;
+}
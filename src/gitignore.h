@@ -0,0 +1,129 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Ignore rules read from .gitignore and .diffignore files found in the trees.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "context.h"
+
+/// Rules of one ignore file, with the gitignore syntax
+class GitIgnoreRules
+{
+public:
+    /// Parse the content of an ignore file
+    explicit GitIgnoreRules(const std::string &content);
+
+    /** Match a path with the rules, the last matching rule wins.
+     *
+     * @param[in] relPath      path relative to the directory of the ignore file
+     * @param[in] isDirectory  whether the path is a directory
+     * @return whether the path is ignored (false if re-included by a negated rule), nullopt if no rule matches
+     */
+    std::optional<bool> match(const std::string &relPath, bool isDirectory) const;
+
+    /// Get whether there is no rule
+    bool empty() const
+    {
+        return m_rules.empty();
+    }
+
+private:
+    /// One line of the ignore file
+    struct Rule
+    {
+        std::string pattern; ///< glob, without the leading ! and / and the trailing /
+        bool negated;        ///< !pattern: re-include the matching paths
+        bool directoryOnly;  ///< pattern/: match only directories
+        bool anchored;       ///< pattern with a /: match from the directory of the file, otherwise match the filename
+    };
+
+    std::vector<Rule> m_rules; ///< rules in the order of the file
+};
+
+/** Ignore files applying to the entries of a directory.
+ *
+ * Each level holds the ignore files of one directory and points to the level of
+ * the closest ancestor with ignore files: the levels are shared by all the
+ * directories below.
+ */
+struct GitIgnoreLevel
+{
+    std::shared_ptr<const GitIgnoreLevel> parent;                ///< level of the ancestors, nullptr at the top
+    std::string dirPath;                                         ///< directory of the ignore files, relative to roots
+    std::vector<std::shared_ptr<const GitIgnoreRules>> rules[2]; ///< ignore files on both sides, by increasing precedence
+    bool symmetric;                                              ///< whether both sides have the same rules, on all the levels
+};
+
+/// Read and cache the ignore files of both sides
+class GitIgnore
+{
+public:
+    GitIgnore(const Context &context) : ctx{context}, m_byIdentity{}, m_byContent{}, m_stackOf{} {}
+
+    /** Get the ignore files applying to the entries of a directory.
+     *
+     * @param[in] parent      ignore files applying to the directory itself
+     * @param[in] dirPath     relative path of the directory
+     * @param[in] dirContent  content of the directory on both sides, to avoid looking for missing ignore files
+     */
+    std::shared_ptr<const GitIgnoreLevel> enter(const std::shared_ptr<const GitIgnoreLevel> &parent,
+                                                const std::string &dirPath, const dir_content_type dirContent[2]);
+
+    /** Get the ignore files applying to the entries of a directory, reading the ignore files of all its ancestors.
+     *
+     * @param[in] dirPath  relative path of the directory, "." for the roots
+     */
+    std::shared_ptr<const GitIgnoreLevel> stackOf(const std::string &dirPath);
+
+    /** Get whether a path is ignored by the ignore files on one side or the other.
+     *
+     * @param[in] level        ignore files applying to the parent directory of the path
+     * @param[in] relPath      path relative to roots
+     * @param[in] isDirectory  whether the path is a directory
+     */
+    static bool isIgnored(const GitIgnoreLevel *level, const std::string &relPath, bool isDirectory);
+
+private:
+    /// Identity of an ignore file: device, inode, size, mtime
+    typedef std::tuple<dev_t, ino_t, off_t, time_t, long> file_id_type;
+
+    /// Add the ignore files of a directory on top of parent, if there are any
+    std::shared_ptr<const GitIgnoreLevel> push(const std::shared_ptr<const GitIgnoreLevel> &parent,
+                                               const std::string &dirPath, const bool hasFile[2][2]);
+
+    /// Load an ignore file, nullptr if it does not exist or has no rule
+    std::shared_ptr<const GitIgnoreRules> load(Side side, const std::string &relPath);
+
+    const Context &ctx;
+    std::map<file_id_type, std::shared_ptr<const GitIgnoreRules>> m_byIdentity;         ///< rules by file identity
+    std::unordered_map<std::string, std::shared_ptr<const GitIgnoreRules>> m_byContent; ///< rules by file content
+    std::unordered_map<std::string, std::shared_ptr<const GitIgnoreLevel>> m_stackOf;   ///< levels computed by stackOf
+};
@@ -22,71 +22,197 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  * Filter capability to ignore some paths.
  */
 
+#include <algorithm>
+#include <fnmatch.h>
+#include <fstream>
+#include <string_view>
+
 #include "ignore.h"
 
-/** Replace occurrences in a string
- * https://stackoverflow.com/a/29752943
- */
-static void replaceAll(std::string &source, const std::string &from, const std::string &to)
+bool IgnoreFilter::Component::matches(const std::string &filename) const
 {
-    std::string newString{};
-    newString.reserve(source.length()); // avoids a few memory allocations
-
-    std::string::size_type lastPos = 0;
-    std::string::size_type findPos;
-
-    while (std::string::npos != (findPos = source.find(from, lastPos)))
-    {
-        newString.append(source, lastPos, findPos - lastPos);
-        newString += to;
-        lastPos = findPos + from.length();
-    }
-
-    // care for the rest after last occurrence
-    newString += source.substr(lastPos);
-
-    source.swap(newString);
+    if (isGlob)
+        return ::fnmatch(pattern.c_str(), filename.c_str(), 0) == 0;
+    return pattern == filename;
 }
 
 IgnoreFilter::IgnoreFilter(const std::vector<std::string> &ignoreRules)
+    : m_rules{}, m_relativeStarts{}, m_absoluteStarts{}
 {
-    // build a single regex matching all the ignore rules
-    std::string unifiedRegex{};
-
     for (const auto &rule : ignoreRules)
     {
-        // transform the rule to a regex
-        std::string ruleRegex = rule;
-        // . -> \\. (matches a real dot)
-        replaceAll(ruleRegex, ".", "\\.");
-        // ? -> [^/] (matches any single character, except /)
-        // TODO: do not replace escaped-? (\\?)
-        replaceAll(ruleRegex, "?", "[^/]");
-        // * -> [^/]* (matches any number of any characters, except /)
-        // TODO: do not replace escaped-* (\\*)
-        replaceAll(ruleRegex, "*", "[^/]*");
-        // all other regex elements are kept as is. User shall escape them if needed.
-
         /* handle absolute / relative rules
          * if a rule starts with a /, the rule is absolute and shall match from the beginning
          * otherwise, the rule is relative and shall match between /
          */
-        if (ruleRegex.size() > 0 and ruleRegex[0] == '/')
+        const bool absolute = rule.size() > 0 and rule[0] == '/';
+
+        // split the rule in components
+        std::vector<Component> components{};
+        size_t pos = 0;
+        while (pos < rule.size())
         {
-            // absolute rule: remove the leading slash
-            ruleRegex = ruleRegex.substr(1);
+            size_t end = rule.find('/', pos);
+            if (end == std::string::npos)
+                end = rule.size();
+            if (end > pos)
+            {
+                std::string pattern = rule.substr(pos, end - pos);
+                // ? matches any single character, * any number of characters, except /
+                const bool isGlob = pattern.find_first_of("*?[\\") != std::string::npos;
+                components.emplace_back(std::move(pattern), isGlob);
+            }
+            pos = end + 1;
         }
-        else
+        if (components.empty())
+            continue;
+
+        m_rules.push_back(std::move(components));
+        indexRule(absolute ? m_absoluteStarts : m_relativeStarts, m_rules.size() - 1);
+    }
+
+    m_relativeStarts.substring.build();
+    m_absoluteStarts.substring.build();
+}
+
+std::string IgnoreFilter::checkRule(const std::string &rule)
+{
+    for (size_t pos = 0; pos < rule.size(); pos++)
+    {
+        if (rule[pos] == '\\')
+        {
+            pos++; // escaped character, matched literally
+        }
+        else if (rule[pos] == '[')
+        {
+            // bracket expression, its characters are a set: skip to its end, a first ] is part of the set
+            const size_t end = rule.find(']', pos + (rule[pos + 1] == '!' or rule[pos + 1] == '^' ? 3 : 2));
+            if (end != std::string::npos)
+                pos = end;
+        }
+        else if (std::string_view{"+|(){}^$"}.find(rule[pos]) != std::string_view::npos)
+            return "invalid ignore rule '" + rule + "': regular expressions are not supported, escape '" + rule[pos] +
+                   "' with \\ to match it literally";
+    }
+    return {};
+}
+
+void IgnoreFilter::indexRule(StartIndex &index, uint32_t rule)
+{
+    const std::string &pattern = m_rules[rule][0].pattern;
+    if (not m_rules[rule][0].isGlob)
+    {
+        index.literal[pattern].push_back(rule);
+        return;
+    }
+
+    // *<literal> and *<literal>* are matched on the literal part
+    const size_t nbStars = std::count(pattern.begin(), pattern.end(), '*');
+    const bool simpleGlob = pattern.find_first_of("?[\\") == std::string::npos;
+    if (simpleGlob and pattern.size() > 1 and pattern.front() == '*' and nbStars == 1)
+        index.suffix.add(std::string_view{pattern}.substr(1), rule);
+    else if (simpleGlob and pattern.size() > 2 and pattern.front() == '*' and pattern.back() == '*' and nbStars == 2)
+        index.substring.add(std::string_view{pattern}.substr(1, pattern.size() - 2), rule);
+    else
+        index.glob.push_back(rule);
+}
+
+bool IgnoreFilter::advance(uint32_t rule, uint32_t component, State *entryState) const
+{
+    if (component + 1 == m_rules[rule].size())
+        return true;
+    if (entryState != nullptr)
+        entryState->partial.emplace_back(rule, component + 1);
+    return false;
+}
+
+bool IgnoreFilter::start(const StartIndex &index, const std::string &filename, State *entryState) const
+{
+    const auto advanceRule = [this, entryState](uint32_t rule)
+    { return advance(rule, 0, entryState); };
+
+    const auto it = index.literal.find(filename);
+    if (it != index.literal.end())
+    {
+        for (uint32_t rule : it->second)
         {
-            // relative rule: allow any path before the rule
-            ruleRegex = "(.*/)?" + ruleRegex;
+            if (advanceRule(rule))
+                return true;
         }
+    }
+    if (index.suffix.find(filename, advanceRule) or index.substring.find(filename, advanceRule))
+        return true;
+    for (uint32_t rule : index.glob)
+    {
+        if (m_rules[rule][0].matches(filename) and advance(rule, 0, entryState))
+            return true;
+    }
+    return false;
+}
+
+bool IgnoreFilter::match(const State &dirState, const std::string &filename, State *entryState) const
+{
+    if (entryState != nullptr)
+    {
+        entryState->isRoot = false;
+        entryState->partial.clear();
+    }
 
-        // add it to the unified regex
-        if (unifiedRegex.size() > 0)
-            unifiedRegex += "|";
-        unifiedRegex += "(" + ruleRegex + ")";
+    // continue the rules partially matched by the directory
+    for (const auto &[rule, component] : dirState.partial)
+    {
+        if (m_rules[rule][component].matches(filename) and advance(rule, component, entryState))
+            return true;
     }
 
-    m_regex = std::regex(unifiedRegex, std::regex::nosubs | std::regex::optimize);
-}
\ No newline at end of file
+    // start new rules
+    if (dirState.isRoot and start(m_absoluteStarts, filename, entryState))
+        return true;
+    return start(m_relativeStarts, filename, entryState);
+}
+
+IgnoreFilter::State IgnoreFilter::getState(const std::string &dirPath) const
+{
+    State state{};
+    if (dirPath == ".")
+        return state;
+
+    size_t pos = 0;
+    while (pos <= dirPath.size())
+    {
+        size_t end = dirPath.find('/', pos);
+        if (end == std::string::npos)
+            end = dirPath.size();
+        State next{};
+        match(state, dirPath.substr(pos, end - pos), &next);
+        state = std::move(next);
+        pos = end + 1;
+    }
+    return state;
+}
+
+bool IgnoreFilter::isIgnored(const std::string &path) const
+{
+    const size_t sep = path.rfind('/');
+    if (sep == std::string::npos)
+        return match(State{}, path, nullptr);
+    return match(getState(path.substr(0, sep)), path.substr(sep + 1), nullptr);
+}
+
+bool IgnoreFilter::readRules(const std::string &filename, std::vector<std::string> &rules)
+{
+    std::ifstream file{filename};
+    if (not file)
+        return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (not line.empty() and line.back() == '\r')
+            line.pop_back(); // file with DOS line endings
+        if (line.empty() or line[0] == '#')
+            continue;
+        rules.push_back(std::move(line));
+    }
+    return true;
+}
@@ -24,20 +24,104 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
-#include <regex>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-/// ignore filter object
+#include "literal_index.h"
+
+/** Ignore filter object.
+ *
+ * Rules are globs (*, ?, [...]) matched component by component:
+ * - an absolute rule (starting with /) matches from the root
+ * - a relative rule matches at any depth
+ *
+ * The rules partially matched by the path of a directory are kept in a State,
+ * so that matching an entry of the directory only needs its filename.
+ *
+ * Rules are indexed by their first component, so that the cost of a match does
+ * not depend on the number of rules for the most common forms: exact names,
+ * suffixes (*.ext) and substrings (*text*). Other globs are tested one by one.
+ */
 class IgnoreFilter
 {
 public:
+    /// Matching state of a directory
+    struct State
+    {
+        bool isRoot{true};                                    ///< whether the directory is the root
+        std::vector<std::pair<uint32_t, uint32_t>> partial{}; ///< rules partially matched: (rule, index of the next component)
+    };
+
     IgnoreFilter(const std::vector<std::string> &ignoreRules);
 
+    /** Match an entry of a directory.
+     *
+     * @param[in]  dirState    state of the directory
+     * @param[in]  filename    name of the entry
+     * @param[out] entryState  state of the entry, to match its own entries; nullptr if not a directory
+     * @return whether the entry shall be ignored
+     */
+    bool match(const State &dirState, const std::string &filename, State *entryState) const;
+
     /// Indicate if the provided path shall be ignored
-    bool isIgnored(const std::string &path) const
-    {
-        return std::regex_match(path, m_regex);
-    }
+    bool isIgnored(const std::string &path) const;
+
+    /** Check the syntax of a rule: the characters used by regular expressions but not by
+     * globs (+ | ( ) { } ^ $) shall be escaped with \, as rules were regular expressions before.
+     *
+     * @param[in] rule  rule to check
+     * @return error message, empty if the rule is valid
+     */
+    static std::string checkRule(const std::string &rule);
+
+    /** Read rules from a file, one per line; empty lines and lines starting with # are skipped.
+     *
+     * @param[in]     filename  file to read
+     * @param[in,out] rules     rules to complete
+     * @return false if the file cannot be read
+     */
+    static bool readRules(const std::string &filename, std::vector<std::string> &rules);
+
+    /** Get the matching state of a directory.
+     *
+     * @param[in] dirPath  relative path of the directory, "." for the root
+     */
+    State getState(const std::string &dirPath) const;
 
 private:
-    std::regex m_regex; ///< regex built from the rules
-};
\ No newline at end of file
+    /// One component of a rule
+    struct Component
+    {
+        std::string pattern; ///< literal name or glob
+        bool isGlob;         ///< whether the pattern has wildcards
+
+        bool matches(const std::string &filename) const;
+    };
+
+    /// Rules by their first component
+    struct StartIndex
+    {
+        std::unordered_map<std::string, std::vector<uint32_t>> literal; ///< rules starting with a literal name
+        SuffixIndex suffix;                                             ///< rules starting with *<literal>
+        SubstringIndex substring;                                       ///< rules starting with *<literal>*
+        std::vector<uint32_t> glob;                                     ///< rules starting with another glob
+    };
+
+    /// Add a rule to an index, by its first component
+    void indexRule(StartIndex &index, uint32_t rule);
+
+    /** Advance a rule on a matching component.
+     * @return whether the rule is completely matched
+     */
+    bool advance(uint32_t rule, uint32_t component, State *entryState) const;
+
+    /// Start the rules of an index on an entry
+    bool start(const StartIndex &index, const std::string &filename, State *entryState) const;
+
+    std::vector<std::vector<Component>> m_rules; ///< components of each rule
+    StartIndex m_relativeStarts;                 ///< relative rules, starting at any depth
+    StartIndex m_absoluteStarts;                 ///< absolute rules, starting at the root
+};
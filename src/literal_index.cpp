@@ -0,0 +1,89 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Indexes of literal strings, to find all the keys matching a string in a single pass.
+ */
+
+#include <queue>
+
+#include "literal_index.h"
+
+void SuffixIndex::add(std::string_view key, uint32_t value)
+{
+    uint32_t node = 0;
+    for (auto it = key.rbegin(); it != key.rend(); it++)
+    {
+        uint32_t next = m_edges.get(node, *it);
+        if (next == TrieEdges::none)
+        {
+            next = m_values.size();
+            m_values.emplace_back();
+            m_edges.set(node, *it, next);
+        }
+        node = next;
+    }
+    m_values[node].push_back(value);
+}
+
+void SubstringIndex::add(std::string_view key, uint32_t value)
+{
+    uint32_t node = 0;
+    for (char c : key)
+    {
+        uint32_t next = m_edges.get(node, c);
+        if (next == TrieEdges::none)
+        {
+            next = m_nodes.size();
+            m_nodes.emplace_back();
+            m_nodes[node].children.emplace_back(c, next);
+            m_edges.set(node, c, next);
+        }
+        node = next;
+    }
+    m_nodes[node].values.push_back(value);
+}
+
+void SubstringIndex::build()
+{
+    // breadth first: the failure link of a node is computed from the shallower nodes
+    std::queue<uint32_t> queue{};
+    for (const auto &[c, child] : m_nodes[0].children)
+    {
+        m_nodes[child].fail = 0;
+        m_nodes[child].output = 0;
+        queue.push(child);
+    }
+    while (not queue.empty())
+    {
+        const uint32_t node = queue.front();
+        queue.pop();
+        for (const auto &[c, child] : m_nodes[node].children)
+        {
+            uint32_t fail = m_nodes[node].fail;
+            uint32_t next;
+            while ((next = m_edges.get(fail, c)) == TrieEdges::none and fail != 0)
+                fail = m_nodes[fail].fail;
+            m_nodes[child].fail = next;
+            m_nodes[child].output = m_nodes[next].values.empty() ? m_nodes[next].output : next;
+            queue.push(child);
+        }
+    }
+}
@@ -0,0 +1,150 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Indexes of literal strings, to find all the keys matching a string in a single pass.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// Transitions of a trie: (node, character) -> node
+class TrieEdges
+{
+public:
+    static constexpr uint32_t none = 0; ///< no transition (the root is never a target)
+
+    /// Get the node reached from node with c, none if there is no such transition
+    uint32_t get(uint32_t node, char c) const
+    {
+        const auto it = m_edges.find(key(node, c));
+        return it == m_edges.end() ? none : it->second;
+    }
+
+    /// Set a transition
+    void set(uint32_t node, char c, uint32_t target)
+    {
+        m_edges[key(node, c)] = target;
+    }
+
+private:
+    static uint64_t key(uint32_t node, char c)
+    {
+        return (uint64_t(node) << 8) | uint8_t(c);
+    }
+
+    std::unordered_map<uint64_t, uint32_t> m_edges; ///< transitions
+};
+
+/// Find the values whose key is a suffix of a string, with a trie of the reversed keys
+class SuffixIndex
+{
+public:
+    SuffixIndex() : m_values(1), m_edges{} {}
+
+    /// Add a value for a non-empty key
+    void add(std::string_view key, uint32_t value);
+
+    /** Call fct(value) for each key which is a suffix of str, shortest key first.
+     * @return true as soon as fct returns true
+     */
+    template <typename Fct>
+    bool find(std::string_view str, Fct &&fct) const
+    {
+        uint32_t node = 0;
+        for (auto it = str.rbegin(); it != str.rend(); it++)
+        {
+            node = m_edges.get(node, *it);
+            if (node == TrieEdges::none)
+                return false;
+            for (uint32_t value : m_values[node])
+            {
+                if (fct(value))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::vector<uint32_t>> m_values; ///< values of each node
+    TrieEdges m_edges;                           ///< transitions between nodes
+};
+
+/// Find the values whose key is a substring of a string, with an Aho-Corasick automaton
+class SubstringIndex
+{
+public:
+    SubstringIndex() : m_nodes(1), m_edges{} {}
+
+    /// Add a value for a non-empty key
+    void add(std::string_view key, uint32_t value);
+
+    /// Compute the failure links, after the last key has been added
+    void build();
+
+    /** Call fct(value) for each key which is a substring of str.
+     * @return true as soon as fct returns true
+     */
+    template <typename Fct>
+    bool find(std::string_view str, Fct &&fct) const
+    {
+        if (m_nodes.size() == 1)
+            return false; // no key
+        uint32_t node = 0;
+        for (char c : str)
+        {
+            // follow the failure links until a transition exists
+            uint32_t next;
+            while ((next = m_edges.get(node, c)) == TrieEdges::none and node != 0)
+                node = m_nodes[node].fail;
+            node = next;
+
+            // keys ending here: the node and its failure chain
+            for (uint32_t output = m_nodes[node].values.empty() ? m_nodes[node].output : node;
+                 output != 0; output = m_nodes[output].output)
+            {
+                for (uint32_t value : m_nodes[output].values)
+                {
+                    if (fct(value))
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    /// Node of the automaton
+    struct Node
+    {
+        std::vector<uint32_t> values{};                    ///< values of the keys ending at the node
+        std::vector<std::pair<char, uint32_t>> children{}; ///< transitions of the trie
+        uint32_t fail{0};                                  ///< longest proper suffix which is a prefix of a key
+        uint32_t output{0};                                ///< next node with values in the failure chain, 0 if none
+    };
+
+    std::vector<Node> m_nodes; ///< nodes, root first
+    TrieEdges m_edges;         ///< transitions of the trie
+};
@@ -0,0 +1,144 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Cache of the last used values, within a memory budget.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+/** Cache of the last used values, within a memory budget.
+ *
+ * The memory used by a value is given by its memorySize() method, and is taken into
+ * account when the value is updated: the least recently used values are then evicted
+ * until the budget is met. The most recently used value is never evicted.
+ */
+template <typename Key, typename Value>
+class LruCache
+{
+public:
+    explicit LruCache(size_t budget) : m_budget{budget}, m_bytes{0}, m_hits{0}, m_misses{0}, m_order{}, m_index{} {}
+
+    // not copyable (the index references the list)
+    LruCache(const LruCache &) = delete;
+    LruCache &operator=(const LruCache &) = delete;
+
+    /// Get a value and mark it as the most recently used, nullptr if it is not cached
+    Value *get(const Key &key)
+    {
+        const auto it = m_index.find(key);
+        if (it == m_index.end())
+        {
+            m_misses++;
+            return nullptr;
+        }
+        m_hits++;
+        m_order.splice(m_order.begin(), m_order, it->second);
+        return &it->second->value;
+    }
+
+    /// Get a value without changing the order nor the statistics, nullptr if it is not cached
+    Value *peek(const Key &key)
+    {
+        const auto it = m_index.find(key);
+        return it == m_index.end() ? nullptr : &it->second->value;
+    }
+
+    /** Insert a default value, replacing the cached one.
+     * @param[in] key         key of the value
+     * @param[in] mostRecent  whether the value is the most recently used, otherwise the least recently used
+     */
+    Value &insert(const Key &key, bool mostRecent = true)
+    {
+        erase(key);
+        const auto it = m_order.insert(mostRecent ? m_order.begin() : m_order.end(), Node{key, Value{}, 0});
+        m_index.emplace(key, it);
+        return it->value;
+    }
+
+    /// Take into account the memory used by a value, and evict the least recently used values above the budget
+    void update(const Key &key)
+    {
+        const auto it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            const size_t bytes = it->second->value.memorySize();
+            m_bytes = m_bytes - it->second->bytes + bytes;
+            it->second->bytes = bytes;
+        }
+        while (m_bytes > m_budget and m_order.size() > 1)
+            erase(m_order.back().key);
+    }
+
+    /// Remove a value
+    void erase(const Key &key)
+    {
+        const auto it = m_index.find(key);
+        if (it == m_index.end())
+            return;
+        m_bytes -= it->second->bytes;
+        m_order.erase(it->second);
+        m_index.erase(it);
+    }
+
+    /// Get the number of cached values
+    size_t size() const
+    {
+        return m_order.size();
+    }
+
+    /// Get the memory used by the cached values
+    size_t bytes() const
+    {
+        return m_bytes;
+    }
+
+    /// Get the number of values found by get()
+    size_t hits() const
+    {
+        return m_hits;
+    }
+
+    /// Get the number of values not found by get()
+    size_t misses() const
+    {
+        return m_misses;
+    }
+
+private:
+    /// Cached value
+    struct Node
+    {
+        Key key;      ///< key of the value
+        Value value;  ///< cached value
+        size_t bytes; ///< memory used by the value, when last updated
+    };
+
+    const size_t m_budget;                                                ///< memory for all the values
+    size_t m_bytes;                                                       ///< memory used by all the values
+    size_t m_hits;                                                        ///< number of values found
+    size_t m_misses;                                                      ///< number of values not found
+    std::list<Node> m_order;                                              ///< values, most recently used first
+    std::unordered_map<Key, typename std::list<Node>::iterator> m_index; ///< values by key
+};
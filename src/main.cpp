@@ -22,6 +22,7 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  * main() function and argument parsing.
  */
 
+#include <fstream>
 #include <iostream>
 
 #include "cxxopts.hpp"
@@ -49,7 +50,7 @@ enum class OutputMode
 };
 
 /** Parse arguments and catch exception nicely.
- * 
+ *
  * Workaround to https://github.com/jarro2783/cxxopts/issues/146 :
  * use a dedicated function to catch an exception.
  */
@@ -77,9 +78,28 @@ int main(int argc, char *argv[])
         ("c,compact", "compact output, a single line giving the differences for one path", cxxopts::value<bool>())                //
         ("s,status", "give no output, return 1 on first identified difference, 0 if no difference found", cxxopts::value<bool>()) //
         ("i,ignore", "ignore paths matching the given pattern(s)", cxxopts::value<std::vector<std::string>>(), "path_pattern")    //
+        ("ignore-from", "ignore paths matching the patterns read from the file(s), one per line",                                 //
+         cxxopts::value<std::vector<std::string>>(), "file")                                                                      //
+        ("gitignore", "apply the .gitignore and .diffignore files found in the trees", cxxopts::value<bool>())                    //
+        ("filter", "ignore files matching the expression on size, mtime, age or type, e.g. 'size>1G or type==socket'",            //
+         cxxopts::value<std::string>(), "expression")                                                                             //
         ("m,metadata", "check and report metadata differences (ownership, permissions)", cxxopts::value<bool>())                  //
+        ("structure", "compare only names and file types, without reading metadata", cxxopts::value<bool>())                      //
         ("t,thread", "use multiple threads to speed-up the comparison", cxxopts::value<bool>())                                   //
         ("B,buffer", "size of the buffers used for content comparison", cxxopts::value<size_t>()->default_value("65536"), "size") //
+        ("T,trust", "content policy: mtime-trust, ctime-trust, size-only, always-verify, skip, hash-only",                        //
+         cxxopts::value<std::string>()->default_value("mtime-trust"), "policy")                                                   //
+        ("mtime-tolerance", "maximum difference between timestamps considered equal (ns, us, ms, s)",                             //
+         cxxopts::value<std::string>()->default_value("0"), "duration")                                                           //
+        ("mtime-precision", "truncate timestamps to this precision before comparison (ns, us, ms, s)",                            //
+         cxxopts::value<std::string>()->default_value("0"), "duration")                                                           //
+        ("checksums", "use digests stored in xattr or SHA256SUMS files instead of the content", cxxopts::value<bool>())           //
+        ("checksum-xattr", "name of the xattr storing the digest of a file",                                                      //
+         cxxopts::value<std::string>()->default_value("user.checksum"), "name")                                                   //
+        ("change-source", "how to find the paths to compare: walk (whole trees), btrfs (snapshots of the same subvolume)",        //
+         cxxopts::value<std::string>()->default_value("walk"), "source")                                                          //
+        ("files-from", "compare only the paths listed in the file (- for stdin), separated by newlines or NUL",                   //
+         cxxopts::value<std::string>(), "file")                                                                                   //
         ("d,debug", "print debug information during the diff", cxxopts::value<bool>())                                            //
         ("dirL", "left directory", cxxopts::value<std::string>())                                                                 //
         ("dirR", "right directory", cxxopts::value<std::string>())                                                                //
@@ -124,6 +144,94 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    const auto contentPolicy = contentPolicyFromString(result["trust"].as<std::string>());
+    if (not contentPolicy.has_value())
+    {
+        std::cerr << error_prefix << "invalid trust policy" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const auto mtimeToleranceNs = parseDurationNs(result["mtime-tolerance"].as<std::string>());
+    const auto mtimePrecisionNs = parseDurationNs(result["mtime-precision"].as<std::string>());
+    if (not mtimeToleranceNs.has_value() or not mtimePrecisionNs.has_value())
+    {
+        std::cerr << error_prefix << "invalid duration for mtime tolerance or precision" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (result["structure"].as<bool>() and result["metadata"].as<bool>())
+    {
+        std::cerr << error_prefix << "conflicting options --structure and --metadata" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::string changeSource = result["change-source"].as<std::string>();
+    if (changeSource != "walk" and changeSource != "btrfs")
+    {
+        std::cerr << error_prefix << "invalid change source" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<std::string> ignoreRules{};
+    if (result["ignore"].count() > 0)
+        ignoreRules = result["ignore"].as<std::vector<std::string>>();
+    if (result["ignore-from"].count() > 0)
+    {
+        for (const std::string &filename : result["ignore-from"].as<std::vector<std::string>>())
+        {
+            if (not IgnoreFilter::readRules(filename, ignoreRules))
+            {
+                std::cerr << error_prefix << "cannot read ignore rules from " << filename << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    for (const std::string &rule : ignoreRules)
+    {
+        const std::string error = IgnoreFilter::checkRule(rule);
+        if (not error.empty())
+        {
+            std::cerr << error_prefix << error << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::optional<EntryFilter> entryFilter{};
+    if (result["filter"].count() > 0)
+    {
+        std::string error{};
+        entryFilter = EntryFilter::compile(result["filter"].as<std::string>(), error);
+        if (not entryFilter.has_value())
+        {
+            std::cerr << error_prefix << "invalid filter: " << error << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::optional<std::string> pathList{};
+    if (result["files-from"].count() > 0)
+    {
+        if (result["change-source"].count() > 0)
+        {
+            std::cerr << error_prefix << "conflicting options --files-from and --change-source" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        const std::string filesFrom = result["files-from"].as<std::string>();
+        std::ifstream file{};
+        if (filesFrom != "-")
+        {
+            file.open(filesFrom);
+            if (not file)
+            {
+                std::cerr << error_prefix << "cannot read path list " << filesFrom << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        std::istream &input = filesFrom == "-" ? std::cin : file;
+        pathList.emplace(std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{});
+    }
+
     OutputMode outputMode{OutputMode::Compact};
     {
         if (::isatty(STDIN_FILENO) and ::isatty(STDOUT_FILENO))
@@ -147,7 +255,14 @@ int main(int argc, char *argv[])
     YAML::Node config = getConfig();
     Context ctx{{result["debug"].as<bool>(),
                  result["metadata"].as<bool>(),
-                 buffSize},
+                 buffSize,
+                 *contentPolicy,
+                 *mtimeToleranceNs,
+                 *mtimePrecisionNs,
+                 result["checksums"].as<bool>(),
+                 result["checksum-xattr"].as<std::string>(),
+                 result["structure"].as<bool>(),
+                 result["gitignore"].as<bool>()},
                 config};
     ctx.root[0] = std::move(rootL);
     ctx.root[1] = std::move(rootR);
@@ -169,10 +284,29 @@ int main(int argc, char *argv[])
     else
         ctx.dispatcher = makeDispatcherMono(ctx, std::move(report));
     // handle ignore rules
-    if (result["ignore"].count() > 0)
+    if (not ignoreRules.empty())
+    {
+        ctx.ignoreFilter.emplace(ignoreRules);
+    }
+    ctx.entryFilter = std::move(entryFilter);
+    // content policies by path pattern
+    std::string contentRulesError{};
+    auto contentRules = ContentRules::fromConfig(config["content"]["rules"], contentRulesError);
+    if (not contentRules.has_value())
     {
-        ctx.ignoreFilter = std::move(result["ignore"].as<std::vector<std::string>>());
+        std::cerr << error_prefix << "invalid configuration: " << contentRulesError << std::endl;
+        exit(EXIT_FAILURE);
     }
+    if (not contentRules->empty())
+        ctx.contentRules = std::move(contentRules);
+
+    // paths to compare
+    if (pathList.has_value())
+        ctx.changeSource = makeChangeSourcePathList(*pathList);
+    else if (changeSource == "btrfs")
+        ctx.changeSource = makeChangeSourceBtrfs(ctx);
+    else
+        ctx.changeSource = makeChangeSourceFullWalk();
 
     // perform the diff
     diff_dirs(ctx);
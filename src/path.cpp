@@ -29,6 +29,8 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 #include <dirent.h>
 #include <grp.h>
 #include <pwd.h>
+#include <sys/mman.h>
+#include <sys/xattr.h>
 
 #include "path.h"
 
@@ -62,6 +64,30 @@ static FileType::EnumType filetype_from_dt(uint8_t dt)
     return FileType::Unknown;
 }
 
+/// Convert st_mode to FileType
+static FileType::EnumType filetype_from_mode(mode_t mode)
+{
+    switch (mode & S_IFMT)
+    {
+    case S_IFREG:
+        return FileType::Regular;
+    case S_IFDIR:
+        return FileType::Directory;
+    case S_IFBLK:
+        return FileType::Block;
+    case S_IFCHR:
+        return FileType::Character;
+    case S_IFIFO:
+        return FileType::Fifo;
+    case S_IFLNK:
+        return FileType::Symlink;
+    case S_IFSOCK:
+        return FileType::Socket;
+    default:
+        return FileType::Unknown;
+    }
+}
+
 std::string ScopedFd::getContent()
 {
     off_t size = ::lseek(fd, 0, SEEK_END);
@@ -85,6 +111,30 @@ std::string ScopedFd::getContent()
     return buffer;
 }
 
+MappedFile::MappedFile(int rootFd, const std::string &relPath)
+    : m_data{nullptr}, m_size{0}
+{
+    ScopedFd file = ScopedFd::openat(rootFd, relPath, O_RDONLY);
+    struct stat statbuf;
+    if (not file.isValid() or ::fstat(file.fd, &statbuf) < 0 or statbuf.st_size == 0)
+        return;
+    void *data = ::mmap(nullptr, statbuf.st_size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        log_errno("mmap", relPath);
+        return;
+    }
+    ::madvise(data, statbuf.st_size, MADV_SEQUENTIAL);
+    m_data = data;
+    m_size = statbuf.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+        ::munmap(m_data, m_size);
+}
+
 void RootPath::getSortedDirContent(const std::string &relPath, dir_content_type &result) const
 {
     result.clear();
@@ -108,7 +158,15 @@ void RootPath::getSortedDirContent(const std::string &relPath, dir_content_type
         std::string filename = dirEntry->d_name;
         if (filename != "." and filename != "..")
         {
-            result.emplace_back(dirEntry->d_name, filetype_from_dt(dirEntry->d_type));
+            FileType::EnumType fileType = filetype_from_dt(dirEntry->d_type);
+            if (dirEntry->d_type == DT_UNKNOWN)
+            {
+                // filesystem not providing the type in the listing
+                struct stat statbuf;
+                if (::fstatat(dirFd, dirEntry->d_name, &statbuf, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == 0)
+                    fileType = filetype_from_mode(statbuf.st_mode);
+            }
+            result.emplace_back(dirEntry->d_name, fileType);
         }
     }
 
@@ -118,6 +176,45 @@ void RootPath::getSortedDirContent(const std::string &relPath, dir_content_type
     std::sort(result.begin(), result.end());
 }
 
+FileType::EnumType RootPath::getFileType(const std::string &relPath) const
+{
+    struct stat statbuf;
+    if (::fstatat(fd, relPath.c_str(), &statbuf, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) < 0)
+    {
+        // missing file is expected, the path may exist on one side only
+        if (errno != ENOENT and errno != ENOTDIR)
+            log_errno("fstatat", relPath);
+        return FileType::NoFile;
+    }
+    return filetype_from_mode(statbuf.st_mode);
+}
+
+std::string RootPath::getXattr(const std::string &relPath, const std::string &name) const
+{
+    const std::string fullPath = path + "/" + relPath;
+    std::string value(256, '\0');
+    ssize_t res = ::lgetxattr(fullPath.c_str(), name.c_str(), value.data(), value.size());
+    if (res < 0 and errno == ERANGE)
+    {
+        // value does not fit in the buffer: get its size first
+        res = ::lgetxattr(fullPath.c_str(), name.c_str(), nullptr, 0);
+        if (res >= 0)
+        {
+            value.resize(res);
+            res = ::lgetxattr(fullPath.c_str(), name.c_str(), value.data(), value.size());
+        }
+    }
+    if (res < 0)
+    {
+        // missing attribute or no xattr support are expected
+        if (errno != ENODATA and errno != ENOTSUP)
+            log_errno("lgetxattr", relPath);
+        return {};
+    }
+    value.resize(res);
+    return value;
+}
+
 const std::string &UidGidNameReader::getUidName(uid_t uid)
 {
     // access / create element
@@ -28,6 +28,7 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 #include <limits.h>
 #include <map>
 #include <string>
+#include <string_view>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -124,6 +125,41 @@ struct ScopedFd
     int fd; ///< file handle
 };
 
+/// Read-only memory mapping of a whole file, the pages are read from disk on access
+class MappedFile
+{
+public:
+    MappedFile() : m_data{nullptr}, m_size{0} {}
+
+    /// Map a file, empty if it cannot be mapped
+    MappedFile(int rootFd, const std::string &relPath);
+    ~MappedFile();
+
+    // not copyable
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // movable
+    MappedFile(MappedFile &&other) noexcept
+        : m_data{std::exchange(other.m_data, nullptr)}, m_size{std::exchange(other.m_size, 0)} {}
+    MappedFile &operator=(MappedFile &&other) noexcept
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    /// Get the content of the file
+    std::string_view content() const
+    {
+        return {static_cast<const char *>(m_data), m_size};
+    }
+
+private:
+    void *m_data;  ///< mapped content, nullptr if empty
+    size_t m_size; ///< size of the content
+};
+
 /// Directory content
 struct DirEntry;
 typedef std::vector<DirEntry> dir_content_type;
@@ -172,6 +208,11 @@ struct RootPath : public ScopedFd
             log_errno("fstatat", relPath);
     }
 
+    /** Get the type of a file, without following symlinks.
+     * @return NoFile if the file does not exist
+     */
+    FileType::EnumType getFileType(const std::string &relPath) const;
+
     /** Get file symlink target.
      */
     std::string readSymlink(const std::string &relPath, size_t size = 0) const
@@ -194,6 +235,11 @@ struct RootPath : public ScopedFd
         return std::string(buff);
     }
 
+    /** Get an extended attribute of a file, without following symlinks.
+     * @return attribute value, empty if the file has no such attribute
+     */
+    std::string getXattr(const std::string &relPath, const std::string &name) const;
+
     std::string path; ///< filesystem path
 };
 
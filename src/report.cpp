@@ -22,6 +22,8 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  * Generic report object.
  */
 
+#include <ctime>
+
 #include "report.h"
 
 std::string FileEntry::permissions() const
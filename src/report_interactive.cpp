@@ -43,7 +43,7 @@ ReportInteractive::ReportInteractive(Context &_ctx)
 
 void ReportInteractive::operator()(ReportEntry &&reportEntry)
 {
-    app.reportQueue.push(std::move(reportEntry));
+    app.addEntry(std::move(reportEntry));
 }
 
 std::unique_ptr<Report> makeReportInteractive(Context &ctx)
@@ -22,6 +22,9 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  * Terminal application.
  */
 
+#include <array>
+#include <chrono>
+
 #include "term_app.h"
 
 void TermAppWindow::setWinPos(int _origY, int _origX, int _height, int _width)
@@ -290,243 +293,337 @@ void TermAppDetailWindow::addMetadataSimpleLineWarning(const std::u32string &tit
     fieldsRight.emplace_back(warningStr + right + metadataStr, right.size());
 }
 
-void TermAppDetailWindow::updateSelection()
+void TermAppDetailWindow::addMetadata(const ReportEntry &reportEntry, std::vector<std::u32string> &details)
 {
-    DiffEntry *entry = ctx.getSelected();
-    header = entry ? entry->reportEntry.relPath : "";
-    firstDisplayedIndex = 0;
+    fieldsTitle.clear();
+    fieldsLeft.clear();
+    fieldsRight.clear();
 
-    if (entry != nullptr and entry->details.empty())
-    {
-        const ReportEntry &reportEntry = entry->reportEntry;
-        auto &details = entry->details;
+    // prepare details for display
+    const FileType::EnumType fileTypeL = reportEntry.file[0].type;
+    const FileType::EnumType fileTypeR = reportEntry.file[1].type;
 
-        fieldsTitle.clear();
-        fieldsLeft.clear();
-        fieldsRight.clear();
-
-        // prepare details for display
-        const FileType::EnumType fileTypeL = reportEntry.file[0].type;
-        const FileType::EnumType fileTypeR = reportEntry.file[1].type;
+    if (fileTypeR == FileType::NoFile)
+    {
+        // only left file
+        addMetadataSingleFile(reportEntry.file[0], Side::Left);
+    }
+    else if (fileTypeL == FileType::NoFile)
+    {
+        // only right file
+        addMetadataSingleFile(reportEntry.file[1], Side::Right);
+    }
+    else if (fileTypeL != fileTypeR)
+    {
+        // the 2 files exist with different types
+        addMetadataSimpleLineWarning(U"Type",
+                                     termui::toU32String(fileTypeStr[fileTypeL]),
+                                     termui::toU32String(fileTypeStr[fileTypeR]));
+    }
+    else
+    {
+        // two files of same type
+        addMetadataSimpleLineCommon(U"Type",
+                                    termui::toU32String(fileTypeStr[fileTypeL]));
 
-        if (fileTypeR == FileType::NoFile)
+        if (fileTypeL == FileType::Regular)
         {
-            // only left file
-            addMetadataSingleFile(reportEntry.file[0], Side::Left);
+            // file size
+            if (reportEntry.file[0].lstat.st_size == reportEntry.file[1].lstat.st_size)
+                addMetadataSimpleLineCommon(U"Size",
+                                            termui::toU32String(reportEntry.file[0].size()));
+            else
+                addMetadataSimpleLineDiffers(U"Size",
+                                             termui::toU32String(reportEntry.file[0].size()),
+                                             termui::toU32String(reportEntry.file[1].size()));
         }
-        else if (fileTypeL == FileType::NoFile)
+
+        if (fileTypeL == FileType::Regular or fileTypeL == FileType::Symlink)
         {
-            // only right file
-            addMetadataSingleFile(reportEntry.file[1], Side::Right);
+            // file modification time
+            if (reportEntry.file[0].lstat.st_mtim.tv_sec == reportEntry.file[1].lstat.st_mtim.tv_sec)
+                addMetadataSimpleLineCommon(U"Mtime",
+                                            termui::toU32String(reportEntry.file[0].mtime()));
+            else if (reportEntry.file[0].lstat.st_mtim.tv_sec < reportEntry.file[1].lstat.st_mtim.tv_sec)
+                addMetadataSimpleLineDiffers(U"Mtime",
+                                             termui::toU32String(reportEntry.file[0].mtime()),
+                                             termui::toU32String(reportEntry.file[1].mtime()));
+            else
+                addMetadataSimpleLineWarning(U"Mtime",
+                                             termui::toU32String(reportEntry.file[0].mtime()),
+                                             termui::toU32String(reportEntry.file[1].mtime()));
         }
-        else if (fileTypeL != fileTypeR)
+
+        // file ownership
+        if (reportEntry.file[0].lstat.st_uid == reportEntry.file[1].lstat.st_uid and
+            reportEntry.file[0].lstat.st_gid == reportEntry.file[1].lstat.st_gid)
         {
-            // the 2 files exist with different types
-            addMetadataSimpleLineWarning(U"Type",
-                                         termui::toU32String(fileTypeStr[fileTypeL]),
-                                         termui::toU32String(fileTypeStr[fileTypeR]));
+            const std::string ownership =
+                ctx.uidgidReader.getUidName(reportEntry.file[0].lstat.st_uid) +
+                ':' + ctx.uidgidReader.getGidName(reportEntry.file[0].lstat.st_gid);
+            addMetadataSimpleLineCommon(U"Ownership",
+                                        termui::toU32String(ownership));
         }
         else
         {
-            // two files of same type
-            addMetadataSimpleLineCommon(U"Type",
-                                        termui::toU32String(fileTypeStr[fileTypeL]));
+            std::u32string title = U"Ownership";
+            fieldsTitle.emplace_back(std::move(title), title.size());
+            auto &left = fieldsLeft.emplace_back();
+            auto &right = fieldsRight.emplace_back();
 
-            if (fileTypeL == FileType::Regular)
+            const std::u32string ownerL = termui::toU32String(ctx.uidgidReader.getUidName(reportEntry.file[0].lstat.st_uid));
+            if (reportEntry.file[0].lstat.st_uid == reportEntry.file[1].lstat.st_uid)
             {
-                // file size
-                if (reportEntry.file[0].lstat.st_size == reportEntry.file[1].lstat.st_size)
-                    addMetadataSimpleLineCommon(U"Size",
-                                                termui::toU32String(reportEntry.file[0].size()));
-                else
-                    addMetadataSimpleLineDiffers(U"Size",
-                                                 termui::toU32String(reportEntry.file[0].size()),
-                                                 termui::toU32String(reportEntry.file[1].size()));
+                left.str = ownerL;
+                left.displayLength = ownerL.size();
+                right.str = ownerL;
+                right.displayLength = ownerL.size();
             }
-
-            if (fileTypeL == FileType::Regular or fileTypeL == FileType::Symlink)
+            else
             {
-                // file modification time
-                if (reportEntry.file[0].lstat.st_mtim.tv_sec == reportEntry.file[1].lstat.st_mtim.tv_sec)
-                    addMetadataSimpleLineCommon(U"Mtime",
-                                                termui::toU32String(reportEntry.file[0].mtime()));
-                else if (reportEntry.file[0].lstat.st_mtim.tv_sec < reportEntry.file[1].lstat.st_mtim.tv_sec)
-                    addMetadataSimpleLineDiffers(U"Mtime",
-                                                 termui::toU32String(reportEntry.file[0].mtime()),
-                                                 termui::toU32String(reportEntry.file[1].mtime()));
-                else
-                    addMetadataSimpleLineWarning(U"Mtime",
-                                                 termui::toU32String(reportEntry.file[0].mtime()),
-                                                 termui::toU32String(reportEntry.file[1].mtime()));
+                left.str = differenceL + ownerL + normal;
+                left.displayLength = ownerL.size();
+                const std::u32string ownerR = termui::toU32String(ctx.uidgidReader.getUidName(reportEntry.file[1].lstat.st_uid));
+                right.str = differenceR + ownerR + normal;
+                right.displayLength = ownerR.size();
             }
 
-            // file ownership
-            if (reportEntry.file[0].lstat.st_uid == reportEntry.file[1].lstat.st_uid and
-                reportEntry.file[0].lstat.st_gid == reportEntry.file[1].lstat.st_gid)
+            left.str += U':';
+            left.displayLength++;
+            right.str += U':';
+            right.displayLength++;
+
+            const std::u32string groupL = termui::toU32String(ctx.uidgidReader.getGidName(reportEntry.file[0].lstat.st_gid));
+            if (reportEntry.file[0].lstat.st_gid == reportEntry.file[1].lstat.st_gid)
             {
-                const std::string ownership =
-                    ctx.uidgidReader.getUidName(reportEntry.file[0].lstat.st_uid) +
-                    ':' + ctx.uidgidReader.getGidName(reportEntry.file[0].lstat.st_gid);
-                addMetadataSimpleLineCommon(U"Ownership",
-                                            termui::toU32String(ownership));
+                left.str += groupL;
+                left.displayLength += groupL.size();
+                right.str += groupL;
+                right.displayLength += groupL.size();
             }
             else
             {
-                std::u32string title = U"Ownership";
-                fieldsTitle.emplace_back(std::move(title), title.size());
-                auto &left = fieldsLeft.emplace_back();
-                auto &right = fieldsRight.emplace_back();
-
-                const std::u32string ownerL = termui::toU32String(ctx.uidgidReader.getUidName(reportEntry.file[0].lstat.st_uid));
-                if (reportEntry.file[0].lstat.st_uid == reportEntry.file[1].lstat.st_uid)
-                {
-                    left.str = ownerL;
-                    left.displayLength = ownerL.size();
-                    right.str = ownerL;
-                    right.displayLength = ownerL.size();
-                }
-                else
-                {
-                    left.str = differenceL + ownerL + normal;
-                    left.displayLength = ownerL.size();
-                    const std::u32string ownerR = termui::toU32String(ctx.uidgidReader.getUidName(reportEntry.file[1].lstat.st_uid));
-                    right.str = differenceR + ownerR + normal;
-                    right.displayLength = ownerR.size();
-                }
-
-                left.str += U':';
-                left.displayLength++;
-                right.str += U':';
-                right.displayLength++;
-
-                const std::u32string groupL = termui::toU32String(ctx.uidgidReader.getGidName(reportEntry.file[0].lstat.st_gid));
-                if (reportEntry.file[0].lstat.st_gid == reportEntry.file[1].lstat.st_gid)
-                {
-                    left.str += groupL;
-                    left.displayLength += groupL.size();
-                    right.str += groupL;
-                    right.displayLength += groupL.size();
-                }
-                else
-                {
-                    left.str += differenceL + groupL + normal;
-                    left.displayLength += groupL.size();
-                    const std::u32string groupR = termui::toU32String(ctx.uidgidReader.getGidName(reportEntry.file[1].lstat.st_gid));
-                    right.str += differenceR + groupR + normal;
-                    right.displayLength += groupR.size();
-                }
+                left.str += differenceL + groupL + normal;
+                left.displayLength += groupL.size();
+                const std::u32string groupR = termui::toU32String(ctx.uidgidReader.getGidName(reportEntry.file[1].lstat.st_gid));
+                right.str += differenceR + groupR + normal;
+                right.displayLength += groupR.size();
             }
+        }
 
-            // file permissions
-            if (fileTypeL != FileType::Symlink)
+        // file permissions
+        if (fileTypeL != FileType::Symlink)
+        {
+            if (reportEntry.file[0].lstat.st_mode == reportEntry.file[1].lstat.st_mode)
             {
-                if (reportEntry.file[0].lstat.st_mode == reportEntry.file[1].lstat.st_mode)
-                {
-                    addMetadataSimpleLineCommon(U"Permissions",
-                                                termui::toU32String(reportEntry.file[0].permissions()));
-                }
-                else
+                addMetadataSimpleLineCommon(U"Permissions",
+                                            termui::toU32String(reportEntry.file[0].permissions()));
+            }
+            else
+            {
+                std::u32string title = U"Permissions";
+                fieldsTitle.emplace_back(std::move(title), title.size());
+                const std::string filePermL = reportEntry.file[0].permissions();
+                const std::string filePermR = reportEntry.file[1].permissions();
+                auto &left = fieldsLeft.emplace_back(U"", filePermL.size());
+                auto &right = fieldsRight.emplace_back(U"", filePermL.size());
+                bool modeDifference = false;
+                for (int i = 0; i < (int)filePermL.size(); i++)
                 {
-                    std::u32string title = U"Permissions";
-                    fieldsTitle.emplace_back(std::move(title), title.size());
-                    const std::string filePermL = reportEntry.file[0].permissions();
-                    const std::string filePermR = reportEntry.file[1].permissions();
-                    auto &left = fieldsLeft.emplace_back(U"", filePermL.size());
-                    auto &right = fieldsRight.emplace_back(U"", filePermL.size());
-                    bool modeDifference = false;
-                    for (int i = 0; i < (int)filePermL.size(); i++)
-                    {
-                        const bool wantedMode = filePermL[i] != filePermR[i];
-                        if (modeDifference and not wantedMode)
-                        {
-                            left.str += normal;
-                            right.str += normal;
-                            modeDifference = false;
-                        }
-                        else if (not modeDifference and wantedMode)
-                        {
-                            left.str += differenceL;
-                            right.str += differenceR;
-                            modeDifference = true;
-                        }
-                        left.str += filePermL[i];
-                        right.str += filePermR[i];
-                    }
-                    if (modeDifference)
+                    const bool wantedMode = filePermL[i] != filePermR[i];
+                    if (modeDifference and not wantedMode)
                     {
                         left.str += normal;
                         right.str += normal;
+                        modeDifference = false;
                     }
+                    else if (not modeDifference and wantedMode)
+                    {
+                        left.str += differenceL;
+                        right.str += differenceR;
+                        modeDifference = true;
+                    }
+                    left.str += filePermL[i];
+                    right.str += filePermR[i];
+                }
+                if (modeDifference)
+                {
+                    left.str += normal;
+                    right.str += normal;
                 }
             }
         }
+    }
 
-        // build details
-        const int maxTitle = maxDisplayLength(fieldsTitle);
-        const int maxLeft = maxDisplayLength(fieldsLeft);
-        for (int i = 0; i < (int)fieldsTitle.size(); i++)
+    // build details
+    const int maxTitle = maxDisplayLength(fieldsTitle);
+    const int maxLeft = maxDisplayLength(fieldsLeft);
+    for (int i = 0; i < (int)fieldsTitle.size(); i++)
+    {
+        std::u32string &line = details.emplace_back();
+        line += metadataBg;
+        line += titleStart;
+        line += fieldsTitle[i].str;
+        line += titleEnd;
+        line += U": ";
+        line.resize(line.size() + maxTitle - fieldsTitle[i].displayLength, U' ');
+        line += fieldsLeft[i].str;
+        if (not fieldsRight[i].str.empty())
         {
-            std::u32string &line = details.emplace_back();
-            line += metadataBg;
-            line += titleStart;
-            line += fieldsTitle[i].str;
-            line += titleEnd;
-            line += U": ";
-            line.resize(line.size() + maxTitle - fieldsTitle[i].displayLength, U' ');
-            line += fieldsLeft[i].str;
-            if (not fieldsRight[i].str.empty())
-            {
-                line.resize(line.size() + maxLeft - fieldsLeft[i].displayLength, U' ');
-                line += U" <-> ";
-                line += fieldsRight[i].str;
-            }
+            line.resize(line.size() + maxLeft - fieldsLeft[i].displayLength, U' ');
+            line += U" <-> ";
+            line += fieldsRight[i].str;
         }
+    }
+}
+
+void TermAppDetailWindow::updateSelection()
+{
+    DiffEntry *entry = ctx.getSelected();
+    header = entry ? entry->reportEntry.relPath : "";
+    firstDisplayedIndex = 0;
+
+    // content of the previous selection is not needed anymore
+    ctx.detailWorker.cancel();
+
+    // details are computed again if they have been evicted from the cache
+    DiffDetails *cached = entry != nullptr ? ctx.detailCache.get(ctx.selectedIndex) : nullptr;
+    if (entry != nullptr and cached == nullptr)
+    {
+        cached = &ctx.detailCache.insert(ctx.selectedIndex);
+        addMetadata(entry->reportEntry, cached->metadata);
+    }
+
+    if (cached != nullptr and not cached->contentReady)
+    {
+        // metadata is displayed immediately, content may be computed in background
+        cached->content.clear();
+        addContent(entry->reportEntry, *cached);
+    }
+    if (cached != nullptr)
+        ctx.detailCache.update(ctx.selectedIndex);
+}
 
-        // compare content
-        if (fileTypeL != FileType::NoFile and
-            fileTypeR != FileType::NoFile and
-            fileTypeL != fileTypeR)
+void TermAppDetailWindow::addContent(const ReportEntry &reportEntry, DiffDetails &details)
+{
+    TextDetails &content = details.content;
+    const FileType::EnumType fileTypeL = reportEntry.file[0].type;
+    const FileType::EnumType fileTypeR = reportEntry.file[1].type;
+    details.contentReady = true;
+
+    if (fileTypeL != FileType::NoFile and
+        fileTypeR != FileType::NoFile and
+        fileTypeL != fileTypeR)
+    {
+        // 2 files with different types
+        content.addMessage(U"<Different file types, cannot compare>");
+    }
+    else
+    {
+        // 1 file vs None ou 2 files of same type
+        const FileType::EnumType fileType = fileTypeL != FileType::NoFile ? fileTypeL : fileTypeR;
+        if (fileType == FileType::Regular)
         {
-            // 2 files with different types
-            details.emplace_back(U"<Different file types, cannot compare>");
+            // perform file comparison in background: files may be large
+            content.addMessage(U"<Computing…>");
+            details.contentReady = false;
+            ctx.detailWorker.submit(ctx.selectedIndex, reportEntry);
+        }
+        else if (fileType == FileType::Symlink)
+        {
+            // perform link target comparison
+            auto targets = std::make_shared<std::array<std::string, 2>>(std::array<std::string, 2>{
+                fileTypeL == FileType::Symlink ? reportEntry.file[0].symlinkTarget : "",
+                fileTypeR == FileType::Symlink ? reportEntry.file[1].symlinkTarget : ""});
+            const std::string_view targetL = (*targets)[0];
+            const std::string_view targetR = (*targets)[1];
+            content.setContents(std::move(targets), targetL.size() + targetR.size(), targetL, targetR);
+            ctx.textDiff(content);
         }
         else
         {
-            // 1 file vs None ou 2 files of same type
-            const FileType::EnumType fileType = fileTypeL != FileType::NoFile ? fileTypeL : fileTypeR;
-            if (fileType == FileType::Regular)
-            {
-                // perform file comparison
-                std::string content[2];
-                for (int side = 0; side < 2; side++)
-                {
-                    if (reportEntry.file[side].type == FileType::Regular and reportEntry.file[side].lstat.st_size != 0)
-                        content[side] = ScopedFd::openat(ctx.diffDirCtx.root[side].fd, reportEntry.relPath, O_RDONLY).getContent();
-                }
-                ctx.textDiff(content[0], content[1], details);
-            }
-            else if (fileType == FileType::Symlink)
-            {
-                // perform link target comparison
-                ctx.textDiff(fileTypeL == FileType::Symlink ? reportEntry.file[0].symlinkTarget : "",
-                             fileTypeR == FileType::Symlink ? reportEntry.file[1].symlinkTarget : "",
-                             details);
-            }
-            else
-            {
-                // 2 files with different types
-                details.emplace_back(U"<No content display for this file type>");
-            }
+            // 2 files with different types
+            content.addMessage(U"<No content display for this file type>");
+        }
+    }
+}
+
+bool TermAppDetailWindow::setContent(DetailWorker::Result &&result)
+{
+    if (result.index >= (int)ctx.diffs.size())
+        return false;
+
+    DiffDetails *details = ctx.detailCache.peek(result.index);
+    if (ctx.detailWorker.isCurrent(result.jobId))
+    {
+        if (details == nullptr)
+            return false; // evicted from the cache since the job was submitted
+    }
+    else
+    {
+        if (not result.prefetched or (details != nullptr and details->contentReady))
+            return false; // selection moved on since the job was submitted, or already computed
+
+        // prefetched details are the first to be evicted
+        if (details == nullptr)
+        {
+            details = &ctx.detailCache.insert(result.index, false);
+            addMetadata(ctx.diffs[result.index].reportEntry, details->metadata);
         }
     }
+    details->content = std::move(result.details);
+    details->contentReady = true;
+    ctx.detailCache.update(result.index);
+    return result.index == ctx.selectedIndex;
+}
+
+void TermAppDetailWindow::prefetch(int direction)
+{
+    ctx.detailWorker.clearPrefetch();
+    for (int i = 1; i <= ctx.ui.prefetchCount; i++)
+    {
+        const int index = ctx.selectedIndex + direction * i;
+        if (index < 0 or index >= (int)ctx.diffs.size())
+            break;
+        const DiffDetails *details = ctx.detailCache.peek(index);
+        if (details != nullptr and details->contentReady)
+            continue;
+
+        // only the regular files are computed by the worker
+        const ReportEntry &reportEntry = ctx.diffs[index].reportEntry;
+        const FileType::EnumType fileTypeL = reportEntry.file[0].type;
+        const FileType::EnumType fileTypeR = reportEntry.file[1].type;
+        if ((fileTypeL == FileType::Regular or fileTypeL == FileType::NoFile) and
+            (fileTypeR == FileType::Regular or fileTypeR == FileType::NoFile))
+            ctx.detailWorker.prefetch(index, reportEntry);
+    }
+}
+
+void TermAppDetailWindow::determineDisplayContent(int innerHeight, int contentSize)
+{
+    TermAppWindow::determineDisplayContent(innerHeight, contentSize);
+    if (ctx.diffDirCtx.settings.debug)
+    {
+        // usage of the detail cache, size of the previous frame sent to the terminal
+        const auto &cache = ctx.detailCache;
+        footer.textLeft = "cache " + std::to_string(cache.hits()) + " hits " + std::to_string(cache.misses()) +
+                          " misses " + std::to_string(cache.size()) + " entries " +
+                          std::to_string(cache.bytes() >> 10) + " KiB, frame " +
+                          std::to_string(ctx.tmui.lastPublishSize()) + " B";
+    }
 }
 
 void TermAppDetailWindow::drawContentLine(int y, int contentIndex)
 {
-    const DiffEntry *entry = ctx.getSelected();
-    if (entry != nullptr and contentIndex < (int)entry->details.size())
+    const DiffDetails *details = ctx.getSelectedDetails();
+    if (details == nullptr)
+        return;
+    if (contentIndex < (int)details->metadata.size())
+        ctx.tmui.addFString(y, origX, details->metadata[contentIndex], width);
+    else if (size_t(contentIndex) < details->metadata.size() + details->content.size())
     {
-        ctx.tmui.addFString(y, origX, entry->details[contentIndex], width);
+        // content lines are converted only when visible
+        ctx.tmui.addFString(y, origX, ctx.textDiff.formatLine(details->content, contentIndex - details->metadata.size()), width);
     }
 }
 
@@ -557,9 +654,66 @@ void TermAppDetailWindow::move(MoveKind mv)
     // clipping of firstDisplayedIndex is done in determineDisplayContent() to handle screen resize
 }
 
+void TermAppDetailWindow::moveHunk(bool next)
+{
+    const DiffDetails *details = ctx.getSelectedDetails();
+    if (details == nullptr)
+        return;
+    const TextDetails &content = details->content;
+
+    // the block of differences is displayed below the first line of the window
+    const long current = long(firstDisplayedIndex) + 1 - long(details->metadata.size());
+    long target = current;
+    if (next)
+    {
+        for (long i = std::max(0L, current + 1); i < (long)content.size(); i++)
+        {
+            if (content.isHunkStart(i))
+            {
+                target = i;
+                break;
+            }
+        }
+    }
+    else
+    {
+        for (long i = std::min(current, (long)content.size()) - 1; i >= 0; i--)
+        {
+            if (content.isHunkStart(i))
+            {
+                target = i;
+                break;
+            }
+        }
+    }
+    if (target != current)
+        firstDisplayedIndex = std::max(0L, target - 1 + long(details->metadata.size()));
+}
+
+bool TermAppDetailWindow::expandFold()
+{
+    DiffDetails *details = ctx.getSelectedDetails();
+    if (details == nullptr)
+        return false;
+    TextDetails &content = details->content;
+
+    const int innerHeight = height - 2; // header and footer
+    for (int y = 0; y < innerHeight; y++)
+    {
+        const long index = long(firstDisplayedIndex) + y - long(details->metadata.size());
+        if (index >= 0 and index < (long)content.size() and content[index].kind == TextDetails::Fold)
+        {
+            content.expandFold(index);
+            ctx.detailCache.update(ctx.selectedIndex);
+            return true;
+        }
+    }
+    return false;
+}
+
 TermApp::TermApp(Context &_diffDirCtx, const std::string &title)
     : diffDirCtx{_diffDirCtx}, ctx{_diffDirCtx}, winList{ctx}, winDetail{ctx}, reportQueue{},
-      spinnerIndex{0}, spinnerStepCountdown{0}, appThread{}
+      spinnerIndex{0}, appThread{}
 {
     ctx.tmui.setDefaultColors(ctx.ui.normal.colorFg, ctx.ui.normal.colorBg);
     winList.header = title;
@@ -571,6 +725,13 @@ TermApp::~TermApp()
 {
     // close the queue to indicate the end of the diff-dir scan
     reportQueue.close();
+    ctx.tmui.notify();
+}
+
+void TermApp::addEntry(ReportEntry &&reportEntry)
+{
+    reportQueue.push(std::move(reportEntry));
+    ctx.tmui.notify();
 }
 
 /// element for the separator with scroll bars
@@ -635,15 +796,36 @@ void TermApp::moveSelection(MoveKind mv)
     winList.moveSelection(mv);
     if (ctx.selectedIndex != prevSelection)
         winDetail.updateSelection();
+
+    // the next entries are prefetched when moving line by line, not on jumps
+    if (mv == MoveKind::LineDown or mv == MoveKind::LineUp)
+        winDetail.prefetch(mv == MoveKind::LineDown ? 1 : -1);
+    else
+        ctx.detailWorker.cancelPrefetch();
 }
 
 void TermApp::run()
 {
+    using Clock = std::chrono::steady_clock;
+    const auto cycleTime = std::chrono::milliseconds{ctx.ui.cycleTimeMs};
+    const auto spinnerStepTime = std::chrono::milliseconds{ctx.ui.spinnerStepTimeMs};
+
     bool exit = false;
     bool needRedraw = true;
+    bool newEntries = false; // entries retrieved since the last redraw
     bool pollQueue = true;
+    Clock::time_point lastRedraw{};
+    Clock::time_point nextSpinnerStep = Clock::now();
     while (not exit)
     {
+        // retrieve the content details computed in background
+        while (auto result = ctx.detailWorker.getResult())
+        {
+            if (winDetail.setContent(std::move(*result)))
+                needRedraw = true;
+        }
+
+        const auto now = Clock::now();
         if (pollQueue)
         {
             // retrieve newly available report entries
@@ -658,7 +840,7 @@ void TermApp::run()
                 if (ctx.diffs.size() == 1)
                     // first element added; select it
                     winDetail.updateSelection();
-                needRedraw = true;
+                newEntries = true;
             }
 
             // check if we still need to poll the queue
@@ -669,27 +851,42 @@ void TermApp::run()
                 winList.footer.textLeft = "";
                 needRedraw = true;
             }
-            else
+            else if (now >= nextSpinnerStep)
             {
                 // update spinner
-                if (--spinnerStepCountdown <= 0)
-                {
-                    winList.footer.textLeft = ctx.ui.spinnerStrings[spinnerIndex];
-                    if (++spinnerIndex >= (int)ctx.ui.spinnerStrings.size())
-                        spinnerIndex = 0;
-                    spinnerStepCountdown = ctx.ui.spinnerStepCount;
-                    needRedraw = true;
-                }
+                winList.footer.textLeft = ctx.ui.spinnerStrings[spinnerIndex];
+                if (++spinnerIndex >= (int)ctx.ui.spinnerStrings.size())
+                    spinnerIndex = 0;
+                nextSpinnerStep = now + spinnerStepTime;
+                needRedraw = true;
             }
         }
 
+        // the new entries are displayed at most once per cycle, with the other updates if any
+        int timeoutMs = -1;
+        if (newEntries and not needRedraw)
+        {
+            if (now - lastRedraw >= cycleTime)
+                needRedraw = true;
+            else
+                timeoutMs = std::chrono::ceil<std::chrono::milliseconds>(lastRedraw + cycleTime - now).count();
+        }
         if (needRedraw)
         {
             redraw();
+            lastRedraw = now;
             needRedraw = false;
+            newEntries = false;
         }
 
-        const termui::Event event = ctx.tmui.waitForEvent(ctx.ui.cycleTimeMs);
+        // wake up for the events, the new entries and results, and the spinner only
+        if (pollQueue)
+        {
+            const int spinnerTimeoutMs =
+                std::max<int>(0, std::chrono::ceil<std::chrono::milliseconds>(nextSpinnerStep - now).count());
+            timeoutMs = timeoutMs < 0 ? spinnerTimeoutMs : std::min(timeoutMs, spinnerTimeoutMs);
+        }
+        const termui::Event event = ctx.tmui.waitForEvent(timeoutMs);
         switch (event.value())
         {
         case termui::Event::kTermResize:
@@ -766,6 +963,21 @@ void TermApp::run()
             needRedraw = true;
             break;
 
+        case '[':
+            winDetail.moveHunk(false);
+            needRedraw = true;
+            break;
+
+        case ']':
+            winDetail.moveHunk(true);
+            needRedraw = true;
+            break;
+
+        case termui::Event::kEnter:
+            if (winDetail.expandFold())
+                needRedraw = true;
+            break;
+
         default:
             // unknown or no key: ignore
             break;
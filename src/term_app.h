@@ -39,6 +39,8 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 #include <vector>
 
 #include "concurrent.h"
+#include "detail_worker.h"
+#include "lru_cache.h"
 #include "report.h"
 #include "term_app_settings.h"
 #include "text_diff.h"
@@ -47,10 +49,28 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 struct DiffEntry
 {
     DiffEntry(ReportEntry &&_reportEntry)
-        : reportEntry{std::move(_reportEntry)}, details{} {}
+        : reportEntry{std::move(_reportEntry)} {}
 
     ReportEntry reportEntry;
-    std::vector<std::u32string> details;
+};
+
+/// Details of a difference entry, kept in a cache
+struct DiffDetails
+{
+    DiffDetails() : metadata{}, content{}, contentReady{false} {}
+
+    /// Get the memory used by the details
+    size_t memorySize() const
+    {
+        size_t size = content.memorySize();
+        for (const std::u32string &line : metadata)
+            size += sizeof(line) + line.capacity() * sizeof(char32_t);
+        return size;
+    }
+
+    std::vector<std::u32string> metadata; ///< metadata lines, displayed first
+    TextDetails content;                  ///< content lines, converted when displayed
+    bool contentReady;                    ///< whether the content lines are complete
 };
 
 /// Movement of the content inside windows
@@ -68,7 +88,8 @@ enum class MoveKind
 struct TermAppContext
 {
     TermAppContext(const Context &_diffDirCtx)
-        : diffDirCtx{_diffDirCtx}, tmui{}, ui{_diffDirCtx}, diffs{}, selectedIndex{0}, uidgidReader{}, textDiff{ui} {}
+        : diffDirCtx{_diffDirCtx}, tmui{}, ui{_diffDirCtx}, diffs{}, selectedIndex{0}, uidgidReader{}, textDiff{ui},
+          detailCache{ui.detailCacheSize}, detailWorker{_diffDirCtx, textDiff, [this]() { tmui.notify(); }} {}
 
     // not copyable (detect unwanted copies)
     TermAppContext(const TermAppContext &) = delete;
@@ -79,15 +100,23 @@ struct TermAppContext
         return (selectedIndex >= 0 and selectedIndex < (int)diffs.size()) ? &diffs[selectedIndex] : nullptr;
     }
 
+    /// Get the details of the selected entry, nullptr if they are not computed
+    DiffDetails *getSelectedDetails()
+    {
+        return detailCache.peek(selectedIndex);
+    }
+
     const Context &diffDirCtx; ///< diff dir context
     termui::TermUi tmui;       ///< TermUi instance to manage the terminal
     TermAppSettings ui;        ///< ui settings
 
     // app internal data
-    std::vector<DiffEntry> diffs;  ///< difference list
-    int selectedIndex;             ///< index of item currently selected
-    UidGidNameReader uidgidReader; ///< get uid / gid names
-    TextDifference textDiff;       ///< handler to compute difference on text files
+    std::vector<DiffEntry> diffs;           ///< difference list
+    int selectedIndex;                      ///< index of item currently selected
+    UidGidNameReader uidgidReader;          ///< get uid / gid names
+    TextDifference textDiff;                ///< handler to compute difference on text files
+    LruCache<int, DiffDetails> detailCache; ///< details of the last selected entries, by index
+    DetailWorker detailWorker;              ///< computation of the content details in background
 };
 
 /// Multiple fields on a single line
@@ -173,17 +202,37 @@ struct TermAppDetailWindow : public TermAppWindow
 
     void updateSelection();
 
+    /** Set the content details computed in background.
+     * @return whether the displayed details changed
+     */
+    bool setContent(DetailWorker::Result &&result);
+
+    /** Prefetch the details of the next entries.
+     * @param[in] direction  1 for the entries after the selected one, -1 for the ones before
+     */
+    void prefetch(int direction);
+
     int getContentSize() const override
     {
-        const DiffEntry *entry = ctx.getSelected();
-        return entry == nullptr ? 0 : entry->details.size();
+        const DiffDetails *details = ctx.getSelectedDetails();
+        return details == nullptr ? 0 : details->metadata.size() + details->content.size();
     }
 
     void drawContentLine(int y, int contentIndex) override;
 
+    void determineDisplayContent(int innerHeight, int contentSize) override;
+
     /// Move the window for the displayed content
     void move(MoveKind mv);
 
+    /// Move the window to the next or previous block of differences
+    void moveHunk(bool next);
+
+    /** Expand the first folded lines displayed in the window.
+     * @return whether some lines were expanded
+     */
+    bool expandFold();
+
 private:
     /// Formatted string with display size
     struct FormattedString
@@ -194,6 +243,12 @@ private:
     /// Get max display length from a list
     static int maxDisplayLength(const std::vector<FormattedString> &v);
 
+    /// Add the metadata details
+    void addMetadata(const ReportEntry &reportEntry, std::vector<std::u32string> &details);
+
+    /// Add the content details, or request them to the worker
+    void addContent(const ReportEntry &reportEntry, DiffDetails &details);
+
     /// Add metadata information when file exists only on one side
     void addMetadataSingleFile(const FileEntry &file, Side side);
 
@@ -237,6 +292,9 @@ struct TermApp
     TermApp(const TermApp &) = delete;
     TermApp &operator=(const TermApp &) = delete;
 
+    /// Add a difference found by the scan, called from the scan thread
+    void addEntry(ReportEntry &&reportEntry);
+
     /// Redraw completely the application
     void redraw();
 
@@ -252,6 +310,5 @@ struct TermApp
     TermAppDetailWindow winDetail;            ///< window handling the details of one difference
     ConcurrentQueue<ReportEntry> reportQueue; ///< queue giving report entry from diff-dir algo
     int spinnerIndex;                         ///< index of current string for spinner
-    int spinnerStepCountdown;                 ///< countdown to keep current string of spinner on display
     std::jthread appThread;                   ///< thread running the event loop
 };
\ No newline at end of file
@@ -58,9 +58,15 @@ TermAppSettings::TermAppSettings(const Context &diffDirCtx)
     cycleTimeMs = appCfg["cycleTimeMs"].as<uint32_t>();
     for (const auto &entry : appCfg["spinner"]["strings"])
         spinnerStrings.emplace_back(entry.as<std::string>());
-    spinnerStepCount = appCfg["spinner"]["stepTimeMs"].as<uint32_t>() / cycleTimeMs;
+    spinnerStepTimeMs = appCfg["spinner"]["stepTimeMs"].as<uint32_t>();
+    detailCacheSize = appCfg["detailCacheSize"].as<size_t>(128) << 20;
+    prefetchCount = appCfg["prefetchCount"].as<int>(2);
     diffCommonThreshold = appCfg["text"]["diffCommonThreshold"].as<uint32_t>();
+    diffAlgorithm = appCfg["text"]["diffAlgorithm"].as<std::string>("myers");
+    contextLines = appCfg["text"]["contextLines"].as<int>(3);
     tabSize = appCfg["text"]["tabSize"].as<uint32_t>();
+    largeFileSize = appCfg["text"]["largeFile"]["size"].as<size_t>(64) << 20;
+    largeFileMemoryCap = appCfg["text"]["largeFile"]["memoryCap"].as<size_t>(256) << 20;
     replaceCR = termui::toU32String(appCfg["text"]["replacement"]["carriageReturn"].as<std::string>());
     replaceEscape = termui::toU32String(appCfg["text"]["replacement"]["escape"].as<std::string>());
     replaceTab = termui::toU32String(appCfg["text"]["replacement"]["tab"].as<std::string>());
@@ -49,11 +49,17 @@ struct TermAppSettings
     termui::Color warningBg;                 ///< alert user when modification time is more recent on left
     termui::Color metadataBg;                ///< metadata details background color
     int minWidthForLeftRightView;            ///< minimal window width to use left / right view
-    int cycleTimeMs;                         ///< cycle time for the terminal application, in ms
+    int cycleTimeMs;                         ///< minimum time between the refreshes for the new differences, in ms
     std::vector<std::string> spinnerStrings; ///< strings for the spinner, displayed cyclically
-    int spinnerStepCount;                    ///< number of cycleTimeMs each spinner string is displayed
+    int spinnerStepTimeMs;                   ///< time each spinner string is displayed, in ms
+    size_t detailCacheSize;                  ///< memory for the details of the last selected entries, in bytes
+    int prefetchCount;                       ///< number of entries prefetched in the direction of the movement
     int diffCommonThreshold;                 ///< percentage of difference between files for different display
+    std::string diffAlgorithm;               ///< algorithm computing the differences between text files
+    int contextLines;                        ///< common lines displayed around the differences, negative for all
     int tabSize;                             ///< size to expand tabs
+    size_t largeFileSize;                    ///< size above which text files are compared with largeFileMemoryCap
+    size_t largeFileMemoryCap;               ///< memory used to compare large text files, in bytes
     std::u32string replaceCR;                ///< string replace for carriage return
     std::u32string replaceEscape;            ///< string replace for escape
     std::u32string replaceTab;               ///< string replace for tabulation
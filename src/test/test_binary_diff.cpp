@@ -0,0 +1,133 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test binary_diff.cpp.
+ */
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "../binary_diff.h"
+#include "tmp_dir.h"
+
+/// Prefix of equal or different bytes, on both sides of the blocks
+TEST(BinaryDiff, bytes_prefix)
+{
+    const std::string bufferL(100, 'a');
+    for (size_t pos : {0, 7, 15, 16, 40, 99})
+    {
+        std::string bufferR = bufferL;
+        bufferR[pos] = 'b';
+        EXPECT_EQ(bytesPrefix(bufferL.data(), bufferR.data(), bufferR.size(), true), pos);
+
+        std::string different(100, 'c');
+        different[pos] = 'a';
+        EXPECT_EQ(bytesPrefix(bufferL.data(), different.data(), different.size(), false), pos);
+    }
+    EXPECT_EQ(bytesPrefix(bufferL.data(), bufferL.data(), bufferL.size(), true), bufferL.size());
+    EXPECT_EQ(bytesPrefix(bufferL.data(), bufferL.data(), bufferL.size(), false), 0u);
+}
+
+/// Files with some differing bytes
+struct BinaryDiffTest : public TmpDirTest
+{
+    void SetUp() override
+    {
+        TmpDirTest::SetUp();
+        for (int side = 0; side < 2; side++)
+        {
+            const std::string dir = tmpDir + (side == 0 ? "/L" : "/R");
+            ::mkdir(dir.c_str(), 0700);
+            rootFd[side] = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        }
+    }
+
+    void TearDown() override
+    {
+        for (int fd : rootFd)
+            ::close(fd);
+        TmpDirTest::TearDown();
+    }
+
+    /// Compare 2 contents, get the ranges
+    std::vector<ByteRange> compare(const std::string &contentL, const std::string &contentR, size_t maxRanges = 10,
+                                   uint64_t mergeGap = 0, bool *complete = nullptr)
+    {
+        std::ofstream{tmpDir + "/L/file", std::ios::binary} << contentL;
+        std::ofstream{tmpDir + "/R/file", std::ios::binary} << contentR;
+        const bool isRegular[2] = {true, true};
+        const off_t size[2] = {off_t(contentL.size()), off_t(contentR.size())};
+        const BinaryFiles files{rootFd, "file", isRegular, size};
+
+        std::vector<ByteRange> ranges{};
+        const bool result = findByteRanges(files, maxRanges, mergeGap, ranges);
+        if (complete != nullptr)
+            *complete = result;
+        return ranges;
+    }
+
+    int rootFd[2];
+};
+
+/// Compare ranges
+static bool operator==(const ByteRange &a, const ByteRange &b)
+{
+    return a.begin == b.begin and a.end == b.end;
+}
+
+/// Print ranges in the failure messages
+static std::ostream &operator<<(std::ostream &os, const ByteRange &range)
+{
+    return os << "[" << range.begin << ", " << range.end << ")";
+}
+
+/// Ranges of differing bytes, across the chunks
+TEST_F(BinaryDiffTest, ranges)
+{
+    EXPECT_EQ(compare("same", "same"), std::vector<ByteRange>{});
+    EXPECT_EQ(compare("abcdef", "aXcdYY"), (std::vector<ByteRange>{{1, 2}, {4, 6}}));
+    // sizes differ: the end of the largest file differs
+    EXPECT_EQ(compare("abc", "abcdef"), (std::vector<ByteRange>{{3, 6}}));
+    EXPECT_EQ(compare("abX", "abcdef"), (std::vector<ByteRange>{{2, 6}}));
+    EXPECT_EQ(compare("", "ab"), (std::vector<ByteRange>{{0, 2}}));
+
+    // large files, with a range across 2 chunks
+    std::string contentL(1 << 20, '\0');
+    std::string contentR = contentL;
+    for (size_t pos = (256 << 10) - 10; pos < (256 << 10) + 10; pos++)
+        contentR[pos] = 1;
+    contentR[900000] = 1;
+    EXPECT_EQ(compare(contentL, contentR),
+              (std::vector<ByteRange>{{(256 << 10) - 10, (256 << 10) + 10}, {900000, 900001}}));
+}
+
+/// Close ranges are merged, the comparison stops after the maximal number of ranges
+TEST_F(BinaryDiffTest, limits)
+{
+    EXPECT_EQ(compare("abcdefgh", "XbXdefXh", 10, 1), (std::vector<ByteRange>{{0, 3}, {6, 7}}));
+    EXPECT_EQ(compare("abcdefgh", "XbXdefXh", 10, 3), (std::vector<ByteRange>{{0, 7}}));
+
+    bool complete = false;
+    EXPECT_EQ(compare("abcdefgh", "XbXdefXh", 2, 0, &complete), (std::vector<ByteRange>{{0, 1}, {2, 3}}));
+    EXPECT_FALSE(complete);
+    EXPECT_EQ(compare("abcdefgh", "XbXdefXh", 3, 0, &complete), (std::vector<ByteRange>{{0, 1}, {2, 3}, {6, 7}}));
+    EXPECT_TRUE(complete);
+}
@@ -0,0 +1,163 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test checksum.cpp.
+ */
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sys/xattr.h>
+
+#include "../checksum.h"
+#include "test_settings.h"
+#include "tmp_dir.h"
+
+static const std::string digestA = "ca978112ca1bbdcafac231b39a23dc4da786eff8147c4e72b9807785afee48bb";
+static const std::string digestB = "3E23E8160039594A33894F6564E1B1348BBD7A0088D42C4ACB73EEAED59C009D";
+
+/// Temporary directories with files on both sides
+struct ChecksumTest : public TmpDirTest
+{
+    void SetUp() override
+    {
+        TmpDirTest::SetUp();
+        for (const char *side : {"/L", "/R"})
+        {
+            ::mkdir((tmpDir + side).c_str(), 0700);
+            std::ofstream{tmpDir + side + "/file"} << "content";
+        }
+    }
+
+    /// Write a SHA256SUMS file on one side
+    void writeSums(const char *side, const std::string &content)
+    {
+        std::ofstream{tmpDir + side + "/SHA256SUMS"} << content;
+    }
+
+    /// Store a digest of "file" in its xattr on one side, valid for its mtime; false if xattr are not supported
+    bool setXattrDigest(const char *side, const std::string &digest)
+    {
+        const std::string path = tmpDir + side + "/file";
+        if (::setxattr(path.c_str(), "user.checksum", digest.data(), digest.size(), 0) < 0)
+            return false;
+        struct stat statbuf;
+        ::lstat(path.c_str(), &statbuf);
+        const std::string nsec = std::to_string(statbuf.st_mtim.tv_nsec);
+        const std::string mtime =
+            std::to_string(statbuf.st_mtim.tv_sec) + "." + std::string(9 - nsec.size(), '0') + nsec;
+        return ::setxattr(path.c_str(), "user.checksum.mtime", mtime.data(), mtime.size(), 0) == 0;
+    }
+
+    /// Compare the digests of "file" in a fresh reader
+    std::optional<bool> sameDigest()
+    {
+        YAML::Node config{};
+        Settings settings = makeTestSettings();
+        settings.useChecksums = true;
+        settings.checksumXattr = "user.checksum";
+        Context ctx{settings, config};
+        ctx.root[0] = RootPath{tmpDir + "/L"};
+        ctx.root[1] = RootPath{tmpDir + "/R"};
+        struct stat statL, statR;
+        ctx.root[0].lstat("file", statL);
+        ctx.root[1].lstat("file", statR);
+        ChecksumReader reader{ctx};
+        return reader.sameDigest(".", "file", statL, statR);
+    }
+};
+
+/// No digest available
+TEST_F(ChecksumTest, no_digest)
+{
+    EXPECT_FALSE(sameDigest().has_value());
+
+    // digest only on one side
+    writeSums("/L", digestA + "  file\n");
+    EXPECT_FALSE(sameDigest().has_value());
+}
+
+/// Digests from SHA256SUMS files
+TEST_F(ChecksumTest, sums_file)
+{
+    writeSums("/L", digestA + "  file\n" + digestB + "  other\n");
+    writeSums("/R", digestB + " *other\n" + digestA + " *./file\n");
+    EXPECT_EQ(sameDigest(), true);
+
+    writeSums("/R", digestB + "  file\n");
+    EXPECT_EQ(sameDigest(), false);
+
+    // file modified after the SHA256SUMS file was written
+    const struct timespec future[2] = {{0, UTIME_OMIT}, {::time(nullptr) + 100, 0}};
+    ::utimensat(AT_FDCWD, (tmpDir + "/L/file").c_str(), future, 0);
+    EXPECT_FALSE(sameDigest().has_value());
+}
+
+/// Values which are not SHA-256 digests are ignored
+TEST_F(ChecksumTest, invalid_digest)
+{
+    // MD5 on one side
+    writeSums("/L", digestA + "  file\n");
+    writeSums("/R", "900150983cd24fb0d6963f7d28e17f72  file\n");
+    EXPECT_FALSE(sameDigest().has_value());
+    writeSums("/R", digestA + "00  file\n");
+    EXPECT_FALSE(sameDigest().has_value());
+
+    // embedded spaces or NUL characters, a final newline is accepted
+    const std::string spaced = digestA.substr(0, 32) + " " + digestA.substr(32);
+    const std::string withNul = digestA.substr(0, 32) + std::string{"\0", 1} + digestA.substr(32);
+    for (const std::string &digest : {spaced, withNul, digestA + "\n"})
+    {
+        if (not setXattrDigest("/L", digestA) or not setXattrDigest("/R", digest))
+            GTEST_SKIP() << "no user xattr support in /tmp";
+        if (digest == digestA + "\n")
+            EXPECT_EQ(sameDigest(), true);
+        else
+            EXPECT_FALSE(sameDigest().has_value());
+    }
+}
+
+/// Digests from extended attributes
+TEST_F(ChecksumTest, xattr)
+{
+    for (const char *side : {"/L", "/R"})
+    {
+        const std::string path = tmpDir + side + "/file";
+        if (::setxattr(path.c_str(), "user.checksum", digestA.data(), digestA.size(), 0) < 0)
+            GTEST_SKIP() << "no user xattr support in /tmp";
+    }
+    // digests without timestamp are not trusted
+    EXPECT_FALSE(sameDigest().has_value());
+
+    for (const char *side : {"/L", "/R"})
+    {
+        const std::string path = tmpDir + side + "/file";
+        struct stat statbuf;
+        ::lstat(path.c_str(), &statbuf);
+        const std::string nsec = std::to_string(statbuf.st_mtim.tv_nsec);
+        const std::string mtime = std::to_string(statbuf.st_mtim.tv_sec) + "." + std::string(9 - nsec.size(), '0') + nsec;
+        ::setxattr(path.c_str(), "user.checksum.mtime", mtime.data(), mtime.size(), 0);
+    }
+    EXPECT_EQ(sameDigest(), true);
+
+    const std::string pathR = tmpDir + "/R/file";
+    ::setxattr(pathR.c_str(), "user.checksum", digestB.data(), digestB.size(), 0);
+    EXPECT_EQ(sameDigest(), false);
+}
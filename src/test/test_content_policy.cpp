@@ -0,0 +1,138 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test content_policy.cpp.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../content_policy.h"
+#include "../context.h"
+#include "test_settings.h"
+
+/// Build a stat with the given timestamps
+static struct stat makeStat(time_t mtimeSec, long mtimeNsec, time_t ctimeSec = 0)
+{
+    struct stat result{};
+    result.st_mtim.tv_sec = mtimeSec;
+    result.st_mtim.tv_nsec = mtimeNsec;
+    result.st_ctim.tv_sec = ctimeSec;
+    return result;
+}
+
+/// Test duration parsing
+TEST(ContentPolicyTest, duration)
+{
+    EXPECT_EQ(parseDurationNs("0"), 0);
+    EXPECT_EQ(parseDurationNs("2"), 2000000000);
+    EXPECT_EQ(parseDurationNs("2s"), 2000000000);
+    EXPECT_EQ(parseDurationNs("1500ms"), 1500000000);
+    EXPECT_EQ(parseDurationNs("10us"), 10000);
+    EXPECT_EQ(parseDurationNs("100ns"), 100);
+    EXPECT_FALSE(parseDurationNs("").has_value());
+    EXPECT_FALSE(parseDurationNs("-1s").has_value());
+    EXPECT_FALSE(parseDurationNs("2h").has_value());
+    // not representable in ns
+    EXPECT_EQ(parseDurationNs("9223372036s"), 9223372036000000000);
+    EXPECT_FALSE(parseDurationNs("10000000000s").has_value());
+    EXPECT_FALSE(parseDurationNs("9223372037s").has_value());
+}
+
+/// Test the default policy: exact mtime
+TEST(ContentPolicyTest, mtime_exact)
+{
+    const Settings settings = makeTestSettings();
+    EXPECT_TRUE(isContentTrusted(settings, settings.contentPolicy, makeStat(10, 5), makeStat(10, 5)));
+    EXPECT_FALSE(isContentTrusted(settings, settings.contentPolicy, makeStat(10, 5), makeStat(10, 6)));
+}
+
+/// Test mtime tolerance and truncated precision
+TEST(ContentPolicyTest, mtime_tolerance_precision)
+{
+    Settings tolerance = makeTestSettings();
+    tolerance.mtimeToleranceNs = 2000000000;
+    EXPECT_TRUE(isContentTrusted(tolerance, tolerance.contentPolicy, makeStat(10, 0), makeStat(12, 0)));
+    EXPECT_TRUE(isContentTrusted(tolerance, tolerance.contentPolicy, makeStat(12, 0), makeStat(10, 0)));
+    EXPECT_FALSE(isContentTrusted(tolerance, tolerance.contentPolicy, makeStat(10, 0), makeStat(12, 1)));
+
+    Settings precision = makeTestSettings();
+    precision.mtimePrecisionNs = 2000000000;
+    EXPECT_TRUE(isContentTrusted(precision, precision.contentPolicy, makeStat(10, 0), makeStat(11, 999999999)));
+    EXPECT_FALSE(isContentTrusted(precision, precision.contentPolicy, makeStat(11, 0), makeStat(12, 0)));
+}
+
+/// Test the other policies
+TEST(ContentPolicyTest, policies)
+{
+    const Settings settings = makeTestSettings();
+
+    EXPECT_TRUE(isContentTrusted(settings, ContentPolicy::SizeOnly, makeStat(10, 0), makeStat(20, 0)));
+    EXPECT_FALSE(isContentTrusted(settings, ContentPolicy::AlwaysVerify, makeStat(10, 0), makeStat(10, 0)));
+
+    // ctime of each side compared with its own mtime
+    EXPECT_TRUE(isContentTrusted(settings, ContentPolicy::CtimeTrust, makeStat(10, 0, 10), makeStat(10, 0, 10)));
+    EXPECT_FALSE(isContentTrusted(settings, ContentPolicy::CtimeTrust, makeStat(10, 0, 10), makeStat(10, 0, 30)));
+    EXPECT_FALSE(isContentTrusted(settings, ContentPolicy::CtimeTrust, makeStat(10, 0, 30), makeStat(10, 0, 10)));
+    EXPECT_FALSE(isContentTrusted(settings, ContentPolicy::CtimeTrust, makeStat(10, 0, 10), makeStat(11, 0, 11)));
+    Settings tolerance = makeTestSettings();
+    tolerance.mtimeToleranceNs = 2000000000;
+    EXPECT_TRUE(isContentTrusted(tolerance, ContentPolicy::CtimeTrust, makeStat(10, 0, 12), makeStat(10, 0, 11)));
+    EXPECT_FALSE(isContentTrusted(tolerance, ContentPolicy::CtimeTrust, makeStat(10, 0, 13), makeStat(10, 0, 10)));
+}
+
+/// Test the policies by path pattern
+TEST(ContentPolicyTest, rules)
+{
+    std::string error{};
+    const auto rules = ContentRules::fromConfig(YAML::Load(R"(
+        - pattern: ["*.log", "/cache"]
+          policy: skip
+        - pattern: "*-wal"
+          policy: skip
+        - pattern: "/etc/*.conf"
+          policy: always-verify
+        - pattern: "*.conf"
+          policy: hash-only
+    )"),
+                                                error);
+    ASSERT_TRUE(rules.has_value()) << error;
+    EXPECT_TRUE(rules->usesDigests());
+
+    const ContentRules::State root = rules->getState(".");
+    EXPECT_EQ(rules->policy(root, "app.log"), ContentPolicy::Skip);
+    EXPECT_EQ(rules->policy(root, "db-wal"), ContentPolicy::Skip);
+    EXPECT_EQ(rules->policy(root, "a.conf"), ContentPolicy::HashOnly);
+    EXPECT_EQ(rules->policy(root, "a.txt"), std::nullopt);
+    EXPECT_EQ(rules->policy(rules->getState("cache"), "a.txt"), ContentPolicy::Skip);
+    EXPECT_EQ(rules->policy(rules->getState("cache/sub"), "a.conf"), ContentPolicy::Skip);
+    EXPECT_EQ(rules->policy(rules->getState("sub/cache"), "a.txt"), std::nullopt);
+    EXPECT_EQ(rules->policy(rules->getState("etc"), "a.conf"), ContentPolicy::AlwaysVerify);
+    EXPECT_EQ(rules->policy(rules->getState("etc/sub"), "a.conf"), ContentPolicy::HashOnly);
+    EXPECT_EQ(rules->policy(rules->getState("etc"), "a.log"), ContentPolicy::Skip);
+
+    EXPECT_TRUE(ContentRules::fromConfig(YAML::Load("[]"), error)->empty());
+    EXPECT_TRUE(ContentRules::fromConfig(YAML::Node{}, error)->empty());
+    for (const char *invalid : {"{pattern: a, policy: skip}", "[{pattern: a}]", "[{pattern: a, policy: never}]",
+                                "[{pattern: {a: b}, policy: skip}]", "[{pattern: '[0-9]+', policy: skip}]"})
+    {
+        EXPECT_FALSE(ContentRules::fromConfig(YAML::Load(invalid), error).has_value()) << invalid;
+    }
+}
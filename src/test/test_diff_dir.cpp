@@ -0,0 +1,354 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test diff_dir.cpp.
+ */
+
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include "../diff_dir.h"
+#include "../report.h"
+#include "test_settings.h"
+#include "tmp_dir.h"
+
+/// Report recording the reported paths
+class ReportCapture : public Report
+{
+public:
+    ReportCapture(const Context &ctx, std::vector<std::string> &paths) : Report{ctx}, m_paths{paths} {}
+
+    void operator()(ReportEntry &&reportEntry) override
+    {
+        m_paths.push_back(reportEntry.relPath);
+    }
+
+private:
+    std::vector<std::string> &m_paths; ///< reported paths
+};
+
+/// ChangeSource returning predefined candidates
+class ChangeSourceFake : public ChangeSource
+{
+public:
+    ChangeSourceFake(std::vector<ChangeCandidate> candidates, bool available = true)
+        : m_candidates{std::move(candidates)}, m_available{available} {}
+
+    bool getCandidates(std::vector<ChangeCandidate> &candidates) override
+    {
+        candidates = m_candidates;
+        return m_available;
+    }
+
+private:
+    std::vector<ChangeCandidate> m_candidates; ///< candidates to return
+    bool m_available;                          ///< whether the candidates can be used
+};
+
+/// Options of the comparisons in DiffDirTest
+struct DiffOptions
+{
+    bool structureOnly{false};                              ///< compare names and types only
+    std::vector<std::string> ignoreRules{};                 ///< ignore rules given by the user
+    bool gitIgnore{false};                                  ///< use the ignore files found in the trees
+    std::string filter{};                                   ///< entry filter expression
+    std::string contentRules{};                             ///< content rules, in YAML
+    ContentPolicy contentPolicy{ContentPolicy::MtimeTrust}; ///< default content policy
+    bool useChecksums{false};                               ///< use the digests stored alongside the files
+};
+
+/// Temporary directories with differences
+struct DiffDirTest : public TmpDirTest
+{
+    void SetUp() override
+    {
+        TmpDirTest::SetUp();
+        for (const char *side : {"/L", "/R"})
+        {
+            for (const char *dir : {"", "/dir", "/dir/sub"})
+                ::mkdir((tmpDir + side + dir).c_str(), 0700);
+            std::ofstream{tmpDir + side + "/same"} << "same";
+            std::ofstream{tmpDir + side + "/dir/inner"} << "inner";
+        }
+        std::ofstream{tmpDir + "/L/size"} << "a";
+        std::ofstream{tmpDir + "/R/size"} << "bb";
+        std::ofstream{tmpDir + "/L/dir/sub/deep"} << "x";
+        std::ofstream{tmpDir + "/R/dir/sub/deep"} << "yy";
+        std::ofstream{tmpDir + "/L/onlyL"} << "";
+        std::ofstream{tmpDir + "/R/onlyR"} << "";
+        std::ofstream{tmpDir + "/L/type"} << "file";
+        ::mkdir((tmpDir + "/R/type").c_str(), 0700);
+        std::ofstream{tmpDir + "/R/type/child"} << "child";
+    }
+
+    /// Run the diff with the given change source, get the sorted reported paths
+    std::vector<std::string> diff(std::unique_ptr<ChangeSource> changeSource, const DiffOptions &options = {})
+    {
+        std::vector<std::string> paths{};
+        YAML::Node config{};
+        Settings settings = makeTestSettings();
+        settings.contentPolicy = options.contentPolicy;
+        settings.useChecksums = options.useChecksums;
+        settings.structureOnly = options.structureOnly;
+        settings.gitIgnore = options.gitIgnore;
+        Context ctx{settings, config};
+        ctx.root[0] = RootPath{tmpDir + "/L"};
+        ctx.root[1] = RootPath{tmpDir + "/R"};
+        ctx.dispatcher = makeDispatcherMono(ctx, std::make_unique<ReportCapture>(ctx, paths));
+        ctx.changeSource = std::move(changeSource);
+        if (not options.ignoreRules.empty())
+            ctx.ignoreFilter.emplace(options.ignoreRules);
+        if (not options.filter.empty())
+        {
+            std::string error{};
+            ctx.entryFilter = EntryFilter::compile(options.filter, error);
+        }
+        if (not options.contentRules.empty())
+        {
+            std::string error{};
+            ctx.contentRules = ContentRules::fromConfig(YAML::Load(options.contentRules), error);
+        }
+        diff_dirs(ctx);
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+};
+
+/// All the differences
+static const std::vector<std::string> allDiffs = {"dir/sub/deep", "onlyL", "onlyR", "size", "type"};
+
+/// Full walk, with or without change source
+TEST_F(DiffDirTest, full_walk)
+{
+    EXPECT_EQ(diff({}), allDiffs);
+    EXPECT_EQ(diff(makeChangeSourceFullWalk()), allDiffs);
+    // candidates cannot be determined
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(std::vector<ChangeCandidate>{}, false)), allDiffs);
+}
+
+/// Single entries
+TEST_F(DiffDirTest, entries)
+{
+    const std::vector<ChangeCandidate> candidates = {
+        {"same", ChangeCandidate::Entry},
+        {"size", ChangeCandidate::Entry},
+        {"./dir/sub//deep", ChangeCandidate::Entry},
+        {"onlyR", ChangeCandidate::Entry},
+        {"missing/file", ChangeCandidate::Entry},
+        {"dir", ChangeCandidate::Entry}, // no descent
+    };
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates)),
+              (std::vector<std::string>{"dir/sub/deep", "onlyR", "size"}));
+}
+
+/// Ancestor which is not a directory on both sides is reported once
+TEST_F(DiffDirTest, ancestors)
+{
+    const std::vector<ChangeCandidate> candidates = {
+        {"type/child", ChangeCandidate::Entry},
+        {"type/other/file", ChangeCandidate::Entry},
+    };
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates)), (std::vector<std::string>{"type"}));
+}
+
+/// Directory scopes, overlapping candidates are compared once
+TEST_F(DiffDirTest, scopes)
+{
+    // children of the roots, and sub-directories with different inodes
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(std::vector<ChangeCandidate>{{".", ChangeCandidate::Children}})),
+              allDiffs);
+
+    const std::vector<ChangeCandidate> candidates = {
+        {"dir", ChangeCandidate::Recursive},
+        {"dir/sub/deep", ChangeCandidate::Entry},
+        {"size", ChangeCandidate::Entry},
+        {"size", ChangeCandidate::Recursive},
+        {"./size", ChangeCandidate::Children},
+    };
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates)),
+              (std::vector<std::string>{"dir/sub/deep", "size"}));
+}
+
+/// Paths from a list
+TEST_F(DiffDirTest, path_list)
+{
+    const std::vector<std::string> expected = {"dir/sub/deep", "onlyL", "size"};
+    EXPECT_EQ(diff(makeChangeSourcePathList("size\nsame\n\nonlyL\ndir/\n")), expected);
+    EXPECT_EQ(diff(makeChangeSourcePathList(std::string{"size\0same\0onlyL\0dir/\0", 21})), expected);
+    // a directory without trailing / is compared as a single entry
+    EXPECT_EQ(diff(makeChangeSourcePathList("dir")), std::vector<std::string>{});
+    // paths with .. are skipped, they could lead out of the roots
+    EXPECT_EQ(diff(makeChangeSourcePathList("dir/../size\n../L/size\n..\ndir/sub/..\n")), std::vector<std::string>{});
+}
+
+/// Names and types only
+TEST_F(DiffDirTest, structure_only)
+{
+    EXPECT_EQ(diff({}, {.structureOnly = true}), (std::vector<std::string>{"onlyL", "onlyR", "type"}));
+}
+
+/// Ignored entries, with full walk and candidates
+TEST_F(DiffDirTest, ignore)
+{
+    const std::vector<std::string> rules = {"dir/sub", "/onlyL", "typ?"};
+    const std::vector<std::string> expected = {"onlyR", "size"};
+    EXPECT_EQ(diff({}, {.ignoreRules = rules}), expected);
+
+    const std::vector<ChangeCandidate> candidates = {
+        {"dir/sub/deep", ChangeCandidate::Entry},
+        {"dir", ChangeCandidate::Children},
+        {"onlyL", ChangeCandidate::Entry},
+        {"onlyR", ChangeCandidate::Entry},
+        {"size", ChangeCandidate::Entry},
+        {"type/child", ChangeCandidate::Entry},
+    };
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates), {.ignoreRules = rules}), expected);
+}
+
+/// Ignore files found in the trees
+TEST_F(DiffDirTest, gitignore)
+{
+    std::ofstream{tmpDir + "/L/.gitignore"} << "only*\n!onlyR\ntype/\n";
+    std::ofstream{tmpDir + "/R/.gitignore"} << "only*\n!onlyR\ntype/\n";
+    std::ofstream{tmpDir + "/L/dir/.diffignore"} << "/sub/\n";
+    std::ofstream{tmpDir + "/R/dir/.diffignore"} << "/sub/\n";
+    EXPECT_EQ(diff({}), allDiffs);
+
+    const std::vector<std::string> expected = {"onlyR", "size"};
+    EXPECT_EQ(diff({}, {.gitIgnore = true}), expected);
+
+    const std::vector<ChangeCandidate> candidates = {
+        {"dir/sub/deep", ChangeCandidate::Entry},
+        {"onlyL", ChangeCandidate::Entry},
+        {"onlyR", ChangeCandidate::Entry},
+        {"size", ChangeCandidate::Entry},
+        {"type/child", ChangeCandidate::Entry},
+    };
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates), {.gitIgnore = true}), expected);
+
+    // ignored on one side only
+    std::ofstream{tmpDir + "/R/.gitignore"} << "size\n";
+    EXPECT_EQ(diff({}, {.gitIgnore = true}), (std::vector<std::string>{".gitignore", "onlyR"}));
+}
+
+/// Files excluded from their attributes
+TEST_F(DiffDirTest, filter)
+{
+    // excluded on one side: excluded
+    EXPECT_EQ(diff({}, {.filter = "type==file and size>1"}), (std::vector<std::string>{"onlyL", "onlyR"}));
+    EXPECT_EQ(diff({}, {.filter = "type==dir"}), (std::vector<std::string>{"onlyL", "onlyR", "size"}));
+    EXPECT_EQ(diff({}, {.structureOnly = true, .filter = "size==0"}), (std::vector<std::string>{"type"}));
+
+    const std::vector<ChangeCandidate> candidates = {
+        {"dir/sub/deep", ChangeCandidate::Entry},
+        {"size", ChangeCandidate::Entry},
+    };
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates), {.filter = "type==dir"}),
+              (std::vector<std::string>{"size"}));
+    // size of a directory unknown: its tree is compared
+    EXPECT_EQ(diff(std::make_unique<ChangeSourceFake>(candidates), {.filter = "type==dir and size>0"}),
+              (std::vector<std::string>{"dir/sub/deep", "size"}));
+}
+
+/// Size and age filters do not exclude the trees of directories
+TEST_F(DiffDirTest, filter_directories)
+{
+    // small recent file with a different content, in an old directory
+    const struct timespec old[2] = {{0, UTIME_OMIT}, {::time(nullptr) - 100 * 86400, 0}};
+    for (const char *side : {"/L", "/R"})
+    {
+        ::mkdir((tmpDir + side + "/d").c_str(), 0700);
+        std::ofstream{tmpDir + side + "/d/x"} << side;
+        ::utimensat(AT_FDCWD, (tmpDir + side + "/d").c_str(), old, 0);
+    }
+    const struct timespec recent[2] = {{0, UTIME_OMIT}, {::time(nullptr) - 100, 0}};
+    ::utimensat(AT_FDCWD, (tmpDir + "/L/d/x").c_str(), recent, 0);
+    std::vector<std::string> expected = allDiffs;
+    expected.insert(expected.begin(), "d/x");
+    EXPECT_EQ(diff({}, {.filter = "size>4"}), expected);
+    EXPECT_EQ(diff({}, {.filter = "age>30d"}), expected);
+    EXPECT_EQ(diff({}, {.filter = "type==dir and age>30d"}), expected);
+}
+
+/// Content policies by path pattern
+TEST_F(DiffDirTest, content_rules)
+{
+    // same size and same mtime, different content
+    std::ofstream{tmpDir + "/L/dir/inner"} << "INNER";
+    std::ofstream{tmpDir + "/L/same"} << "SAME";
+    for (const char *path : {"/dir/inner", "/same"})
+    {
+        struct stat statbuf;
+        ::stat((tmpDir + "/R" + path).c_str(), &statbuf);
+        const struct timespec times[2] = {statbuf.st_atim, statbuf.st_mtim};
+        ::utimensat(AT_FDCWD, (tmpDir + "/L" + path).c_str(), times, 0);
+    }
+    EXPECT_EQ(diff({}), allDiffs);
+
+    const std::string rules = "[{pattern: [size, deep], policy: skip}, {pattern: /dir, policy: always-verify},"
+                              " {pattern: same, policy: hash-only}]";
+    EXPECT_EQ(diff({}, {.contentRules = rules}), (std::vector<std::string>{"dir/inner", "onlyL", "onlyR", "type"}));
+}
+
+/// Stored digests decide for the hash-only files, and with --checksums for the files not always verified
+TEST_F(DiffDirTest, digests)
+{
+    // same size, different content, fresh and equal digests on both sides
+    const std::string digest(64, 'a');
+    std::ofstream{tmpDir + "/L/dir/inner"} << "INNER";
+    std::ofstream{tmpDir + "/L/same"} << "SAME";
+    const struct timespec past[2] = {{0, UTIME_OMIT}, {::time(nullptr) - 100, 0}};
+    for (const char *path : {"/L/dir/inner", "/L/same"})
+        ::utimensat(AT_FDCWD, (tmpDir + path).c_str(), past, 0);
+    for (const char *side : {"/L", "/R"})
+    {
+        std::ofstream{tmpDir + side + "/SHA256SUMS"} << digest << "  same\n";
+        std::ofstream{tmpDir + side + "/dir/SHA256SUMS"} << digest << "  inner\n";
+    }
+    const std::vector<std::string> allContent = {"dir/inner", "dir/sub/deep", "onlyL", "onlyR", "same", "size", "type"};
+    const std::vector<std::string> noContent = {"dir/sub/deep", "onlyL", "onlyR", "size", "type"};
+
+    // a hash-only rule does not change the other files
+    EXPECT_EQ(diff({}, {.contentRules = "[{pattern: same, policy: hash-only}, {pattern: /dir, policy: always-verify}]"}),
+              (std::vector<std::string>{"dir/inner", "dir/sub/deep", "onlyL", "onlyR", "size", "type"}));
+    EXPECT_EQ(diff({}, {.contentRules = "[{pattern: same, policy: hash-only}]"}),
+              (std::vector<std::string>{"dir/inner", "dir/sub/deep", "onlyL", "onlyR", "size", "type"}));
+
+    // --checksums, except for the files always verified
+    EXPECT_EQ(diff({}, {.useChecksums = true}), noContent);
+    EXPECT_EQ(diff({}, {.contentPolicy = ContentPolicy::AlwaysVerify, .useChecksums = true}), allContent);
+    EXPECT_EQ(diff({}, {.contentRules = "[{pattern: /dir, policy: always-verify}]", .useChecksums = true}),
+              (std::vector<std::string>{"dir/inner", "dir/sub/deep", "onlyL", "onlyR", "size", "type"}));
+
+    // hash-only without digests: mtime-trust, the content is read when the mtimes differ
+    ::unlink((tmpDir + "/R/SHA256SUMS").c_str());
+    EXPECT_EQ(diff({}, {.contentRules = "[{pattern: same, policy: hash-only}]"}),
+              (std::vector<std::string>{"SHA256SUMS", "dir/inner", "dir/sub/deep", "onlyL", "onlyR", "same", "size",
+                                        "type"}));
+    // same content without digests is not a difference, dir/inner is still decided by its digests
+    std::ofstream{tmpDir + "/L/same"} << "same";
+    ::utimensat(AT_FDCWD, (tmpDir + "/L/same").c_str(), past, 0);
+    EXPECT_EQ(diff({}, {.contentPolicy = ContentPolicy::HashOnly}),
+              (std::vector<std::string>{"SHA256SUMS", "dir/sub/deep", "onlyL", "onlyR", "size", "type"}));
+}
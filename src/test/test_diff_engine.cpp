@@ -0,0 +1,252 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test the difference algorithms of diff_engine.h.
+ */
+
+#include <gtest/gtest.h>
+#include <random>
+
+#include "../diff_engine.h"
+
+/// Check that a script is a valid edit script from a to b, get its number of common lines
+static size_t checkScript(const std::vector<line_id> &a, const std::vector<line_id> &b,
+                          const std::vector<DiffEdit> &script)
+{
+    size_t posA = 0, posB = 0, common = 0;
+    for (const DiffEdit &edit : script)
+    {
+        switch (edit.type)
+        {
+        case DiffEdit::Common:
+            EXPECT_EQ(edit.pos, posA);
+            EXPECT_LT(posB, b.size());
+            if (posB < b.size())
+            {
+                EXPECT_EQ(a[posA], b[posB]);
+            }
+            posA++;
+            posB++;
+            common++;
+            break;
+        case DiffEdit::Delete:
+            EXPECT_EQ(edit.pos, posA);
+            posA++;
+            break;
+        case DiffEdit::Add:
+            EXPECT_EQ(edit.pos, posB);
+            posB++;
+            break;
+        }
+    }
+    EXPECT_EQ(posA, a.size());
+    EXPECT_EQ(posB, b.size());
+    return common;
+}
+
+/// Run an engine, check the script, get its number of common lines
+static size_t commonLines(const char *name, const std::vector<line_id> &a, const std::vector<line_id> &b)
+{
+    const auto engine = makeDiffEngine(name);
+    std::vector<DiffEdit> script{};
+    engine->diff(a, b, script);
+    return checkScript(a, b, script);
+}
+
+/// Engines by name
+TEST(DiffEngine, names)
+{
+    for (const char *name : {"myers", "patience", "histogram"})
+        EXPECT_NE(makeDiffEngine(name), nullptr) << name;
+    EXPECT_EQ(makeDiffEngine("minimal"), nullptr);
+}
+
+/// Simple cases, with a single possible result
+TEST(DiffEngine, simple)
+{
+    for (const char *name : {"myers", "patience", "histogram"})
+    {
+        SCOPED_TRACE(name);
+        EXPECT_EQ(commonLines(name, {}, {}), 0u);
+        EXPECT_EQ(commonLines(name, {1, 2, 3}, {}), 0u);
+        EXPECT_EQ(commonLines(name, {}, {1, 2}), 0u);
+        EXPECT_EQ(commonLines(name, {1, 2, 3}, {1, 2, 3}), 3u);
+        EXPECT_EQ(commonLines(name, {1, 2, 3, 4}, {1, 5, 3, 4}), 3u);
+        EXPECT_EQ(commonLines(name, {1, 2, 3}, {4, 5}), 0u);
+    }
+}
+
+/// Moved block: patience and histogram keep the unique lines, the brace lines are not used as anchors
+TEST(DiffEngine, moved_block)
+{
+    // f() { a } g() { b } -> g() { b } f() { a }
+    const std::vector<line_id> a = {10, 1, 11, 2, 20, 1, 21, 2};
+    const std::vector<line_id> b = {20, 1, 21, 2, 10, 1, 11, 2};
+    EXPECT_EQ(commonLines("myers", a, b), 4u);
+    EXPECT_EQ(commonLines("patience", a, b), 4u);
+    EXPECT_EQ(commonLines("histogram", a, b), 4u);
+}
+
+/// Random sequences with few distinct lines, many repetitions
+TEST(DiffEngine, random)
+{
+    std::mt19937 generator{42};
+    for (int round = 0; round < 50; round++)
+    {
+        std::uniform_int_distribution<line_id> line{0, line_id(round % 10 + 1)};
+        std::vector<line_id> a(generator() % 200), b{};
+        for (line_id &id : a)
+            id = line(generator);
+        // b: a with random edits
+        for (line_id id : a)
+        {
+            const unsigned action = generator() % 10;
+            if (action == 0)
+                continue; // deleted
+            if (action == 1)
+                b.push_back(line(generator)); // added
+            b.push_back(id);
+        }
+
+        const size_t minimal = commonLines("myers", a, b);
+        EXPECT_LE(commonLines("patience", a, b), minimal);
+        EXPECT_LE(commonLines("histogram", a, b), minimal);
+    }
+}
+
+/// Cancelled comparison
+TEST(DiffEngine, stop)
+{
+    std::stop_source stopSource{};
+    stopSource.request_stop();
+    for (const char *name : {"myers", "patience", "histogram"})
+    {
+        std::vector<DiffEdit> script{};
+        makeDiffEngine(name)->diff(std::vector<line_id>{1, 2}, std::vector<line_id>{3}, script, stopSource.get_token());
+        EXPECT_TRUE(script.empty()) << name;
+    }
+}
+
+/// Check that hunks are valid differing ranges from a to b, get their number of edits
+static size_t checkHunks(const std::vector<line_id> &a, const std::vector<line_id> &b,
+                         const std::vector<DiffHunk> &hunks)
+{
+    size_t posA = 0, posB = 0, edits = 0;
+    for (const DiffHunk &hunk : hunks)
+    {
+        // common lines before the hunk
+        EXPECT_EQ(hunk.beginA - posA, hunk.beginB - posB);
+        for (; posA < hunk.beginA and posB < hunk.beginB; posA++, posB++)
+            EXPECT_EQ(a[posA], b[posB]);
+        EXPECT_TRUE(hunk.beginA < hunk.endA or hunk.beginB < hunk.endB);
+        edits += hunk.endA - hunk.beginA + hunk.endB - hunk.beginB;
+        posA = hunk.endA;
+        posB = hunk.endB;
+    }
+    EXPECT_EQ(a.size() - posA, b.size() - posB);
+    for (; posA < a.size() and posB < b.size(); posA++, posB++)
+        EXPECT_EQ(a[posA], b[posB]);
+    return edits;
+}
+
+/// Linear space algorithm: minimal number of edits, a single hunk above the cost
+TEST(DiffEngine, linear)
+{
+    std::mt19937 generator{42};
+    for (int round = 0; round < 50; round++)
+    {
+        std::uniform_int_distribution<line_id> line{0, line_id(round % 10 + 1)};
+        std::vector<line_id> a(generator() % 200), b{};
+        for (line_id &id : a)
+            id = line(generator);
+        for (line_id id : a)
+        {
+            const unsigned action = generator() % 10;
+            if (action == 0)
+                continue;
+            if (action == 1)
+                b.push_back(line(generator));
+            b.push_back(id);
+        }
+
+        const size_t common = commonLines("myers", a, b);
+        std::vector<DiffHunk> hunks{};
+        diffHunksLinear(a, b, UINT32_MAX, hunks);
+        EXPECT_EQ(checkHunks(a, b, hunks), a.size() + b.size() - 2 * common);
+    }
+
+    // too expensive
+    std::vector<DiffHunk> hunks{};
+    diffHunksLinear(std::vector<line_id>{0, 1, 2, 3, 4, 5}, std::vector<line_id>{0, 6, 2, 7, 4, 5}, 1, hunks);
+    ASSERT_EQ(hunks.size(), 1u);
+    EXPECT_EQ(hunks[0].beginA, 1u);
+    EXPECT_EQ(hunks[0].endA, 4u);
+}
+
+/// Segments compared in parallel: same script as the whole sequences
+TEST(DiffEngine, segmented)
+{
+    // blocks with few distinct lines, separated by unique lines in common context,
+    // each block has lines unique in the block but not in the whole sequences
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<line_id> line{0, 5};
+    std::vector<line_id> a{}, b{};
+    line_id unique = 1000;
+    for (int block = 0; block < 20; block++)
+    {
+        for (int i = 0; i < 50; i++)
+        {
+            const line_id id = i % 10 == 5 ? 200 + i / 10 : line(generator);
+            const unsigned action = generator() % 10;
+            if (action != 0)
+                a.push_back(id);
+            if (action != 1)
+                b.push_back(action == 2 ? line(generator) : id);
+        }
+        for (line_id id : {line_id{100}, unique++, line_id{100}})
+        {
+            a.push_back(id);
+            b.push_back(id);
+        }
+    }
+
+    ThreadPool pool{3};
+    for (const char *name : {"myers", "patience", "histogram"})
+    {
+        SCOPED_TRACE(name);
+        const auto engine = makeDiffEngine(name);
+        std::vector<DiffEdit> whole{}, segmented{};
+        engine->diff(a, b, whole);
+        diffSegmented(*engine, a, b, segmented, pool, 100);
+        checkScript(a, b, segmented);
+        ASSERT_EQ(segmented.size(), whole.size());
+        for (size_t i = 0; i < whole.size(); i++)
+        {
+            EXPECT_EQ(segmented[i].type, whole[i].type) << i;
+            EXPECT_EQ(segmented[i].pos, whole[i].pos) << i;
+        }
+    }
+
+    // only patience splits the sequences
+    EXPECT_FALSE(makeDiffEnginePatience()->splitAnchors(a, b).empty());
+    EXPECT_TRUE(makeDiffEngineMyers()->splitAnchors(a, b).empty());
+    EXPECT_TRUE(makeDiffEngineHistogram()->splitAnchors(a, b).empty());
+}
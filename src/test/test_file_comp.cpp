@@ -22,16 +22,22 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  * Test file_comp.cpp.
  */
 
+#include <fstream>
 #include <gtest/gtest.h>
+#include <linux/fiemap.h>
 
 #include "../file_comp.h"
 #include "../report.h"
+#include "test_settings.h"
+#include "tmp_dir.h"
 
 /// Test with same content
 TEST(FileCompTest, all)
 {
     YAML::Node config{};
-    Context ctx{{false, false, 4096 * 16}, config};
+    Settings settings = makeTestSettings();
+    settings.contentBufferSize = 4096 * 16;
+    Context ctx{settings, config};
     for (int side = 0; side < 2; side++)
         ctx.root[side] = RootPath{"."}; // use current working directory
     FileCompareContent fileComp{ctx};
@@ -42,4 +48,118 @@ TEST(FileCompTest, all)
     const size_t size = statbuff.st_size;
 
     EXPECT_TRUE(fileComp(relPath, size));
-}
\ No newline at end of file
+}
+
+/// ExtentProvider returning predefined extents
+class ExtentProviderMock : public ExtentProvider
+{
+public:
+    bool getExtents(int, size_t, std::vector<FileExtent> &extents) override
+    {
+        if (not available)
+            return false;
+        // identify the side from the order of the calls
+        extents = calls++ % 2 == 0 ? extentsL : extentsR;
+        return true;
+    }
+
+    bool getDevice(int, dev_t &device) override
+    {
+        device = (deviceCalls++ % 2 == 0 or sameDevice) ? 1 : 2;
+        return true;
+    }
+
+    bool available{true};
+    bool sameDevice{true};
+    int calls{0};
+    int deviceCalls{0};
+    std::vector<FileExtent> extentsL;
+    std::vector<FileExtent> extentsR;
+};
+
+/// Files with different content, with extent maps given by a mock
+struct FileCompExtentTest : public TmpDirTest
+{
+    static constexpr size_t fileSize = 3 * 4096;
+
+    void SetUp() override
+    {
+        TmpDirTest::SetUp();
+        // files differ only in their second block
+        for (char side : {'L', 'R'})
+        {
+            const std::string dir = tmpDir + "/" + side;
+            ::mkdir(dir.c_str(), 0700);
+            std::ofstream file{dir + "/file"};
+            file << std::string(4096, 'a') << std::string(4096, side) << std::string(4096, 'c');
+        }
+    }
+
+    /// Compare the files using the mock
+    bool compare()
+    {
+        YAML::Node config{};
+        Settings settings = makeTestSettings();
+        settings.contentBufferSize = 1024;
+        Context ctx{settings, config};
+        ctx.root[0] = RootPath{tmpDir + "/L"};
+        ctx.root[1] = RootPath{tmpDir + "/R"};
+        FileCompareContent fileComp{ctx, mock};
+        return fileComp("file", fileSize);
+    }
+
+    std::shared_ptr<ExtentProviderMock> mock{std::make_shared<ExtentProviderMock>()};
+};
+
+/// No extent map available: content is read
+TEST_F(FileCompExtentTest, fallback)
+{
+    mock->available = false;
+    EXPECT_FALSE(compare());
+}
+
+/// All extents shared: content is not read
+TEST_F(FileCompExtentTest, all_shared)
+{
+    mock->extentsL = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST}};
+    mock->extentsR = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST}};
+    EXPECT_TRUE(compare());
+}
+
+/// Shared extents with different boundaries on each side
+TEST_F(FileCompExtentTest, shared_split)
+{
+    mock->extentsL = {{0, 0x10000, 4096, 0}, {4096, 0x11000, 2 * 4096, FIEMAP_EXTENT_LAST}};
+    mock->extentsR = {{0, 0x10000, 3 * 4096, FIEMAP_EXTENT_LAST}};
+    EXPECT_TRUE(compare());
+}
+
+/// Only the differing block is not shared: it is read
+TEST_F(FileCompExtentTest, partially_shared)
+{
+    mock->extentsL = {{0, 0x10000, 4096, 0}, {4096, 0x20000, 4096, 0}, {8192, 0x12000, 4096, FIEMAP_EXTENT_LAST}};
+    mock->extentsR = {{0, 0x10000, 4096, 0}, {4096, 0x30000, 4096, 0}, {8192, 0x12000, 4096, FIEMAP_EXTENT_LAST}};
+    EXPECT_FALSE(compare());
+
+    // a shared block at another logical offset does not hold the same data
+    mock->extentsL = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST}};
+    mock->extentsR = {{0, 0x10000, 4096, 0}, {4096, 0x10000, 2 * 4096, FIEMAP_EXTENT_LAST}};
+    EXPECT_FALSE(compare());
+}
+
+/// Extents with unreliable physical location are read
+TEST_F(FileCompExtentTest, unreliable)
+{
+    mock->extentsL = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST | FIEMAP_EXTENT_DELALLOC}};
+    mock->extentsR = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST}};
+    EXPECT_FALSE(compare());
+}
+
+/// Same extents on different devices: content is read
+TEST_F(FileCompExtentTest, different_devices)
+{
+    mock->sameDevice = false;
+    mock->extentsL = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST}};
+    mock->extentsR = {{0, 0x10000, fileSize, FIEMAP_EXTENT_LAST}};
+    EXPECT_FALSE(compare());
+}
@@ -0,0 +1,148 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test filter.cpp.
+ */
+
+#include <ctime>
+#include <gtest/gtest.h>
+
+#include "../filter.h"
+
+/// Compile an expression that shall be valid
+static EntryFilter compile(const std::string &expression)
+{
+    std::string error{};
+    const auto filter = EntryFilter::compile(expression, error);
+    EXPECT_TRUE(filter.has_value()) << expression << ": " << error;
+    return filter.value_or(EntryFilter::compile("type==file", error).value());
+}
+
+/// Build a stat with a size and a mtime
+static struct stat makeStat(off_t size, time_t mtime)
+{
+    struct stat statbuf{};
+    statbuf.st_size = size;
+    statbuf.st_mtim.tv_sec = mtime;
+    return statbuf;
+}
+
+/// Comparisons on each attribute
+TEST(EntryFilter, attributes)
+{
+    const struct stat small = makeStat(100, 0);
+    const struct stat big = makeStat(3LL << 30, 0);
+
+    EXPECT_TRUE(compile("size>1G").matches(FileType::Regular, big));
+    EXPECT_FALSE(compile("size>1G").matches(FileType::Regular, small));
+    EXPECT_TRUE(compile("size<=100").matches(FileType::Regular, small));
+    EXPECT_TRUE(compile("size==1.5K").matches(FileType::Regular, makeStat(1536, 0)));
+
+    EXPECT_TRUE(compile("type==socket").matches(FileType::Socket, small));
+    EXPECT_FALSE(compile("type==socket").matches(FileType::Fifo, small));
+    EXPECT_TRUE(compile("type != dir").matches(FileType::Fifo, small));
+    EXPECT_FALSE(compile("type==socket").needsStat());
+    EXPECT_TRUE(compile("type==socket or size>0").needsStat());
+
+    const time_t now = ::time(nullptr);
+    EXPECT_TRUE(compile("age>1d").matches(FileType::Regular, makeStat(0, now - 2 * 86400)));
+    EXPECT_FALSE(compile("age>1d").matches(FileType::Regular, makeStat(0, now - 3600)));
+    EXPECT_TRUE(compile("age<2h").matches(FileType::Regular, makeStat(0, now - 3600)));
+
+    EXPECT_TRUE(compile("mtime<@1000").matches(FileType::Regular, makeStat(0, 999)));
+    EXPECT_FALSE(compile("mtime<@1000").matches(FileType::Regular, makeStat(0, 1000)));
+    EXPECT_TRUE(compile("mtime>=2000-01-01").matches(FileType::Regular, makeStat(0, now)));
+    EXPECT_FALSE(compile("mtime>2000-01-01T12:30").matches(FileType::Regular, makeStat(0, 0)));
+
+    // dates compared at their precision
+    struct stat subsecond = makeStat(0, 1000);
+    subsecond.st_mtim.tv_nsec = 500000000;
+    EXPECT_TRUE(compile("mtime==@1000").matches(FileType::Regular, subsecond));
+    EXPECT_FALSE(compile("mtime!=@1000").matches(FileType::Regular, subsecond));
+    EXPECT_TRUE(compile("mtime<=@1000").matches(FileType::Regular, subsecond));
+    EXPECT_FALSE(compile("mtime>@1000").matches(FileType::Regular, subsecond));
+    EXPECT_FALSE(compile("mtime==@1001").matches(FileType::Regular, subsecond));
+    struct tm tm{};
+    tm.tm_year = 2000 - 1900;
+    tm.tm_mday = 1;
+    tm.tm_hour = 12;
+    tm.tm_isdst = -1;
+    const struct stat noon = makeStat(0, ::mktime(&tm));
+    EXPECT_TRUE(compile("mtime==2000-01-01").matches(FileType::Regular, noon));
+    EXPECT_TRUE(compile("mtime==2000-01-01T12:00").matches(FileType::Regular, noon));
+    EXPECT_FALSE(compile("mtime==2000-01-01T12:01").matches(FileType::Regular, noon));
+    EXPECT_TRUE(compile("mtime!=2000-01-02").matches(FileType::Regular, noon));
+    EXPECT_FALSE(compile("mtime>2000-01-01").matches(FileType::Regular, noon));
+    EXPECT_TRUE(compile("mtime<=2000-01-01").matches(FileType::Regular, noon));
+}
+
+/// Boolean operators and precedence
+TEST(EntryFilter, operators)
+{
+    const struct stat statbuf = makeStat(10, 0);
+    EXPECT_TRUE(compile("size>1G or type==socket").matches(FileType::Socket, statbuf));
+    EXPECT_FALSE(compile("size>1G or type==socket").matches(FileType::Regular, statbuf));
+    EXPECT_FALSE(compile("size<1G and type==socket").matches(FileType::Regular, statbuf));
+    EXPECT_TRUE(compile("not type==dir").matches(FileType::Regular, statbuf));
+    EXPECT_TRUE(compile("!(type==dir || size>5)").matches(FileType::Regular, makeStat(1, 0)));
+    // and binds tighter than or
+    EXPECT_TRUE(compile("type==fifo or type==file and size==10").matches(FileType::Fifo, makeStat(0, 0)));
+    EXPECT_FALSE(compile("(type==fifo or type==file) and size==10").matches(FileType::Fifo, makeStat(0, 0)));
+    EXPECT_TRUE(compile("type==file && size>1 && size<100 && !(size==50)").matches(FileType::Regular, statbuf));
+}
+
+/// Size and mtime of directories are unknown
+TEST(EntryFilter, directories)
+{
+    const struct stat dir = makeStat(4096, 0);
+    EXPECT_TRUE(compile("type==dir").matches(FileType::Directory, dir));
+    EXPECT_FALSE(compile("size>1K").matches(FileType::Directory, dir));
+    EXPECT_FALSE(compile("not size>1K").matches(FileType::Directory, dir));
+    EXPECT_FALSE(compile("age>1d").matches(FileType::Directory, dir));
+    EXPECT_FALSE(compile("size>1K and type==dir").matches(FileType::Directory, dir));
+    EXPECT_FALSE(compile("size>1K or type==socket").matches(FileType::Directory, dir));
+    // result known from the other operand
+    EXPECT_TRUE(compile("size>1K or type==dir").matches(FileType::Directory, dir));
+    EXPECT_TRUE(compile("type==dir or size>1K").matches(FileType::Directory, dir));
+    EXPECT_TRUE(compile("not (size>1K and type==file)").matches(FileType::Directory, dir));
+    EXPECT_FALSE(compile("not (size>1K or type==dir)").matches(FileType::Directory, dir));
+    EXPECT_TRUE(compile("size>1K").matches(FileType::Regular, dir));
+}
+
+/// Invalid expressions
+TEST(EntryFilter, errors)
+{
+    for (const char *expression : {"", "size", "size>", "size>1X", "colour==red", "type<file", "type==cube",
+                                   "(size>1", "size>1)", "size>1 and", "mtime>yesterday", "size>-1",
+                                   "size>9999999T", "mtime>@99999999999", "mtime>@99999999999999999999", "age>1e12w"})
+    {
+        std::string error{};
+        EXPECT_FALSE(EntryFilter::compile(expression, error).has_value()) << expression;
+        EXPECT_FALSE(error.empty()) << expression;
+    }
+
+    // the evaluation stack is bounded
+    std::string deep{"size>0"};
+    for (int i = 0; i < 70; i++)
+        deep = "size>0 or (" + deep + ")";
+    std::string error{};
+    EXPECT_FALSE(EntryFilter::compile(deep, error).has_value());
+}
@@ -0,0 +1,80 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test gitignore.cpp.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../gitignore.h"
+
+/// Syntax of the ignore files
+TEST(GitIgnoreRules, syntax)
+{
+    const GitIgnoreRules rules{"# comment\n"
+                               "\n"
+                               "*.o\n"
+                               "!keep.o\n"
+                               "build/\n"
+                               "/top\n"
+                               "doc/*.html\n"
+                               "a/**/z\n"
+                               "logs/**\n"
+                               "\\#hash\n"
+                               "space\\ \n"
+                               "trailing   \r\n"
+                               "[abc]x?\n"};
+    EXPECT_FALSE(rules.empty());
+
+    // basename match at any depth, negation
+    EXPECT_EQ(rules.match("main.o", false), true);
+    EXPECT_EQ(rules.match("src/main.o", false), true);
+    EXPECT_EQ(rules.match("src/keep.o", false), false);
+    EXPECT_EQ(rules.match("main.c", false), std::nullopt);
+
+    // directories only
+    EXPECT_EQ(rules.match("build", true), true);
+    EXPECT_EQ(rules.match("sub/build", true), true);
+    EXPECT_EQ(rules.match("build", false), std::nullopt);
+
+    // anchored patterns
+    EXPECT_EQ(rules.match("top", false), true);
+    EXPECT_EQ(rules.match("sub/top", false), std::nullopt);
+    EXPECT_EQ(rules.match("doc/index.html", false), true);
+    EXPECT_EQ(rules.match("doc/api/index.html", false), std::nullopt);
+    EXPECT_EQ(rules.match("sub/doc/index.html", false), std::nullopt);
+
+    // **
+    EXPECT_EQ(rules.match("a/z", false), true);
+    EXPECT_EQ(rules.match("a/b/c/z", true), true);
+    EXPECT_EQ(rules.match("b/a/z", false), std::nullopt);
+    EXPECT_EQ(rules.match("logs/x/y", false), true);
+    EXPECT_EQ(rules.match("logs", true), std::nullopt);
+
+    // escapes, trailing spaces, brackets
+    EXPECT_EQ(rules.match("#hash", false), true);
+    EXPECT_EQ(rules.match("space ", false), true);
+    EXPECT_EQ(rules.match("trailing", false), true);
+    EXPECT_EQ(rules.match("bxy", false), true);
+    EXPECT_EQ(rules.match("dxy", false), std::nullopt);
+
+    EXPECT_TRUE(GitIgnoreRules{"# only comments\n\n"}.empty());
+}
@@ -23,6 +23,7 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  */
 
 #include <gtest/gtest.h>
+#include <unistd.h>
 
 #include "../ignore.h"
 
@@ -127,4 +128,127 @@ TEST(IgnoreFilterTest, all_rules)
         for (const auto &testPath : testCase.notIgnored)
             EXPECT_FALSE(filter.isIgnored(testPath));
     }
-}
\ No newline at end of file
+}
+
+/// Test the state carried from a directory to its entries
+TEST(IgnoreFilterTest, state)
+{
+    std::vector<std::string> rules{};
+    for (const auto &testCase : testCases)
+        rules.push_back(testCase.rule);
+
+    IgnoreFilter filter{rules};
+
+    // match each path component by component, from the root state
+    const auto matchPath = [&filter](const std::string &path)
+    {
+        IgnoreFilter::State state{};
+        size_t pos = 0;
+        size_t sep;
+        while ((sep = path.find('/', pos)) != std::string::npos)
+        {
+            IgnoreFilter::State entryState{};
+            filter.match(state, path.substr(pos, sep - pos), &entryState);
+            state = std::move(entryState);
+            pos = sep + 1;
+        }
+        return filter.match(state, path.substr(pos), nullptr);
+    };
+
+    for (const auto &testCase : testCases)
+    {
+        for (const auto &testPath : testCase.ignored)
+            EXPECT_TRUE(matchPath(testPath)) << testPath;
+
+        for (const auto &testPath : testCase.notIgnored)
+            EXPECT_FALSE(matchPath(testPath)) << testPath;
+    }
+}
+
+/// Test the different kinds of first components: names, suffixes, substrings, other globs
+TEST(IgnoreFilterTest, tiers)
+{
+    const std::vector<IgnoreFilterTestCase> tierCases = {
+        {"*.o", {"main.o", "dir/.o", "a.b.o"}, {"main.obj", "o", "main.o/sub"}},
+        {"*cache*", {"cache", "dir/.cache", "ccache_dir", "sub/my_cache.db"}, {"cach", "c_ache"}},
+        {"*.d/obj", {"x.d/obj", "dir/.d/obj"}, {"x.d", "x.e/obj", "x.d/obj2"}},
+        {"*tmp*/*.swp", {"tmp/a.swp", "dir/a_tmp_b/.swp"}, {"tmp/a.swo", "tmp/sub/a.swp"}},
+        {"lib*.so", {"libc.so", "dir/lib.so"}, {"libc.so.6", "xlib.so"}},
+    };
+
+    std::vector<std::string> rules{};
+    for (const auto &testCase : tierCases)
+        rules.push_back(testCase.rule);
+    // overlapping keys in the same indexes
+    for (const char *rule : {"*.so.6", "*o", "*ach*", "*he*"})
+        rules.push_back(rule);
+
+    for (const std::vector<std::string> &filterRules : {std::vector<std::string>{}, rules})
+    {
+        for (const auto &testCase : tierCases)
+        {
+            IgnoreFilter filter{filterRules.empty() ? std::vector<std::string>{testCase.rule} : filterRules};
+            for (const auto &testPath : testCase.ignored)
+                EXPECT_TRUE(filter.isIgnored(testPath)) << testCase.rule << " " << testPath;
+            // other rules of the set may match
+            if (filterRules.empty())
+            {
+                for (const auto &testPath : testCase.notIgnored)
+                    EXPECT_FALSE(filter.isIgnored(testPath)) << testCase.rule << " " << testPath;
+            }
+        }
+    }
+}
+
+/// Test many rules
+TEST(IgnoreFilterTest, many_rules)
+{
+    std::vector<std::string> rules{};
+    for (int i = 0; i < 20000; i++)
+    {
+        const std::string id = std::to_string(i);
+        rules.push_back("name" + id);
+        rules.push_back("*.ext" + id);
+        rules.push_back("*mid" + id + "*");
+    }
+    IgnoreFilter filter{rules};
+
+    EXPECT_TRUE(filter.isIgnored("dir/name19999"));
+    EXPECT_TRUE(filter.isIgnored("file.ext123"));
+    EXPECT_TRUE(filter.isIgnored("a_mid42_b"));
+    EXPECT_FALSE(filter.isIgnored("name20000"));
+    EXPECT_FALSE(filter.isIgnored("file.ext"));
+    EXPECT_FALSE(filter.isIgnored("a_mi_d42_b"));
+}
+
+/// Test the rules using the syntax of regular expressions
+TEST(IgnoreFilterTest, regex_syntax)
+{
+    for (const char *rule : {"[0-9]+", "a|b", "(build)", "x{2}", "^top", "end$", "dir/.*\\.(o|a)"})
+        EXPECT_FALSE(IgnoreFilter::checkRule(rule).empty()) << rule;
+    for (const char *rule : {"*.o", "/cache", "[0-9]?", "[^+]", ".*", "\\*", "Copy \\(2\\)", "a\\+b"})
+        EXPECT_EQ(IgnoreFilter::checkRule(rule), "") << rule;
+
+    // escaped characters are matched literally
+    const IgnoreFilter filter{{"Copy \\(2\\)", "a\\+b"}};
+    EXPECT_TRUE(filter.isIgnored("Copy (2)"));
+    EXPECT_TRUE(filter.isIgnored("dir/a+b"));
+    EXPECT_FALSE(filter.isIgnored("aab"));
+}
+
+/// Test reading rules from a file
+TEST(IgnoreFilterTest, read_rules)
+{
+    char tmpl[] = "/tmp/test-diff-dir-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    const std::string content = "# build outputs\n*.o\r\n\n/cache\nomega/delete";
+    ASSERT_EQ(::write(fd, content.data(), content.size()), (ssize_t)content.size());
+    ::close(fd);
+
+    std::vector<std::string> rules = {"first"};
+    EXPECT_TRUE(IgnoreFilter::readRules(tmpl, rules));
+    EXPECT_EQ(rules, (std::vector<std::string>{"first", "*.o", "/cache", "omega/delete"}));
+    ::unlink(tmpl);
+
+    EXPECT_FALSE(IgnoreFilter::readRules("/nonexistent/file", rules));
+}
@@ -0,0 +1,84 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test lru_cache.h.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "../lru_cache.h"
+
+/// Value whose memory is the size of its string
+struct CachedString
+{
+    size_t memorySize() const
+    {
+        return str.size();
+    }
+
+    std::string str;
+};
+
+/// Least recently used values are evicted above the budget
+TEST(LruCache, eviction)
+{
+    LruCache<int, CachedString> cache{10};
+    cache.insert(1).str = "aaaa";
+    cache.update(1);
+    cache.insert(2).str = "bbbb";
+    cache.update(2);
+    EXPECT_EQ(cache.bytes(), 8u);
+
+    // 1 is used, 2 is evicted
+    ASSERT_NE(cache.get(1), nullptr);
+    cache.insert(3).str = "cccc";
+    cache.update(3);
+    EXPECT_EQ(cache.peek(2), nullptr);
+    EXPECT_NE(cache.peek(1), nullptr);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.bytes(), 8u);
+
+    // most recent value is kept even above the budget
+    cache.peek(3)->str = std::string(20, 'c');
+    cache.update(3);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.bytes(), 20u);
+
+    EXPECT_EQ(cache.get(1), nullptr);
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 1u);
+}
+
+/// Values inserted as least recently used are evicted first
+TEST(LruCache, least_recent)
+{
+    LruCache<int, CachedString> cache{10};
+    cache.insert(1).str = "aaaa";
+    cache.update(1);
+    cache.insert(2, false).str = "bbbb";
+    cache.update(2);
+    cache.insert(3, false).str = "cccc";
+    cache.update(3);
+    EXPECT_NE(cache.peek(1), nullptr);
+    EXPECT_NE(cache.peek(2), nullptr);
+    EXPECT_EQ(cache.peek(3), nullptr);
+}
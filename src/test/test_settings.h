@@ -0,0 +1,38 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Settings of the tests.
+ */
+
+#pragma once
+
+#include "../context.h"
+
+/** Get the default settings of the tests: content compared with the mtime-trust policy,
+ * all the options disabled. The tests set the fields they need.
+ */
+inline Settings makeTestSettings()
+{
+    Settings settings{};
+    settings.contentBufferSize = 4096;
+    settings.contentPolicy = ContentPolicy::MtimeTrust;
+    return settings;
+}
@@ -0,0 +1,141 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Test termui_utf8.cpp.
+ */
+
+#include <gtest/gtest.h>
+#include <random>
+
+#include "../../termui/termui_utf8.h"
+
+/// Encode a code point in UTF-8
+static std::string encode(char32_t glyph)
+{
+    std::string result{};
+    if (glyph < 0x80)
+        result += char(glyph);
+    else if (glyph < 0x800)
+        result += {char(0xC0 | (glyph >> 6)), char(0x80 | (glyph & 0x3F))};
+    else if (glyph < 0x10000)
+        result += {char(0xE0 | (glyph >> 12)), char(0x80 | ((glyph >> 6) & 0x3F)), char(0x80 | (glyph & 0x3F))};
+    else
+        result += {char(0xF0 | (glyph >> 18)), char(0x80 | ((glyph >> 12) & 0x3F)),
+                   char(0x80 | ((glyph >> 6) & 0x3F)), char(0x80 | (glyph & 0x3F))};
+    return result;
+}
+
+/// Decode, expecting the whole string to be valid
+static std::u32string decode(const std::string &str)
+{
+    std::u32string result{};
+    EXPECT_EQ(termui::decodeUtf8(str, result), std::string::npos) << str;
+    return result;
+}
+
+/// Valid strings, ASCII runs longer than the blocks
+TEST(Utf8, valid)
+{
+    EXPECT_EQ(decode(""), U"");
+    EXPECT_EQ(decode("abc"), U"abc");
+    EXPECT_EQ(decode("été → ∞ 𝄞"), U"été → ∞ 𝄞");
+
+    const std::string ascii(100, 'x');
+    std::u32string expected{};
+    expected.reserve(201);
+    expected.append(100, U'x').append(1, U'é').append(100, U'x');
+    EXPECT_EQ(decode(ascii + "é" + ascii), expected);
+    expected.assign(1, U'\0').append(100, U'x');
+    EXPECT_EQ(decode(std::string(1, '\0') + ascii), expected);
+
+    // appended to the result
+    std::u32string result = U"ab";
+    EXPECT_EQ(termui::decodeUtf8("cd", result), std::string::npos);
+    EXPECT_EQ(result, U"abcd");
+
+    // random code points, mostly ASCII
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<char32_t> glyph{0x80, 0x10FFFF};
+    for (int round = 0; round < 100; round++)
+    {
+        std::string str{};
+        expected.clear();
+        for (int i = 0; i < 200; i++)
+        {
+            char32_t c = generator() % 4 == 0 ? glyph(generator) : char32_t(0x20 + generator() % 0x5F);
+            if (c >= 0xD800 and c <= 0xDFFF)
+                c = 0xFFFD; // surrogates cannot be encoded
+            str += encode(c);
+            expected += c;
+        }
+        EXPECT_EQ(decode(str), expected);
+    }
+}
+
+/// Offset of the first invalid byte, the characters before are decoded
+TEST(Utf8, invalid)
+{
+    const std::tuple<std::string, size_t, size_t> cases[] = {
+        {"ab\x80", 2, 2},                              // continuation byte
+        {"ab\xC0\x80", 2, 2},                          // overlong 2 bytes
+        {"\xE0\x80\x80", 0, 0},                        // overlong 3 bytes
+        {"\xF0\x80\x80\x80", 0, 0},                    // overlong 4 bytes
+        {"\xED\xA0\x80", 0, 0},                        // surrogate
+        {"\xF4\x90\x80\x80", 0, 0},                    // above U+10FFFF
+        {"\xF5\x80\x80\x80", 0, 0},                    // invalid byte
+        {"é\xC3", 2, 1},                               // truncated
+        {"\xE2\x86x", 0, 0},                           // missing continuation
+        {std::string(40, 'a') + "\xFF" + "b", 40, 40}, // after ASCII blocks
+    };
+    for (const auto &[str, offset, nbDecoded] : cases)
+    {
+        std::u32string result{};
+        EXPECT_EQ(termui::decodeUtf8(str, result), offset) << str;
+        EXPECT_EQ(result.size(), nbDecoded) << str;
+        // validation finds the same byte
+        EXPECT_EQ(termui::validateUtf8(str), offset) << str;
+    }
+    EXPECT_EQ(termui::validateUtf8(std::string(100, 'x') + "été → ∞ 𝄞"), std::string::npos);
+}
+
+/// Validation with forbidden control characters
+TEST(Utf8, validateControls)
+{
+    static constexpr uint32_t newline = 1u << '\n';
+    EXPECT_EQ(termui::validateUtf8("a\x01b", newline), 1u);
+    EXPECT_EQ(termui::validateUtf8("a\x01b"), std::string::npos);
+    EXPECT_EQ(termui::validateUtf8("é\né\n", newline), std::string::npos);
+    // in the blocks and in the last incomplete block
+    for (size_t offset : {0u, 5u, 31u, 40u, 63u, 70u})
+    {
+        std::string str(72, 'x');
+        for (size_t i = 8; i < str.size(); i += 9)
+            str[i] = '\n';
+        str[offset] = '\0';
+        EXPECT_EQ(termui::validateUtf8(str, newline), offset);
+        str[offset] = '\x1F';
+        EXPECT_EQ(termui::validateUtf8(str, newline), offset);
+        str[offset] = ' ';
+        EXPECT_EQ(termui::validateUtf8(str, newline), std::string::npos);
+    }
+    // non-ASCII and invalid bytes still found
+    EXPECT_EQ(termui::validateUtf8(std::string(40, 'a') + "\xFF\x01", newline), 40u);
+}
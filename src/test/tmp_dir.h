@@ -0,0 +1,47 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of diff-dir.
+
+diff-dir is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+diff-dir is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * Temporary directory for the tests working on files.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string>
+
+/// Fixture creating a temporary directory before the test, removed with its content after the test
+struct TmpDirTest : public ::testing::Test
+{
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/test-diff-dir-XXXXXX";
+        tmpDir = ::mkdtemp(tmpl);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(tmpDir);
+    }
+
+    std::string tmpDir; ///< path of the temporary directory
+};
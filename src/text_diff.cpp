@@ -22,126 +22,262 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
  * Text difference algorithm.
  */
 
-#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
 
-#include "dtl.hpp"
 #include "text_diff.h"
 
-bool TextDifference::convertContent(const std::u32string &src, sequence &seq)
+/// Minimal number of lines of the segments compared in parallel
+static constexpr size_t diff_segment_size = 2048;
+/// Number of common lines displayed around the hunks of large contents
+static constexpr size_t large_context_lines = 3;
+/// Maximal number of edits searched for a range of large contents, above the range is a single hunk
+static constexpr uint32_t large_max_cost = 1 << 14;
+/// Estimated memory used by each line of large contents: start position and identifier
+static constexpr size_t large_line_memory = sizeof(uint64_t) + sizeof(line_id);
+/// Estimated memory used by each distinct line of large contents: node and bucket of the table
+static constexpr size_t large_distinct_memory = 64;
+/// Number of bytes in each row of the hexadecimal dump
+static constexpr uint32_t binary_row_size = 8;
+/// Number of rows displayed around each range of differing bytes
+static constexpr uint64_t binary_context_rows = 2;
+/// Number of rows displayed for each range of differing bytes, without the context
+static constexpr uint64_t binary_range_rows = 256;
+/// Number of ranges of differing bytes searched in binary files
+static constexpr size_t binary_max_ranges = 100;
+
+/// Lines of a content
+struct ContentLines
+{
+    std::string_view content;     ///< content
+    std::vector<uint64_t> starts; ///< position of the beginning of each line
+
+    /// Get a line, without its line feed
+    std::string_view operator[](size_t index) const
+    {
+        const size_t end = index + 1 < starts.size() ? starts[index + 1] - 1 : content.size();
+        std::string_view line = content.substr(starts[index], end - starts[index]);
+        if (not line.empty() and line.back() == '\n')
+            line.remove_suffix(1);
+        return line;
+    }
+
+    /// Get the number of lines
+    size_t size() const
+    {
+        return starts.size();
+    }
+};
+
+/** Split a content by lines, within a memory budget.
+ * @return false if the budget is exceeded
+ */
+static bool split_lines(ContentLines &lines, size_t &budget)
+{
+    size_t pos = 0;
+    while (pos < lines.content.size())
+    {
+        if (budget < large_line_memory)
+            return false;
+        budget -= large_line_memory;
+        lines.starts.push_back(pos);
+        const void *lf = std::memchr(lines.content.data() + pos, '\n', lines.content.size() - pos);
+        pos = lf == nullptr ? lines.content.size() : static_cast<const char *>(lf) - lines.content.data() + 1;
+    }
+    return lines.starts.size() < UINT32_MAX;
+}
+
+/** Replace the lines by dense identifiers, so that the diff compares integers.
+ * Equal lines on both sides get the same identifier.
+ *
+ * @param[in]  lines   lines on both sides
+ * @param[out] ids     identifiers of the lines on both sides
+ * @param[in]  budget  memory for the distinct lines, SIZE_MAX for no limit
+ * @return false if the budget is exceeded
+ */
+static bool intern_lines(const ContentLines lines[2], std::vector<line_id> ids[2], size_t &budget)
+{
+    std::unordered_map<std::string_view, line_id> table{};
+    for (int side = 0; side < 2; side++)
+    {
+        ids[side].reserve(lines[side].size());
+        for (size_t i = 0; i < lines[side].size(); i++)
+        {
+            const auto [it, inserted] = table.emplace(lines[side][i], table.size());
+            if (inserted)
+            {
+                if (budget < large_distinct_memory)
+                    return false;
+                budget -= large_distinct_memory;
+            }
+            ids[side].push_back(it->second);
+        }
+    }
+    return true;
+}
+
+size_t TextDetails::expandFold(size_t index)
+{
+    const Line fold = m_lines[index];
+    std::vector<Line> lines{};
+    lines.reserve(fold.length);
+    const std::string_view content = m_contents[0];
+    for (size_t pos = fold.offset; lines.size() < fold.length and pos < content.size();)
+    {
+        const size_t end = std::min(content.find('\n', pos), content.size());
+        lines.push_back({pos, uint32_t(end - pos), Common});
+        pos = end + 1;
+    }
+    m_lines.erase(m_lines.begin() + index);
+    m_lines.insert(m_lines.begin() + index, lines.begin(), lines.end());
+    return lines.size();
+}
+
+bool TextDifference::isText(std::string_view content)
+{
+    static constexpr uint32_t textControls = 1u << '\n' | 1u << '\t' | 1u << '\r' | 1u << '\e';
+    return termui::validateUtf8(content, textControls) == std::string::npos;
+}
+
+void TextDifference::convertLine(std::u32string_view src, std::u32string &dst) const
 {
     size_t lastCopiedPos = 0;
     size_t tabPos = 0;
-    std::u32string currentLine{};
-    std::u32string replacement{};
-
-    // process the string
     for (size_t pos = 0; pos < src.size(); pos++)
     {
         const char32_t c = src[pos];
-        if (c == '\n')
+        if (c >= 0x20)
+            continue;
+
+        // copy content
+        if (lastCopiedPos < pos)
+            dst.append(src, lastCopiedPos, pos - lastCopiedPos);
+        lastCopiedPos = pos + 1;
+
+        if (c == '\r')
+            dst += ui.replaceCR;
+        else if (c == '\e')
+            dst += ui.replaceEscape;
+        else if (c == '\t')
         {
-            if (lastCopiedPos < pos)
-                currentLine.append(src, lastCopiedPos, pos - lastCopiedPos);
-            seq.push_back(std::move(currentLine));
-            currentLine.clear();
-            lastCopiedPos = pos + 1;
+            // align to next tabulation
+            int nbSpaces = ui.tabSize - (pos - tabPos) % ui.tabSize;
+            dst += ui.replaceTab;
+            dst.append(std::max<int>(0, nbSpaces - ui.replaceTab.size()), U' ');
+            // next character is aligned with tabulation
             tabPos = pos + 1;
         }
-        else if (c < 0x20)
-        {
-            if (c == '\r')
-                replacement = ui.replaceCR;
-            else if (c == '\e')
-                replacement = ui.replaceEscape;
-            else if (c == '\t')
-            {
-                // align to next tabulation
-                int nbSpaces = ui.tabSize - (pos - tabPos) % ui.tabSize;
-                replacement = ui.replaceTab + std::u32string(nbSpaces - ui.replaceTab.size(), ' ');
-                // next character is aligned with tabulation
-                tabPos = pos + 1;
-            }
-            else
-            {
-                // invalid special characters => consider content as binary, not text
-                return false;
-            }
-
-            // copy content
-            if (lastCopiedPos < pos)
-                currentLine.append(src, lastCopiedPos, pos - lastCopiedPos);
-            currentLine += replacement;
-            lastCopiedPos = pos + 1;
-        }
+        else
+            dst += U'�'; // only in large contents, which are not fully checked
     }
 
     // copy final content
     if (lastCopiedPos < src.size())
-        currentLine.append(src, lastCopiedPos);
-    if (not currentLine.empty())
-        seq.push_back(std::move(currentLine));
+        dst.append(src, lastCopiedPos);
+}
 
-    return true;
+std::u32string TextDifference::formatLine(const TextDetails &details, size_t index) const
+{
+    const TextDetails::Line &line = details[index];
+    if (line.kind == TextDetails::Message)
+        return details.message(line);
+    if (line.kind == TextDetails::Fold)
+        return formatFold + U"⋯ " + termui::toU32String(std::to_string(line.length)) + U" common lines ⋯";
+    if (line.kind == TextDetails::Bytes)
+        return formatBytes(*details.binary(), line);
+
+    // decode, replacing the invalid bytes
+    std::string_view text = details.text(line);
+    std::u32string decoded{};
+    for (size_t invalid; (invalid = termui::decodeUtf8(text, decoded)) != std::string::npos;)
+    {
+        decoded += U'�';
+        text.remove_prefix(invalid + 1);
+    }
+
+    std::u32string result = line.kind == TextDetails::Deleted ? formatDiffL
+                            : line.kind == TextDetails::Added ? formatDiffR
+                                                              : std::u32string{};
+    convertLine(decoded, result);
+    return result;
 }
 
-void TextDifference::pushMessageBinaryContent(std::vector<std::u32string> &diffDetails)
+void TextDifference::pushMessageBinaryContent(TextDetails &details) const
 {
-    diffDetails.emplace_back(U"<Binary content, cannot compare>");
+    details.addMessage(U"<Binary content, cannot compare>");
 }
 
-void TextDifference::operator()(const std::string &contentL, const std::string &contentR, std::vector<std::u32string> &diffDetails)
+void TextDifference::operator()(TextDetails &details, std::stop_token stopToken) const
 {
-    // get content as UTF-32
-    std::u32string c32contentL, c32contentR;
-    try
-    {
-        c32contentL = termui::toU32String(contentL);
-        c32contentR = termui::toU32String(contentR);
-    }
-    catch (const termui::TermUiException &)
-    {
-        // invalid unicode content
-        return pushMessageBinaryContent(diffDetails);
-    }
+    const std::string_view contentL = details.content(Side::Left);
+    const std::string_view contentR = details.content(Side::Right);
+    if (not isText(contentL) or not isText(contentR))
+        return pushMessageBinaryContent(details);
+    if (stopToken.stop_requested())
+        return; // comparison not needed anymore
 
-    // convert content for comparison
-    sequence seqL{}, seqR{};
-    if (not convertContent(c32contentL, seqL))
-        return pushMessageBinaryContent(diffDetails); // special characters in the file, binary content
-    if (not convertContent(c32contentR, seqR))
-        return pushMessageBinaryContent(diffDetails); // special characters in the file, binary content
+    // split by lines, the lines reference the contents
+    size_t budget = SIZE_MAX;
+    ContentLines lines[2] = {{contentL, {}}, {contentR, {}}};
+    split_lines(lines[0], budget);
+    split_lines(lines[1], budget);
 
     bool diffPublished = false;
-    if (!seqL.empty() and !seqR.empty())
+    if (lines[0].size() != 0 and lines[1].size() != 0)
     {
-        // compare the content
-        dtl::Diff<elem, sequence> diff{seqL, seqR, true};
-        diff.enableTrivial();
-        diff.enableHuge();
-        diff.compose();
+        // compare the content, on line identifiers
+        std::vector<line_id> ids[2];
+        intern_lines(lines, ids, budget);
+        std::vector<DiffEdit> diffSequence{};
+        diffSegmented(*engine, ids[0], ids[1], diffSequence, *pool, diff_segment_size, stopToken);
+        if (stopToken.stop_requested())
+            return; // comparison not needed anymore, the script may be incomplete
 
-        const auto &diffSequence = diff.getSes().getSequence();
         // acceptable diff size = 50% common on the minimum size
         const size_t acceptableDiffSize =
-            std::max(seqL.size(), seqR.size()) +
-            std::min(seqL.size(), seqR.size()) * ui.diffCommonThreshold / 100;
+            std::max(lines[0].size(), lines[1].size()) +
+            std::min(lines[0].size(), lines[1].size()) * ui.diffCommonThreshold / 100;
         if (diffSequence.size() <= acceptableDiffSize)
         {
-            // display the differences as computed
-            for (const auto &[elem, info] : diffSequence)
+            // display the differences as computed, folding the common lines far from them
+            for (size_t index = 0; index < diffSequence.size();)
             {
-                switch (info.type)
+                const DiffEdit &edit = diffSequence[index];
+                if (edit.type != DiffEdit::Common)
+                {
+                    if (edit.type == DiffEdit::Delete)
+                        details.addLine(TextDetails::Deleted, lines[0][edit.pos]);
+                    else
+                        details.addLine(TextDetails::Added, lines[1][edit.pos]);
+                    index++;
+                    continue;
+                }
+
+                // run of common lines, consecutive in the left content
+                size_t end = index;
+                while (end < diffSequence.size() and diffSequence[end].type == DiffEdit::Common)
+                    end++;
+                const size_t keepBefore = index == 0 ? 0 : ui.contextLines;
+                const size_t keepAfter = end == diffSequence.size() ? 0 : ui.contextLines;
+                const size_t first = diffSequence[index].pos;
+                if (ui.contextLines >= 0 and end - index > keepBefore + keepAfter + 1)
+                {
+                    const size_t nbFolded = end - index - keepBefore - keepAfter;
+                    for (size_t i = 0; i < keepBefore; i++)
+                        details.addLine(TextDetails::Common, lines[0][first + i]);
+                    details.addFold(lines[0][first + keepBefore], nbFolded);
+                    for (size_t i = keepBefore + nbFolded; i < end - index; i++)
+                        details.addLine(TextDetails::Common, lines[0][first + i]);
+                }
+                else
                 {
-                case dtl::SES_COMMON:
-                    diffDetails.emplace_back(elem);
-                    break;
-                case dtl::SES_DELETE:
-                    diffDetails.emplace_back(formatDiffL + elem);
-                    break;
-                case dtl::SES_ADD:
-                    diffDetails.emplace_back(formatDiffR + elem);
-                    break;
+                    for (size_t i = 0; i < end - index; i++)
+                        details.addLine(TextDetails::Common, lines[0][first + i]);
                 }
+                index = end;
             }
             diffPublished = true;
         }
@@ -153,9 +289,279 @@ void TextDifference::operator()(const std::string &contentL, const std::string &
          * - first display the left (as deleted)
          * - then display the right (as added)
          */
-        for (const auto &line : seqL)
-            diffDetails.emplace_back(formatDiffL + line);
-        for (const auto &line : seqR)
-            diffDetails.emplace_back(formatDiffR + line);
+        for (size_t i = 0; i < lines[0].size(); i++)
+            details.addLine(TextDetails::Deleted, lines[0][i]);
+        for (size_t i = 0; i < lines[1].size(); i++)
+            details.addLine(TextDetails::Added, lines[1][i]);
+    }
+}
+
+/// Get the number of lines of a content, the last one may have no line feed
+static size_t count_lines(std::string_view content)
+{
+    return std::count(content.begin(), content.end(), '\n') + (content.empty() or content.back() == '\n' ? 0 : 1);
+}
+
+/** Get the number of common bytes at the beginning of 2 contents, cut at a line start
+ * and keeping some common lines for the context.
+ */
+static size_t common_prefix(std::string_view contentL, std::string_view contentR)
+{
+    const auto mismatch = std::mismatch(contentL.begin(), contentL.end(), contentR.begin(), contentR.end());
+    size_t pos = mismatch.first - contentL.begin();
+    // back to the beginning of the line, then of the context
+    for (size_t nbLines = 0; pos > 0 and nbLines <= large_context_lines; pos--)
+    {
+        if (contentL[pos - 1] == '\n' and nbLines++ == large_context_lines)
+            break;
+    }
+    return pos;
+}
+
+/** Get the number of common bytes at the end of 2 contents, cut at a line start
+ * and keeping some common lines for the context.
+ */
+static size_t common_suffix(std::string_view contentL, std::string_view contentR)
+{
+    const auto mismatch = std::mismatch(contentL.rbegin(), contentL.rend(), contentR.rbegin(), contentR.rend());
+    size_t size = mismatch.first - contentL.rbegin();
+    // forward to the beginning of a line on both sides
+    const auto isLineStart = [](std::string_view content, size_t pos)
+    { return pos == 0 or content[pos - 1] == '\n'; };
+    while (size > 0 and not (isLineStart(contentL, contentL.size() - size) and
+                             isLineStart(contentR, contentR.size() - size)))
+        size--;
+    // keep the context
+    for (size_t nbLines = 0; size > 0 and nbLines < large_context_lines;)
+    {
+        size--;
+        if (size == 0 or contentL[contentL.size() - size - 1] == '\n')
+            nbLines++;
+    }
+    return size;
+}
+
+void TextDifference::compareLarge(TextDetails &details, std::stop_token stopToken) const
+{
+    std::string_view contentL = details.content(Side::Left);
+    std::string_view contentR = details.content(Side::Right);
+
+    // common lines at the beginning and at the end are not indexed
+    const size_t prefix = common_prefix(contentL, contentR);
+    const size_t prefixLines = std::count(contentL.begin(), contentL.begin() + prefix, '\n');
+    contentL.remove_prefix(prefix);
+    contentR.remove_prefix(prefix);
+    const size_t suffix = common_suffix(contentL, contentR);
+    contentL.remove_suffix(suffix);
+    contentR.remove_suffix(suffix);
+    if (stopToken.stop_requested())
+        return;
+
+    // lines and their identifiers, within the memory cap
+    size_t budget = ui.largeFileMemoryCap;
+    ContentLines lines[2] = {{contentL, {}}, {contentR, {}}};
+    std::vector<line_id> ids[2];
+    const bool detailed = split_lines(lines[0], budget) and split_lines(lines[1], budget) and
+                          intern_lines(lines, ids, budget);
+    if (stopToken.stop_requested())
+        return;
+
+    // display within the remaining memory
+    bool truncated = false;
+    const auto push = [&](TextDetails::Kind kind, std::string_view line)
+    {
+        if (not truncated and budget < sizeof(TextDetails::Line))
+        {
+            details.addMessage(U"<Memory cap reached, next differences are not displayed>");
+            truncated = true;
+        }
+        if (truncated)
+            return false;
+        budget -= sizeof(TextDetails::Line);
+        details.addLine(kind, line);
+        return true;
+    };
+    const auto pushHeader = [&](size_t beginL, size_t countL, size_t beginR, size_t countR)
+    {
+        details.addMessage(termui::toU32String("@@ -" + std::to_string(prefixLines + beginL + 1) + "," +
+                                               std::to_string(countL) + " +" +
+                                               std::to_string(prefixLines + beginR + 1) + "," +
+                                               std::to_string(countR) + " @@"));
+    };
+
+    if (not detailed)
+    {
+        // memory cap reached: a single hunk, not refined
+        for (auto &sideLines : lines)
+            sideLines.starts = {};
+        for (auto &sideIds : ids)
+            sideIds = {};
+        budget = ui.largeFileMemoryCap;
+        pushHeader(0, count_lines(contentL), 0, count_lines(contentR));
+        details.addMessage(U"<Memory cap reached, the differences of this hunk are not detailed>");
+        for (const auto &[content, kind] : {std::pair{contentL, TextDetails::Deleted}, std::pair{contentR, TextDetails::Added}})
+        {
+            for (size_t pos = 0; pos < content.size() and not stopToken.stop_requested();)
+            {
+                size_t end = content.find('\n', pos);
+                end = end == std::string_view::npos ? content.size() : end;
+                if (not push(kind, content.substr(pos, end - pos)))
+                    return;
+                pos = end + 1;
+            }
+        }
+        return;
     }
-}
\ No newline at end of file
+
+    std::vector<DiffHunk> hunks{};
+    diffHunksLinear(ids[0], ids[1], large_max_cost, hunks, stopToken);
+    if (stopToken.stop_requested())
+        return;
+    if (hunks.empty())
+        details.addMessage(U"<Same content>");
+
+    // common lines between the displayed hunks are folded
+    const auto lineStart = [&](size_t index)
+    { return contentL.substr(index < lines[0].size() ? lines[0].starts[index] : contentL.size(), 0); };
+    const auto pushFold = [&](std::string_view firstLine, size_t nbLines)
+    {
+        if (nbLines != 0 and not truncated)
+            details.addFold(firstLine, nbLines);
+    };
+    size_t shownEndL = 0;
+
+    // hunks closer than twice the context are displayed together
+    for (size_t first = 0; first < hunks.size();)
+    {
+        size_t last = first;
+        while (last + 1 < hunks.size() and hunks[last + 1].beginA - hunks[last].endA <= 2 * large_context_lines)
+            last++;
+
+        const size_t before = std::min<size_t>(large_context_lines, hunks[first].beginA);
+        const size_t after = std::min<size_t>(large_context_lines, lines[0].size() - hunks[last].endA);
+        const size_t beginL = hunks[first].beginA - before, endL = hunks[last].endA + after;
+        const size_t beginR = hunks[first].beginB - before, endR = hunks[last].endB + after;
+        if (first == 0)
+            pushFold(details.content(Side::Left).substr(0, 0), prefixLines + beginL);
+        else
+            pushFold(lineStart(shownEndL), beginL - shownEndL);
+        pushHeader(beginL, endL - beginL, beginR, endR - beginR);
+
+        size_t pos = beginL;
+        for (size_t index = first; index <= last; index++)
+        {
+            const DiffHunk &hunk = hunks[index];
+            for (; pos < hunk.beginA; pos++)
+                push(TextDetails::Common, lines[0][pos]);
+            for (size_t i = hunk.beginA; i < hunk.endA; i++)
+                push(TextDetails::Deleted, lines[0][i]);
+            for (size_t i = hunk.beginB; i < hunk.endB; i++)
+                push(TextDetails::Added, lines[1][i]);
+            pos = hunk.endA;
+        }
+        for (; pos < endL; pos++)
+            push(TextDetails::Common, lines[0][pos]);
+        if (truncated)
+            return;
+        shownEndL = endL;
+        first = last + 1;
+    }
+    if (not hunks.empty())
+    {
+        const std::string_view contentSuffix = details.content(Side::Left).substr(prefix + contentL.size());
+        pushFold(lineStart(shownEndL), lines[0].size() - shownEndL + count_lines(contentSuffix));
+    }
+}
+
+/// Get the hexadecimal representation of a number, with at least 8 digits
+static std::string to_hex(uint64_t value)
+{
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "%08llx", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+void TextDifference::compareBinary(TextDetails &details, std::stop_token stopToken) const
+{
+    const BinaryFiles &files = *details.binary();
+    std::vector<ByteRange> ranges{};
+    const bool complete = findByteRanges(files, binary_max_ranges, 2 * binary_context_rows * binary_row_size,
+                                         ranges, stopToken);
+    if (stopToken.stop_requested())
+        return;
+    if (ranges.empty())
+    {
+        details.addMessage(U"<Binary content, same content>");
+        return;
+    }
+    details.addMessage(termui::toU32String("<Binary content, first difference at offset " +
+                                           std::to_string(ranges.front().begin) + " (0x" +
+                                           to_hex(ranges.front().begin) + ")>"));
+
+    // rows around each range, the files are read only for the displayed rows
+    const uint64_t maxSize = std::max(files.size(0), files.size(1));
+    for (const ByteRange &range : ranges)
+    {
+        details.addMessage(termui::toU32String("@@ 0x" + to_hex(range.begin) + ", " +
+                                               std::to_string(range.end - range.begin) + " bytes @@"));
+        const uint64_t firstRow = range.begin / binary_row_size;
+        const uint64_t endRow = (range.end + binary_row_size - 1) / binary_row_size;
+        const uint64_t begin = firstRow - std::min(firstRow, binary_context_rows);
+        const uint64_t end = std::min(std::min(endRow, firstRow + binary_range_rows) + binary_context_rows,
+                                      (maxSize + binary_row_size - 1) / binary_row_size);
+        for (uint64_t row = begin; row < end; row++)
+            details.addBytes(row * binary_row_size, binary_row_size);
+        if (endRow > firstRow + binary_range_rows)
+        {
+            const uint64_t hidden = range.end - (firstRow + binary_range_rows) * binary_row_size;
+            details.addMessage(termui::toU32String("<" + std::to_string(hidden) + " more different bytes>"));
+        }
+    }
+    if (not complete)
+        details.addMessage(termui::toU32String("<Comparison stopped after " + std::to_string(binary_max_ranges) +
+                                               " differences>"));
+}
+
+std::u32string TextDifference::formatBytes(const BinaryFiles &files, const TextDetails::Line &line) const
+{
+    char bytes[2][binary_row_size];
+    size_t nbBytes[2];
+    for (int side = 0; side < 2; side++)
+        nbBytes[side] = files.read(side, line.offset, bytes[side], std::min(line.length, binary_row_size));
+
+    // offset, then hexadecimal and characters of each side, highlighting the differences
+    std::u32string result = termui::toU32String(to_hex(line.offset)) + U"  ";
+    for (int side = 0; side < 2; side++)
+    {
+        const char32_t formatDiff = side == 0 ? formatDiffL[0] : formatDiffR[0];
+        const auto isDifferent = [&](size_t i)
+        { return i >= nbBytes[1 - side] or bytes[0][i] != bytes[1][i]; };
+        for (size_t i = 0; i < binary_row_size; i++)
+        {
+            if (i >= nbBytes[side])
+            {
+                result += U"   ";
+                continue;
+            }
+            static constexpr char32_t digits[] = U"0123456789abcdef";
+            const uint8_t byte = bytes[side][i];
+            if (isDifferent(i))
+                result += {formatDiff, digits[byte >> 4], digits[byte & 0xF], formatNormal, U' '};
+            else
+                result += {digits[byte >> 4], digits[byte & 0xF], U' '};
+        }
+        result += U' ';
+        for (size_t i = 0; i < binary_row_size; i++)
+        {
+            const char c = i < nbBytes[side] ? bytes[side][i] : ' ';
+            const char32_t glyph = c >= 0x20 and c < 0x7F ? c : U'.';
+            if (i < nbBytes[side] and isDifferent(i))
+                result += {formatDiff, glyph, formatNormal};
+            else
+                result += glyph;
+        }
+        if (side == 0)
+            result += U" │ ";
+    }
+    return result;
+}
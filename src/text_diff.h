@@ -24,8 +24,168 @@ along with diff-dir. If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <memory>
+#include <stop_token>
+#include <string_view>
+
+#include "binary_diff.h"
+#include "context.h"
+#include "diff_engine.h"
 #include "term_app_settings.h"
 
+/** Content details of a difference.
+ *
+ * The lines reference the compared contents, which are kept alive by the details:
+ * they are converted for display only when drawn.
+ */
+class TextDetails
+{
+public:
+    /// Kind of line
+    enum Kind : uint8_t
+    {
+        Common,  ///< line in both contents, referenced in the left content
+        Deleted, ///< line only in the left content
+        Added,   ///< line only in the right content
+        Message, ///< information, not from the contents
+        Fold,    ///< common lines not displayed, starting at offset in the left content
+        Bytes,   ///< row of the hexadecimal dump of binary files, starting at offset in both files
+    };
+
+    /// Line of the details
+    struct Line
+    {
+        uint64_t offset; ///< position of the line in its content, index of the message for Message
+        uint32_t length; ///< length of the line, without the line feed, number of lines for Fold, of bytes for Bytes
+        Kind kind;       ///< kind of line
+    };
+
+    TextDetails() : m_owner{}, m_ownerMemory{0}, m_contents{}, m_binary{}, m_lines{}, m_messages{} {}
+
+    /** Set the compared contents, removing all the lines.
+     * @param[in] owner        object keeping the contents alive, as long as the details exist
+     * @param[in] ownerMemory  memory used by the owner, 0 for mapped files
+     * @param[in] contentL     content for left side
+     * @param[in] contentR     content for right side
+     */
+    void setContents(std::shared_ptr<const void> owner, size_t ownerMemory, std::string_view contentL,
+                     std::string_view contentR)
+    {
+        m_owner = std::move(owner);
+        m_ownerMemory = ownerMemory;
+        m_contents[0] = contentL;
+        m_contents[1] = contentR;
+        m_binary.reset();
+        clear();
+    }
+
+    /// Set the compared binary files, removing all the lines
+    void setBinary(std::shared_ptr<const BinaryFiles> files)
+    {
+        setContents({}, 0, {}, {});
+        m_binary = std::move(files);
+    }
+
+    /// Get the compared binary files, nullptr for text contents
+    const BinaryFiles *binary() const
+    {
+        return m_binary.get();
+    }
+
+    /// Get a compared content
+    std::string_view content(Side side) const
+    {
+        return m_contents[int(side)];
+    }
+
+    /// Add a line, which is a view of the left content for Common and Deleted, of the right content for Added
+    void addLine(Kind kind, std::string_view text)
+    {
+        const std::string_view content = m_contents[kind == Added];
+        m_lines.push_back({uint64_t(text.data() - content.data()), uint32_t(text.size()), kind});
+    }
+
+    /// Add common lines which are not displayed, firstLine being a view of the left content
+    void addFold(std::string_view firstLine, size_t nbLines)
+    {
+        m_lines.push_back({uint64_t(firstLine.data() - m_contents[0].data()), uint32_t(nbLines), Fold});
+    }
+
+    /** Replace a fold by the common lines it contains.
+     * @return number of lines replacing the fold
+     */
+    size_t expandFold(size_t index);
+
+    /// Get whether a line is the first one of a block of differences
+    bool isHunkStart(size_t index) const
+    {
+        const auto isChange = [this](size_t i)
+        { return m_lines[i].kind == Deleted or m_lines[i].kind == Added; };
+        return isChange(index) and (index == 0 or not isChange(index - 1));
+    }
+
+    /// Add a row of the hexadecimal dump
+    void addBytes(uint64_t offset, uint32_t size)
+    {
+        m_lines.push_back({offset, size, Bytes});
+    }
+
+    /// Add a message
+    void addMessage(std::u32string message)
+    {
+        m_lines.push_back({m_messages.size(), 0, Message});
+        m_messages.push_back(std::move(message));
+    }
+
+    /// Get the number of lines
+    size_t size() const
+    {
+        return m_lines.size();
+    }
+
+    /// Get a line
+    const Line &operator[](size_t index) const
+    {
+        return m_lines[index];
+    }
+
+    /// Get the text of a line of text
+    std::string_view text(const Line &line) const
+    {
+        return m_contents[line.kind == Added].substr(line.offset, line.length);
+    }
+
+    /// Get the text of a message
+    const std::u32string &message(const Line &line) const
+    {
+        return m_messages[line.offset];
+    }
+
+    /// Get the memory used by the details, including the loaded contents
+    size_t memorySize() const
+    {
+        size_t size = sizeof(*this) + m_ownerMemory + m_lines.capacity() * sizeof(Line);
+        for (const std::u32string &message : m_messages)
+            size += sizeof(message) + message.capacity() * sizeof(char32_t);
+        return size;
+    }
+
+    /// Remove all the lines, keep the contents
+    void clear()
+    {
+        m_lines.clear();
+        m_messages.clear();
+    }
+
+private:
+    std::shared_ptr<const void> m_owner;         ///< object keeping the contents alive
+    size_t m_ownerMemory;                        ///< memory used by the owner
+    std::string_view m_contents[2];              ///< compared contents
+    std::shared_ptr<const BinaryFiles> m_binary; ///< compared binary files, read when displayed
+    std::vector<Line> m_lines;                   ///< lines to be displayed
+    std::vector<std::u32string> m_messages;      ///< text of the messages
+};
+
 /// Compute differences on text
 class TextDifference
 {
@@ -33,35 +193,74 @@ public:
     TextDifference(const TermAppSettings &_ui)
         : ui{_ui},
           formatDiffL{termui::U32Format::buildColorFg(ui.differenceLFg), termui::U32Format::buildColorBg(ui.differenceLBg)},
-          formatDiffR{termui::U32Format::buildColorFg(ui.differenceRFg), termui::U32Format::buildColorBg(ui.differenceRBg)}
+          formatDiffR{termui::U32Format::buildColorFg(ui.differenceRFg), termui::U32Format::buildColorBg(ui.differenceRBg)},
+          formatFold{termui::U32Format::buildColorBg(ui.metadataBg)},
+          formatNormal{termui::U32Format::buildColorFg(ui.normal.colorFg)},
+          engine{makeDiffEngine(ui.diffAlgorithm)},
+          pool{std::make_unique<ThreadPool>(std::max(1u, std::thread::hardware_concurrency()) - 1)}
     {
+        if (not engine)
+            engine = makeDiffEngineMyers(); // unknown algorithm
     }
 
-    /** Compute the differences between the 2 contents.
-     * @param[in]      contentL  content for left side
-     * @param[in]      contentR  content for right side
-     * @param[in,out]  lines to be displayed, with formatting
+    /** Compute the differences between the 2 contents of the details.
+     * The common lines farther than contextLines from a difference are folded.
+     *
+     * @param[in,out]  details    contents to compare, receive the lines to be displayed
+     * @param[in]      stopToken  cancellation, the lines are incomplete when stop is requested
      */
-    void operator()(const std::string &contentL, const std::string &contentR, std::vector<std::u32string> &diffDetails);
+    void operator()(TextDetails &details, std::stop_token stopToken = {}) const;
 
-private:
-    // template types for dtl
-    using elem = std::u32string;
-    using sequence = std::vector<elem>;
-
-    /** Convert content for comparison.
-     * - check for special characters, replace them or stop if binary content
-     * - split by lines
-     * @param[in]  src  content to prepare
-     * @param[out] seq  content split by lines, and with special characters replaced
-     * @return success
+    /// Get whether a file is large, to be compared with compareLarge
+    bool isLarge(off_t size) const
+    {
+        return size_t(size) > ui.largeFileSize;
+    }
+
+    /** Compute the differences between 2 large contents, in bounded memory.
+     * Only the differing hunks are displayed, with some context. When the memory cap
+     * is reached, the differences are displayed as a single hunk.
+     *
+     * @param[in,out]  details    contents to compare, usually mapped from disk, receive the lines to be displayed
+     * @param[in]      stopToken  cancellation, the lines are incomplete when stop is requested
      */
-    bool convertContent(const std::u32string &src, sequence &seq);
+    void compareLarge(TextDetails &details, std::stop_token stopToken = {}) const;
+
+    /** Compute the differences between 2 binary files: only the first ranges of
+     * differing bytes are searched, and displayed as a hexadecimal dump.
+     *
+     * @param[in,out]  details    binary files to compare, receive the lines to be displayed
+     * @param[in]      stopToken  cancellation, the lines are incomplete when stop is requested
+     */
+    void compareBinary(TextDetails &details, std::stop_token stopToken = {}) const;
+
+    /** Get whether a content is text: valid UTF-8, without special characters
+     * other than carriage return, escape and tabulation.
+     */
+    static bool isText(std::string_view content);
+
+    /** Convert a line of details for display.
+     * - decode UTF-8, invalid bytes are replaced
+     * - replace special characters and expand the tabulations
+     * - add the formatting of the kind of line
+     */
+    std::u32string formatLine(const TextDetails &details, size_t index) const;
+
+private:
+    /// Format a row of the hexadecimal dump
+    std::u32string formatBytes(const BinaryFiles &files, const TextDetails::Line &line) const;
+
+    /// Append a decoded line to dst, with special characters replaced and tabulations expanded
+    void convertLine(std::u32string_view src, std::u32string &dst) const;
 
     /// Push message that comparison cannot be done as content is binary
-    void pushMessageBinaryContent(std::vector<std::u32string> &diffDetails);
+    void pushMessageBinaryContent(TextDetails &details) const;
 
     const TermAppSettings &ui;
-    const std::u32string formatDiffL; ///< format string for left side only display
-    const std::u32string formatDiffR; ///< format string for right side only display
-};
\ No newline at end of file
+    const std::u32string formatDiffL;   ///< format string for left side only display
+    const std::u32string formatDiffR;   ///< format string for right side only display
+    const std::u32string formatFold;    ///< format string for folded common lines
+    const char32_t formatNormal;        ///< format character for normal text
+    std::unique_ptr<DiffEngine> engine; ///< algorithm computing the differences between the lines
+    std::unique_ptr<ThreadPool> pool;   ///< threads comparing the segments of large contents
+};
@@ -24,6 +24,7 @@ along with termui. If not, see <https://www.gnu.org/licenses/>.
 
 #include <cmath>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "termui.h"
 
@@ -50,40 +51,56 @@ namespace commands
     constexpr const char *cnorm = "\e[?12l\e[?25h";
 } // namespace commands
 
+/// Parameters of the graphic commands selecting the palette colors, built once
+struct PaletteParameters
+{
+    PaletteParameters()
+    {
+        for (int index = 0; index < 256; index++)
+        {
+            fg[index] = index < 8 ? std::to_string(30 + index) : "38;5;" + std::to_string(index);
+            bg[index] = index < 8 ? std::to_string(40 + index) : "48;5;" + std::to_string(index);
+        }
+    }
+
+    std::array<std::string, 256> fg; ///< foreground parameters, by palette index
+    std::array<std::string, 256> bg; ///< background parameters, by palette index
+};
+static const PaletteParameters paletteParameters{};
+
+/** Format a color component in decimal.
+ * @param[out] dest  destination, with room for 3 characters
+ * @param[in] value  color component
+ * @return end of the formatted number
+ */
+static char *formatComponent(char *dest, uint8_t value)
+{
+    if (value >= 100)
+        *dest++ = '0' + value / 100;
+    if (value >= 10)
+        *dest++ = '0' + value / 10 % 10;
+    *dest++ = '0' + value % 10;
+    return dest;
+}
+
+/// Bytes reserved in the output buffer for each cell of the screen, a full redraw fits without reallocation
+static constexpr size_t reservedBytesPerCell = 8;
+
 namespace epollFd
 {
     enum
     {
         Signal, ///< slot for signal catcher
         Tty,    ///< slot for tty reading
+        Notify, ///< slot for notifications
     };
 }
 
 std::u32string toU32String(const std::string &str)
 {
     std::u32string result{};
-    // allocate enough space
-    result.reserve(str.size());
-
-    // get unicode char 1 by 1
-    const char *input = str.c_str();
-    size_t remainingInput = str.size();
-    std::mbstate_t mbstate{};
-    while (remainingInput > 0)
-    {
-        char32_t glyph;
-        const size_t rc = std::mbrtoc32(&glyph, input, remainingInput, &mbstate);
-        if (rc == 0 or rc > MB_CUR_MAX)
-        {
-            // invalid UTF-8 stream
-            throw TermUiException{"invalid UTF-8 steam"};
-        }
-
-        input += rc;
-        remainingInput -= rc;
-        result += glyph;
-    }
-
+    if (decodeUtf8(str, result) != std::string::npos)
+        throw TermUiException{"invalid UTF-8 stream"};
     return result;
 }
 
@@ -133,8 +150,8 @@ Color Color::fromHsv(float hue, float saturation, float value)
 }
 
 TermUi::TermUi()
-    : m_sigCatcher{}, m_tty{}, m_epoll{::epoll_create1(0)},
-      m_frameBuffer{}, m_dirty{false},
+    : m_sigCatcher{}, m_tty{}, m_epoll{::epoll_create1(0)}, m_notify{::eventfd(0, EFD_NONBLOCK)},
+      m_frameBuffer{}, m_screen{}, m_dirty{false}, m_fullRedraw{true}, m_lastPublishSize{0},
       m_colorFg{Color::fromPalette(7)},
       m_colorBg{Color::fromPalette(0)}
 {
@@ -160,6 +177,9 @@ TermUi::TermUi()
     event.data.u32 = epollFd::Tty;
     if (::epoll_ctl(m_epoll.fd, EPOLL_CTL_ADD, m_tty.fd, &event) < 0)
         throw TermUiExceptionErrno{"epoll_ctl, register tty"};
+    event.data.u32 = epollFd::Notify;
+    if (::epoll_ctl(m_epoll.fd, EPOLL_CTL_ADD, m_notify.fd, &event) < 0)
+        throw TermUiExceptionErrno{"epoll_ctl, register eventfd"};
 }
 
 TermUi::~TermUi()
@@ -175,10 +195,15 @@ TermUi::~TermUi()
 void TermUi::reset()
 {
     // get updated screen size
+    const int prevWidth = m_tty.width;
+    const int prevHeight = m_tty.height;
     m_tty.retrieveSize();
+    if (m_tty.width != prevWidth or m_tty.height != prevHeight)
+        m_fullRedraw = true; // the terminal may have reflowed or cleared the screen
 
     // resize frameBuffer
     m_frameBuffer.resize(m_tty.width * m_tty.height);
+    m_tty.txReserve(m_frameBuffer.size() * reservedBytesPerCell);
 
     // reset frameBuffer
     for (auto &cell : m_frameBuffer)
@@ -189,45 +214,116 @@ void TermUi::reset()
     m_dirty = true;
 }
 
+void TermUi::moveCursor(int &cursorY, int &cursorX, int y, int x, Effect currentEffect, Color currentFg,
+                        Color currentBg)
+{
+    // maximum number of unchanged cells sent again rather than moving the cursor over them
+    constexpr int maxRewrittenCells = 4;
+
+    if (cursorY == y and cursorX == x)
+        return;
+
+    if (cursorY == y and cursorX >= 0 and x > cursorX)
+    {
+        // same row, forward: the unchanged cells are already published
+        const Cell *cells = &m_screen[y * m_tty.width];
+        bool rewrite = x - cursorX <= maxRewrittenCells;
+        for (int i = cursorX; rewrite and i < x; i++)
+        {
+            // a non-ASCII glyph may span several columns, it is never sent again
+            rewrite = cells[i].glyph < 0x80 and cells[i].effect == currentEffect and cells[i].colorFg == currentFg and
+                      cells[i].colorBg == currentBg;
+        }
+        if (rewrite)
+        {
+            for (int i = cursorX; i < x; i++)
+                m_tty.txAppend(cells[i].glyph);
+        }
+        else
+        {
+            // cursor forward
+            m_tty.txAppend("\e[");
+            m_tty.txAppendNumber(x - cursorX);
+            m_tty.txAppend('C');
+        }
+    }
+    else
+    {
+        // cursor position, the column may be omitted for the first one
+        m_tty.txAppend("\e[");
+        m_tty.txAppendNumber(y + 1);
+        if (x > 0)
+        {
+            m_tty.txAppend(';');
+            m_tty.txAppendNumber(x + 1);
+        }
+        m_tty.txAppend('H');
+    }
+    cursorY = y;
+    cursorX = x;
+}
+
 void TermUi::publish()
 {
-    if (m_dirty)
+    if (not m_dirty)
+        return;
+    m_dirty = false;
+
+    const size_t initialSize = m_tty.m_txBuffer.size();
+    const bool fullRedraw = m_fullRedraw or m_screen.size() != m_frameBuffer.size();
+    if (fullRedraw)
     {
         // first clear the screen
         m_tty.txAppend(commands::clear);
+        m_screen = m_frameBuffer;
+        m_fullRedraw = false;
+    }
 
-        // draw each cell
-        Effect currentEffect{};
-        Color currentFg{}; // invalid
-        Color currentBg{}; // invalid
-        int x = 0;
-        int y = 0;
-        for (const auto &cell : m_frameBuffer)
+    // draw each modified cell, graphic settings are kept between the runs of modified cells
+    Effect currentEffect{};
+    Color currentFg{}; // invalid
+    Color currentBg{}; // invalid
+    int cursorY = fullRedraw ? 0 : -1;
+    int cursorX = fullRedraw ? 0 : -1;
+    bool modified = fullRedraw;
+    for (int y = 0; y < m_tty.height; y++)
+    {
+        const Cell *cells = &m_frameBuffer[y * m_tty.width];
+        Cell *published = &m_screen[y * m_tty.width];
+        for (int x = 0; x < m_tty.width; x++)
         {
+            if (not fullRedraw and cells[x] == published[x])
+                continue;
+
+            const Cell &cell = cells[x];
+            if (cursorX != x or cursorY != y)
+                moveCursor(cursorY, cursorX, y, x, currentEffect, currentFg, currentBg);
+
             // handle formatting
-            updateGraphicSettings(currentEffect, currentFg, currentBg,
-                                  cell.effect, cell.colorFg, cell.colorBg);
+            if (cell.effect != currentEffect or cell.colorFg != currentFg or cell.colorBg != currentBg)
+                updateGraphicSettings(currentEffect, currentFg, currentBg, cell.effect, cell.colorFg, cell.colorBg);
 
             // draw glyph
             m_tty.txAppend(cell.glyph);
-
-            // on line change, replace the cursor to avoid shift accumulation on screen resize
-            x++;
-            if (x >= m_tty.width)
-            {
-                y++;
-                // place cursor at the beginning of next line
-                m_tty.txAppend("\e[" + std::to_string(y + 1) + "H");
-                x = 0;
-            }
+            if (not fullRedraw)
+                published[x] = cell;
+            // the width of a non-ASCII glyph depends on the terminal (wide CJK, emoji...): the cursor position is
+            // unknown afterwards and is set explicitly before the next glyph
+            cursorX = cell.glyph < 0x80 ? cursorX + 1 : -1;
+            modified = true;
         }
-        // reset color and formatting
-        m_tty.txAppend("\e[0m");
-
-        // flush to screen
-        m_tty.txFlush();
-        m_dirty = false;
+        // the cursor is placed again at the next line, to avoid shift accumulation on screen resize
+        cursorY = -1;
     }
+    if (not modified)
+        return;
+
+    // reset color and formatting
+    m_tty.txAppend("\e[0m");
+
+    // flush to screen
+    m_lastPublishSize = m_tty.m_txBuffer.size() - initialSize;
+    m_tty.txFlush();
 }
 
 void TermUi::addStdU32String(int y, int x, const std::u32string &strU32, Color colorFg, Color colorBg, Effect effect)
@@ -416,6 +512,8 @@ Event TermUi::waitForEvent(int timeoutMs)
         return getEventSigCatcher();
     case epollFd::Tty:
         return getEventTty();
+    case epollFd::Notify:
+        return getEventNotify();
     default:
         throw TermUiException{"unsupported epoll_wait result"};
     }
@@ -437,6 +535,26 @@ Event TermUi::getEventSigCatcher()
     return Event::fromSignal(signum);
 }
 
+void TermUi::notify()
+{
+    // the counter cannot overflow in practice, a failure would only lose a notification
+    const uint64_t one = 1;
+    ::write(m_notify.fd, &one, sizeof(one));
+}
+
+Event TermUi::getEventNotify()
+{
+    // reset the counter: the pending notifications give a single event
+    uint64_t count;
+    if (::read(m_notify.fd, &count, sizeof(count)) < 0)
+    {
+        if (errno != EINTR and errno != EAGAIN)
+            throw TermUiExceptionErrno{"eventfd read"};
+        return {};
+    }
+    return Event{Event::kNotify};
+}
+
 Event TermUi::getEventTty()
 {
     // complete the rxBuffer to decode complex commands
@@ -476,25 +594,19 @@ void TermUi::updateColorSetting(Color color, bool isFg)
 {
     if (color.isPalette())
     {
-        if (color.paletteIndex() < 8)
-        {
-            m_tty.txAppendNumber((isFg ? 30 : 40) + color.paletteIndex());
-        }
-        else
-        {
-            m_tty.txAppend(isFg ? "38;5;" : "48;5;");
-            m_tty.txAppendNumber(color.paletteIndex());
-        }
+        m_tty.txAppend(isFg ? paletteParameters.fg[color.paletteIndex()] : paletteParameters.bg[color.paletteIndex()]);
     }
     else
     {
-        // RGB
-        m_tty.txAppend(isFg ? "38;2;" : "48;2;");
-        m_tty.txAppendNumber(color.red());
-        m_tty.txAppend(';');
-        m_tty.txAppendNumber(color.green());
-        m_tty.txAppend(';');
-        m_tty.txAppendNumber(color.blue());
+        // RGB, formatted locally to append the parameters at once
+        char params[] = "38;2;rrr;ggg;bbb";
+        params[0] = isFg ? '3' : '4';
+        char *end = formatComponent(params + 5, color.red());
+        *end++ = ';';
+        end = formatComponent(end, color.green());
+        *end++ = ';';
+        end = formatComponent(end, color.blue());
+        m_tty.txAppend(std::string_view{params, size_t(end - params)});
     }
 }
 
@@ -30,6 +30,7 @@ along with termui. If not, see <https://www.gnu.org/licenses/>.
 #include <vector>
 
 #include "termui_internal.h"
+#include "termui_utf8.h"
 
 namespace termui
 {
@@ -48,6 +49,7 @@ struct TermUiExceptionErrno : public TermUiException
 /** Convert UTF-8 encoded string to u32string.
  * @param[in] str  input UTF-8 string
  * @return u32string with the same content
+ * @throw TermUiException if str is not valid UTF-8
  */
 std::u32string toU32String(const std::string &str);
 
@@ -69,6 +71,7 @@ public:
     static constexpr char32_t kSigInt = signalMask | SIGINT;
     static constexpr char32_t kSigTerm = signalMask | SIGTERM;
     static constexpr char32_t kTermResize = signalMask | SIGWINCH;
+    static constexpr char32_t kNotify = signalMask | 0x1000; // see TermUi::notify()
 
     static constexpr char32_t kCtrlC = ctrlMask | 'C';
     static constexpr char32_t kBackspace = 0x7f;
@@ -360,6 +363,8 @@ struct Cell
         colorBg = _colorBg;
     }
 
+    auto operator<=>(const Cell &) const = default;
+
     char32_t glyph; ///< unicode character to draw
     Effect effect;  ///< text effect
     Color colorFg;  ///< foreground color
@@ -551,6 +556,13 @@ public:
      */
     Event waitForEvent(int timeoutMs = -1);
 
+    /** Wake up waitForEvent(), which returns kNotify.
+     *
+     * This method can be called from any thread. The notifications sent before waitForEvent()
+     * retrieves them are merged in a single kNotify event.
+     */
+    void notify();
+
     /** Terminal width.
      * @return current terminal width (number of columns)
      */
@@ -587,16 +599,39 @@ public:
      */
     void setColors(int y, int x, int width, Color colorFg, Color colorBg);
 
+    /// Get the number of bytes sent to the terminal by the last publication of the frameBuffer
+    size_t lastPublishSize() const
+    {
+        return m_lastPublishSize;
+    }
+
 private:
-    /// Publish the frameBuffer content to the screen
+    /** Publish the frameBuffer content to the screen.
+     *
+     * Only the cells which differ from the published screen are sent, unless a full redraw is needed
+     * (first publication, size change).
+     */
     void publish();
 
+    /** Move the cursor to a cell with the shortest command, from its current position.
+     * @param[in,out] cursorY  current row of the cursor, -1 if unknown
+     * @param[in,out] cursorX  current column of the cursor, -1 if unknown (e.g. after a non-ASCII glyph)
+     * @param[in] y            row to move to
+     * @param[in] x            column to move to
+     * @param[in] currentEffect, currentFg, currentBg  current graphic settings
+     */
+    void moveCursor(int &cursorY, int &cursorX, int y, int x, Effect currentEffect, Color currentFg,
+                    Color currentBg);
+
     /// Get event from signal catcher
     Event getEventSigCatcher();
 
     /// Get event from Tty
     Event getEventTty();
 
+    /// Get event from the notifications of the other threads
+    Event getEventNotify();
+
     /** Add a UTF-32 standard string to the framebuffer.
      * @param[in] y        line / row index, starting from 0
      * @param[in] x        column index, starting from 0
@@ -616,9 +651,13 @@ private:
 
     internal::ScopedSignalCatcher m_sigCatcher; ///< signal catcher
     internal::ScopedBufferedTty m_tty;          ///< tty handler
-    internal::ScopedFd m_epoll;                 ///< epoll instance to wait for tty / signal
+    internal::ScopedFd m_epoll;                 ///< epoll instance to wait for tty / signal / notification
+    internal::ScopedFd m_notify;                ///< eventfd counting the notifications of the other threads
     std::vector<Cell> m_frameBuffer;            ///< store / preparation of next screen content
+    std::vector<Cell> m_screen;                 ///< content published on the screen
     bool m_dirty;                               ///< whether m_frameBuffer contains unpublished modifications
+    bool m_fullRedraw;                          ///< whether the screen shall be cleared and fully redrawn
+    size_t m_lastPublishSize;                   ///< number of bytes sent by the last publication
     Color m_colorFg;                            ///< screen default foreground color
     Color m_colorBg;                            ///< screen default background color
 };
@@ -90,7 +90,7 @@ ScopedTty::~ScopedTty()
 }
 
 ScopedBufferedTty::ScopedBufferedTty()
-    : m_rxBuffer{}, m_rxFilled{0}, m_rxMbState{}, m_txMbState{}, m_txBuffer{}
+    : m_rxBuffer{}, m_rxFilled{0}, m_rxMbState{}, m_txBuffer{}
 {
     m_txBuffer.reserve(4096);
 }
@@ -113,13 +113,36 @@ void ScopedBufferedTty::rxFd()
 void ScopedBufferedTty::txAppendUnicodeGlyph(char32_t glyph)
 {
     // perform UTF-8 encoding
-    char mbs[MB_CUR_MAX + 1]; // extra slot for null termination
-    // convert glyph to multi byte sequence
-    const std::size_t size = std::c32rtomb(mbs, glyph, &m_txMbState);
-    if (size > MB_CUR_MAX)
-        throw TermUiException("c32rtomb: invalid unicode glyph " + std::to_string((uint32_t)glyph));
-    mbs[size] = 0; // add null termination
-    txAppend(mbs);
+    char mbs[4];
+    size_t size;
+    if (glyph < 0x800)
+    {
+        mbs[0] = 0xC0 | (glyph >> 6);
+        size = 2;
+    }
+    else if (glyph < 0x10000)
+    {
+        if (glyph >= 0xD800 and glyph < 0xE000)
+            throw TermUiException("invalid unicode glyph " + std::to_string((uint32_t)glyph));
+        mbs[0] = 0xE0 | (glyph >> 12);
+        size = 3;
+    }
+    else if (glyph < 0x110000)
+    {
+        mbs[0] = 0xF0 | (glyph >> 18);
+        size = 4;
+    }
+    else
+    {
+        throw TermUiException("invalid unicode glyph " + std::to_string((uint32_t)glyph));
+    }
+    // continuation bytes, 6 bits each
+    for (size_t i = size - 1; i > 0; i--)
+    {
+        mbs[i] = 0x80 | (glyph & 0x3F);
+        glyph >>= 6;
+    }
+    m_txBuffer.insert(m_txBuffer.end(), mbs, mbs + size);
 }
 
 void ScopedBufferedTty::txFlush()
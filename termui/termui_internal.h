@@ -25,11 +25,13 @@ along with termui. If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <array>
+#include <charconv>
 #include <cstdint>
 #include <cuchar>
 #include <fcntl.h>
 #include <signal.h>
 #include <string>
+#include <string_view>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
@@ -152,14 +154,10 @@ struct ScopedBufferedTty : public ScopedTty
      */
     char32_t rxC32();
 
-    /** Append data in buffer for transmission.
-     * @param[in] cmd  command to be sent to terminal
-     */
-    void txAppend(const char *cmd);
     /** Append data in buffer for transmission.
      * @param[in] str  command to be sent to terminal
      */
-    void txAppend(const std::string &str);
+    void txAppend(std::string_view str);
     /** Append data in buffer for transmission.
      * @param[in] glyph  single unicode codepoint to transmit
      */
@@ -170,18 +168,22 @@ struct ScopedBufferedTty : public ScopedTty
      */
     void txAppendNumber(uint32_t num);
 
+    /** Preallocate the output buffer.
+     * @param[in] size  number of bytes which can be appended without reallocation
+     */
+    void txReserve(size_t size);
+
     /// Flush the output buffer to tty
     void txFlush();
 
     std::array<char, 8> m_rxBuffer; ///< buffer to receive commands from tty
     size_t m_rxFilled;              ///< number of bytes available in rxBuffer
     std::mbstate_t m_rxMbState;     ///< unicode decoder state on Rx stream
-    std::mbstate_t m_txMbState;     ///< unicode decoder state on Rx stream
     std::vector<char> m_txBuffer;   ///< buffer to send commands to tty
 
 private:
-    /** Append unicode glyph in buffer for transmission.
-     * @param[in] glyph  single unicode codepoint to transmit
+    /** Append unicode glyph in buffer for transmission, encoded in UTF-8.
+     * @param[in] glyph  single unicode codepoint to transmit, not ASCII
      */
     void txAppendUnicodeGlyph(char32_t glyph);
 };
@@ -235,14 +237,9 @@ inline char32_t ScopedBufferedTty::rxC32()
     return result;
 }
 
-inline void ScopedBufferedTty::txAppend(const char *cmd)
+inline void ScopedBufferedTty::txAppend(std::string_view str)
 {
-    while (*cmd != '\0')
-        m_txBuffer.emplace_back(*cmd++);
-}
-inline void ScopedBufferedTty::txAppend(const std::string &str)
-{
-    txAppend(str.c_str());
+    m_txBuffer.insert(m_txBuffer.end(), str.begin(), str.end());
 }
 inline void ScopedBufferedTty::txAppend(char32_t glyph)
 {
@@ -258,6 +255,12 @@ inline void ScopedBufferedTty::txAppend(char32_t glyph)
 }
 inline void ScopedBufferedTty::txAppendNumber(uint32_t num)
 {
-    txAppend(std::to_string(num));
+    char digits[10];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), num);
+    m_txBuffer.insert(m_txBuffer.end(), digits, result.ptr);
+}
+inline void ScopedBufferedTty::txReserve(size_t size)
+{
+    m_txBuffer.reserve(m_txBuffer.size() + size);
 }
 } // namespace termui::internal
\ No newline at end of file
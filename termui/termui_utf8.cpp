@@ -0,0 +1,314 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of termui.
+
+termui is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+termui is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * UTF-8 decoding.
+ */
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "termui_utf8.h"
+
+namespace termui
+{
+
+/** Convert the ASCII characters at the beginning of the input, by blocks.
+ * The output must have room for as many characters as the input.
+ * @return number of converted characters, the next input byte is not ASCII or is in the last incomplete block
+ */
+typedef size_t (*decode_ascii_fct)(const uint8_t *input, size_t size, char32_t *output);
+
+/// Convert ASCII by 8 bytes, without SIMD instructions
+[[maybe_unused]] static size_t decode_ascii_scalar(const uint8_t *input, size_t size, char32_t *output)
+{
+    size_t pos = 0;
+    for (; pos + 8 <= size; pos += 8)
+    {
+        uint64_t block;
+        std::memcpy(&block, input + pos, 8);
+        const uint64_t highBits = block & 0x8080808080808080ULL;
+        const size_t nbAscii = highBits == 0 ? 8 : std::countr_zero(highBits) / 8;
+        for (size_t i = 0; i < nbAscii; i++)
+            output[pos + i] = input[pos + i];
+        if (nbAscii < 8)
+            return pos + nbAscii;
+    }
+    return pos;
+}
+
+#if defined(__x86_64__)
+
+/// Convert ASCII by 16 bytes, with SSE2 (always available on x86-64)
+static size_t decode_ascii_sse2(const uint8_t *input, size_t size, char32_t *output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t pos = 0;
+    for (; pos + 16 <= size; pos += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + pos));
+        const unsigned highBits = _mm_movemask_epi8(block);
+
+        // widen the whole block, only the ASCII prefix is kept
+        const __m128i low = _mm_unpacklo_epi8(block, zero);
+        const __m128i high = _mm_unpackhi_epi8(block, zero);
+        __m128i *out = reinterpret_cast<__m128i *>(output + pos);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high, zero));
+        if (highBits != 0)
+            return pos + std::countr_zero(highBits);
+    }
+    return pos;
+}
+
+/// Convert ASCII by 32 bytes, with AVX2
+__attribute__((target("avx2"))) static size_t decode_ascii_avx2(const uint8_t *input, size_t size,
+                                                                  char32_t *output)
+{
+    size_t pos = 0;
+    for (; pos + 32 <= size; pos += 32)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + pos));
+        const unsigned highBits = _mm256_movemask_epi8(block);
+
+        // widen the whole block, only the ASCII prefix is kept
+        __m256i *out = reinterpret_cast<__m256i *>(output + pos);
+        for (int i = 0; i < 4; i++)
+        {
+            const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(input + pos + 8 * i));
+            _mm256_storeu_si256(out + i, _mm256_cvtepu8_epi32(bytes));
+        }
+        if (highBits != 0)
+            return pos + std::countr_zero(highBits);
+    }
+    return pos;
+}
+
+#endif
+
+/** Skip the ASCII characters at the beginning of the input, by blocks.
+ * @tparam controls  whether the run also ends at the control characters (below 0x20)
+ * @return number of skipped characters, the next input byte ends the run or is in the last incomplete block
+ */
+typedef size_t (*skip_ascii_fct)(const uint8_t *input, size_t size);
+
+/// Skip ASCII by 8 bytes, without SIMD instructions
+template <bool controls> [[maybe_unused]] static size_t skip_ascii_scalar(const uint8_t *input, size_t size)
+{
+    size_t pos = 0;
+    for (; pos + 8 <= size; pos += 8)
+    {
+        uint64_t block;
+        std::memcpy(&block, input + pos, 8);
+        uint64_t endBits = block & 0x8080808080808080ULL;
+        // bytes below 0x20; the borrows only set the bytes after the first one
+        if constexpr (controls)
+            endBits |= (block - 0x2020202020202020ULL) & ~block & 0x8080808080808080ULL;
+        if (endBits != 0)
+            return pos + std::countr_zero(endBits) / 8;
+    }
+    return pos;
+}
+
+#if defined(__x86_64__)
+
+/// Skip ASCII by 16 bytes, with SSE2
+template <bool controls> static size_t skip_ascii_sse2(const uint8_t *input, size_t size)
+{
+    size_t pos = 0;
+    for (; pos + 16 <= size; pos += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + pos));
+        // signed comparison: the non-ASCII bytes are negative
+        const unsigned endBits = controls ? _mm_movemask_epi8(_mm_cmplt_epi8(block, _mm_set1_epi8(0x20)))
+                                          : _mm_movemask_epi8(block);
+        if (endBits != 0)
+            return pos + std::countr_zero(endBits);
+    }
+    return pos;
+}
+
+/// Skip ASCII by 32 bytes, with AVX2
+template <bool controls>
+__attribute__((target("avx2"))) static size_t skip_ascii_avx2(const uint8_t *input, size_t size)
+{
+    size_t pos = 0;
+    for (; pos + 32 <= size; pos += 32)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + pos));
+        // signed comparison: the non-ASCII bytes are negative
+        const unsigned endBits = controls ? _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), block))
+                                          : _mm256_movemask_epi8(block);
+        if (endBits != 0)
+            return pos + std::countr_zero(endBits);
+    }
+    return pos;
+}
+
+#endif
+
+/// Select the fastest ASCII skipping supported by the CPU
+template <bool controls> static skip_ascii_fct select_skip_ascii()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        return skip_ascii_avx2<controls>;
+    return skip_ascii_sse2<controls>;
+#else
+    return skip_ascii_scalar<controls>;
+#endif
+}
+
+/// ASCII skipping, selected at startup
+static const skip_ascii_fct skip_ascii = select_skip_ascii<false>();
+
+/// ASCII skipping stopping at the control characters, selected at startup
+static const skip_ascii_fct skip_printable = select_skip_ascii<true>();
+
+/// Select the fastest ASCII conversion supported by the CPU
+static decode_ascii_fct select_decode_ascii()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        return decode_ascii_avx2;
+    return decode_ascii_sse2;
+#else
+    return decode_ascii_scalar;
+#endif
+}
+
+/// ASCII conversion, selected at startup
+static const decode_ascii_fct decode_ascii = select_decode_ascii();
+
+/** Decode one multi-byte sequence.
+ * @return length of the sequence, 0 if invalid
+ */
+static size_t decode_sequence(const uint8_t *input, size_t size, char32_t &glyph)
+{
+    const uint8_t lead = input[0];
+    size_t length;
+    uint8_t min = 0x80, max = 0xBF; // range of the second byte
+    if (lead >= 0xC2 and lead <= 0xDF)
+    {
+        length = 2;
+        glyph = lead & 0x1F;
+    }
+    else if (lead >= 0xE0 and lead <= 0xEF)
+    {
+        length = 3;
+        glyph = lead & 0x0F;
+        if (lead == 0xE0)
+            min = 0xA0; // overlong
+        else if (lead == 0xED)
+            max = 0x9F; // surrogates
+    }
+    else if (lead >= 0xF0 and lead <= 0xF4)
+    {
+        length = 4;
+        glyph = lead & 0x07;
+        if (lead == 0xF0)
+            min = 0x90; // overlong
+        else if (lead == 0xF4)
+            max = 0x8F; // above U+10FFFF
+    }
+    else
+        return 0; // continuation byte, overlong 2 bytes sequence or invalid byte
+
+    if (size < length or input[1] < min or input[1] > max)
+        return 0;
+    for (size_t i = 1; i < length; i++)
+    {
+        if ((input[i] & 0xC0) != 0x80)
+            return 0;
+        glyph = (glyph << 6) | (input[i] & 0x3F);
+    }
+    return length;
+}
+
+size_t decodeUtf8(std::string_view str, std::u32string &result)
+{
+    const size_t start = result.size();
+    result.resize(start + str.size());
+    const uint8_t *input = reinterpret_cast<const uint8_t *>(str.data());
+    char32_t *output = result.data() + start;
+
+    size_t pos = 0;
+    while (pos < str.size())
+    {
+        // ASCII run by blocks, then one character
+        const size_t nbAscii = decode_ascii(input + pos, str.size() - pos, output);
+        pos += nbAscii;
+        output += nbAscii;
+        if (pos == str.size())
+            break;
+        if (input[pos] < 0x80)
+        {
+            *output++ = input[pos++];
+            continue;
+        }
+
+        const size_t length = decode_sequence(input + pos, str.size() - pos, *output);
+        if (length == 0)
+        {
+            result.resize(output - result.data());
+            return pos;
+        }
+        pos += length;
+        output++;
+    }
+    result.resize(output - result.data());
+    return std::string::npos;
+}
+
+size_t validateUtf8(std::string_view str, uint32_t allowedControls)
+{
+    const uint8_t *input = reinterpret_cast<const uint8_t *>(str.data());
+    const skip_ascii_fct skip = allowedControls == allControls ? skip_ascii : skip_printable;
+    size_t pos = 0;
+    while (pos < str.size())
+    {
+        pos += skip(input + pos, str.size() - pos);
+        if (pos == str.size())
+            break;
+        if (input[pos] < 0x80)
+        {
+            if (input[pos] < 0x20 and (allowedControls >> input[pos] & 1) == 0)
+                return pos;
+            pos++;
+            continue;
+        }
+
+        char32_t glyph;
+        const size_t length = decode_sequence(input + pos, str.size() - pos, glyph);
+        if (length == 0)
+            return pos;
+        pos += length;
+    }
+    return std::string::npos;
+}
+
+} // namespace termui
@@ -0,0 +1,58 @@
+/*
+Copyright 2020 Michel Palleau
+
+This file is part of termui.
+
+termui is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+termui is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ *
+ * UTF-8 decoding.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace termui
+{
+
+/** Decode a UTF-8 string to UTF-32, appending to result.
+ *
+ * The ASCII runs are converted by blocks, with SSE2 or AVX2 when the CPU supports them.
+ * Overlong encodings, surrogates and code points above U+10FFFF are invalid.
+ *
+ * @param[in]     str     UTF-8 string
+ * @param[in,out] result  string to which the decoded characters are appended, up to the first invalid byte
+ * @return offset of the first invalid byte in str, std::string::npos if str is valid
+ */
+size_t decodeUtf8(std::string_view str, std::u32string &result);
+
+/// Mask of validateUtf8 allowing all the control characters
+constexpr uint32_t allControls = UINT32_MAX;
+
+/** Check that a string is valid UTF-8, without decoding it.
+ *
+ * The control characters are checked in the same pass as the ASCII runs.
+ *
+ * @param[in] str              UTF-8 string
+ * @param[in] allowedControls  control characters allowed in str, bit n for the character n (below 0x20)
+ * @return offset of the first invalid byte or forbidden control character in str, std::string::npos if str is valid
+ */
+size_t validateUtf8(std::string_view str, uint32_t allowedControls = allControls);
+
+} // namespace termui